@@ -4,5 +4,8 @@
 #define BERT_VERSION "${LIBRARY_VERSION}"
 
 #cmakedefine BERT_PCRE
+#cmakedefine BERT_SLAB
+#cmakedefine BERT_SENDFILE
+#cmakedefine BERT_ZLIB
 
 #endif
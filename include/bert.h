@@ -2,7 +2,15 @@
 #define _BERT_H_
 
 #include <bert/config.h>
+#include <bert/alloc.h>
 #include <bert/data.h>
+#include <bert/packed.h>
+#include <bert/slab.h>
+#include <bert/reclaim.h>
+#include <bert/walk.h>
+#include <bert/cache.h>
+#include <bert/format.h>
+#include <bert/builder.h>
 #include <bert/decoder.h>
 #include <bert/encoder.h>
 #include <bert/errno.h>
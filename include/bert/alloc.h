@@ -0,0 +1,32 @@
+#ifndef _BERT_ALLOC_H_
+#define _BERT_ALLOC_H_
+
+#include <sys/types.h>
+
+typedef void * (*bert_malloc_func)(size_t size,void *data);
+typedef void * (*bert_realloc_func)(void *ptr,size_t size,void *data);
+typedef void (*bert_free_func)(void *ptr,void *data);
+
+/*
+ * Set of functions used to allocate and free memory, along with the
+ * user data passed to each of them.
+ */
+struct bert_allocator
+{
+	bert_malloc_func malloc;
+	bert_realloc_func realloc;
+	bert_free_func free;
+
+	void *data;
+};
+typedef struct bert_allocator bert_allocator_t;
+
+/*
+ * Sets the allocator used for all memory allocated by libBERT, or restores
+ * malloc, realloc and free if NULL is given. Memory is always released with
+ * the allocator it was allocated with, so the given allocator must remain
+ * valid while any data allocated with it is still alive.
+ */
+extern void bert_set_allocator(const bert_allocator_t *allocator);
+
+#endif
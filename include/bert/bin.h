@@ -0,0 +1,51 @@
+#ifndef _BERT_BIN_H_
+#define _BERT_BIN_H_
+
+#include <sys/types.h>
+
+/*
+ * Binaries of at least this many bytes are referenced in place, rather
+ * than copied, when decoded from a shared buffer.
+ */
+#define BERT_SHARED_BIN_MIN	64
+
+struct bert_allocator;
+
+typedef void (*bert_bin_free_func)(unsigned char *data,void *user_data);
+
+/*
+ * Reference counted buffer which binary data may point into.
+ */
+struct bert_bin_buffer
+{
+	unsigned int refs;
+
+	unsigned char *data;
+	size_t length;
+
+	bert_bin_free_func free;
+	void *user_data;
+
+	const struct bert_allocator *allocator;
+};
+typedef struct bert_bin_buffer bert_bin_buffer_t;
+
+/*
+ * Allocates a new bert_bin_buffer_t holding a single reference to the
+ * given data. Once the last reference has been released, the given
+ * free callback is called with the data and user_data, unless it is NULL.
+ */
+extern bert_bin_buffer_t * bert_bin_buffer_create(unsigned char *data,size_t length,bert_bin_free_func free_func,void *user_data);
+
+/*
+ * Adds a reference to the given bert_bin_buffer_t and returns it.
+ */
+extern bert_bin_buffer_t * bert_bin_buffer_ref(bert_bin_buffer_t *buffer);
+
+/*
+ * Releases a reference to the given bert_bin_buffer_t, freeing it once
+ * the last reference has been released.
+ */
+extern void bert_bin_buffer_unref(bert_bin_buffer_t *buffer);
+
+#endif
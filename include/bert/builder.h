@@ -0,0 +1,81 @@
+#ifndef _BERT_BUILDER_H_
+#define _BERT_BUILDER_H_
+
+#include <bert/encoder.h>
+#include <bert/data.h>
+
+#include <stdint.h>
+
+/*
+ * The term builder writes a term to an encoder one element at a time,
+ * without building it as bert_data_t first. A term is complete, and the
+ * encoder is flushed, once its outermost element has been written.
+ *
+ * If any of the builder functions fail, the term is left incomplete and
+ * bert_encoder_reset() must be called before the encoder is used again.
+ *
+ * Atoms, strings, binaries and terms written within a tuple or list are
+ * copied, even in bert_mode_stream and bert_mode_iovec, so their buffers
+ * may be reused as soon as the builder function returns.
+ */
+
+/*
+ * Begins a tuple of the given number of elements. The tuple ends once
+ * that many elements have been written to it.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if there are too many elements.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_encoder_begin_tuple(bert_encoder_t *encoder,size_t elements);
+
+/*
+ * Begins a list of unknown length, which ends with bert_encoder_end_list().
+ * In bert_mode_buffer, bert_mode_dynamic and bert_mode_mmap, the length of
+ * the list is written once it ends. In the other modes, the elements are
+ * staged and written out every BERT_ENCODER_STAGED bytes, as the segments
+ * of an improper list terminated by NIL.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the encoder has no output.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_encoder_begin_list(bert_encoder_t *encoder);
+
+/*
+ * Ends the innermost list begun with bert_encoder_begin_list().
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the innermost open term is not a list.
+ */
+extern int bert_encoder_end_list(bert_encoder_t *encoder);
+
+extern int bert_encoder_put_int(bert_encoder_t *encoder,int64_t i);
+extern int bert_encoder_put_float(bert_encoder_t *encoder,double d);
+extern int bert_encoder_put_atom(bert_encoder_t *encoder,const char *atom);
+extern int bert_encoder_put_string(bert_encoder_t *encoder,const char *string);
+extern int bert_encoder_put_bin(bert_encoder_t *encoder,const unsigned char *bin,size_t length);
+extern int bert_encoder_put_boolean(bert_encoder_t *encoder,unsigned int boolean);
+extern int bert_encoder_put_nil(bert_encoder_t *encoder);
+
+/*
+ * Writes the given data as the next element.
+ */
+extern int bert_encoder_put_term(bert_encoder_t *encoder,const bert_data_t *data);
+
+/*
+ * Copies the encoded term at the start of the given buffer as the next
+ * element, without decoding it. A leading magic byte is skipped, so whole
+ * messages can be spliced in as well as the terms within them. Sets
+ * consumed, if given, to the number of bytes taken from the buffer.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_SHORT_READ if the buffer ends within the term.
+ * Returns BERT_ERRNO_INVALID if the term cannot be copied, such as when
+ * it contains atom cache references.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_encoder_splice(bert_encoder_t *encoder,const unsigned char *buffer,size_t length,size_t *consumed);
+
+/*
+ * Returns the number of tuples and lists left open by the term builder.
+ */
+extern unsigned int bert_encoder_depth(const bert_encoder_t *encoder);
+
+#endif
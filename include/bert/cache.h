@@ -0,0 +1,36 @@
+#ifndef _BERT_CACHE_H_
+#define _BERT_CACHE_H_
+
+#include <bert/data.h>
+#include <bert/encoder.h>
+
+/*
+ * Encodes the given tuple, list or dict once, and keeps the encoded bytes
+ * with it. Pushing the data afterwards, on its own or within other data,
+ * writes the cached bytes instead of encoding it again. The cache is
+ * dropped once the data, or any data it contains, is modified with
+ * bert_tuple_set(), bert_list_set(), bert_list_append(),
+ * bert_dict_append() or the bert_data_tuple_set() and
+ * bert_data_list_set() functions built on them.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the data is not a tuple, list or dict, or
+ *   cannot be encoded.
+ * Returns BERT_ERRNO_FROZEN if the data was packed.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_data_cache(bert_data_t *data);
+
+/*
+ * Behaves like bert_data_cache(), but encodes the data with the small
+ * atoms and maps settings of the given encoder. Cached bytes are only
+ * written by encoders with the same settings they were encoded with, and
+ * other encoders encode the data again.
+ */
+extern int bert_encoder_cache(const bert_encoder_t *encoder,bert_data_t *data);
+
+/*
+ * Drops the encoded bytes cached for the given data, if any.
+ */
+extern void bert_data_uncache(bert_data_t *data);
+
+#endif
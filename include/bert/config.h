@@ -0,0 +1,11 @@
+#ifndef _BERT_CONFIG_H_
+#define _BERT_CONFIG_H_
+
+#define BERT_VERSION "0.1.0"
+
+/* #undef BERT_PCRE */
+/* #undef BERT_SLAB */
+#define BERT_SENDFILE
+#define BERT_ZLIB
+
+#endif
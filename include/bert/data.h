@@ -6,6 +6,8 @@
 #include <bert/list.h>
 #include <bert/dict.h>
 #include <bert/regex.h>
+#include <bert/bin.h>
+#include <bert/alloc.h>
 
 #include <stdint.h>
 #include <time.h>
@@ -27,7 +29,9 @@ typedef enum
 	bert_data_bin,
 	bert_data_time,
 	bert_data_regex,
-	bert_data_nil
+	bert_data_nil,
+	bert_data_file,
+	bert_data_raw
 } bert_data_type;
 
 struct bert_data;
@@ -40,6 +44,17 @@ struct bert_data
 {
 	bert_data_type type;
 
+	unsigned int refs;
+	unsigned int flags;
+
+	/*
+	 * Bytes allocated for the payload of decoded data, which may exceed
+	 * its length, so that decoding over the data can reuse the allocation.
+	 */
+	unsigned int capacity;
+
+	const struct bert_allocator *allocator;
+
 	union
 	{
 		unsigned int boolean;
@@ -62,6 +77,8 @@ struct bert_data
 		{
 			bert_bin_size_t length;
 			unsigned char *data;
+
+			struct bert_bin_buffer *buffer;
 		} bin;
 
 		struct bert_tuple *tuple;
@@ -77,6 +94,34 @@ struct bert_data
 
 			int options;
 		} regex;
+
+		struct
+		{
+			bert_bin_size_t length;
+
+			int fd;
+			off_t offset;
+		} file;
+
+		/*
+		 * An already encoded term, written out as it is.
+		 */
+		struct
+		{
+			size_t length;
+			unsigned char *data;
+
+			struct bert_bin_buffer *buffer;
+		} raw;
+
+		/*
+		 * Links containers together while they are being destroyed.
+		 */
+		struct
+		{
+			void *container;
+			struct bert_data *next;
+		} pending;
 	};
 };
 
@@ -183,8 +228,36 @@ extern bert_data_t * bert_data_create_empty_bin(bert_bin_size_t length);
 extern bert_data_t * bert_data_create_bin(const unsigned char *data,bert_bin_size_t length);
 
 /*
- * Returns the required space in bytes needed to encode the given
- * bert_data_t.
+ * Allocates a new bert_data_t with the type of bert_data_bin, which
+ * references length bytes of the given binary data starting at offset,
+ * without copying them. The referenced bytes are kept alive until both
+ * the parent and all of its sub-binaries have been destroyed.
+ * Unlike other binaries, sub-binaries are not NULL terminated.
+ */
+extern bert_data_t * bert_data_create_sub_bin(bert_data_t *parent,bert_bin_size_t offset,bert_bin_size_t length);
+
+/*
+ * Allocates a new bert_data_t with the type of bert_data_file, which is
+ * encoded as a binary holding length bytes read from the given file
+ * descriptor starting at offset. The file descriptor is not closed when
+ * the bert_data_t is destroyed, and must stay open until it is encoded.
+ */
+extern bert_data_t * bert_data_create_file(int fd,off_t offset,bert_bin_size_t length);
+
+/*
+ * Allocates a new bert_data_t with the type of bert_data_raw, and uses a
+ * copy of the given encoded term, without its leading magic byte, as the
+ * raw value. The term is written out by the encoder as it is, without
+ * being decoded or encoded again. Returns NULL if the bytes do not hold
+ * exactly one complete term, or if malloc failed.
+ */
+extern bert_data_t * bert_data_create_raw(const unsigned char *bytes,size_t length);
+
+/*
+ * Returns the exact number of bytes bert_encoder_push() writes for the
+ * given bert_data_t, not including the leading magic byte, with small
+ * atoms and maps disabled. See bert_encoder_sizeof() for encoders with
+ * them enabled. Returns 0 for data which cannot be encoded.
  */
 extern size_t bert_data_sizeof(const bert_data_t *data);
 
@@ -196,8 +269,60 @@ extern size_t bert_data_sizeof(const bert_data_t *data);
 extern int bert_data_strequal(const bert_data_t *data,const char *str);
 
 /*
- * Destroys a previously allocated bert_data_t.
+ * Adds a reference to the given bert_data_t and returns it. References
+ * may be added and released concurrently from multiple threads.
+ */
+extern bert_data_t * bert_data_ref(bert_data_t *data);
+
+/*
+ * Releases a reference to the given bert_data_t, destroying it once the
+ * last reference has been released.
+ */
+extern void bert_data_unref(bert_data_t *data);
+
+/*
+ * Marks the given bert_data_t and all of the data it contains as frozen.
+ * Frozen data cannot be modified, and may safely be read by multiple
+ * threads at once. Deeply nested data is frozen without recursion.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_MALLOC if malloc failed, in which case only some of
+ *   the data within it may have been frozen.
+ */
+extern int bert_data_freeze(bert_data_t *data);
+
+/*
+ * Sets the element at the given index of the tuple pointed to by data_ptr.
+ * If the tuple is frozen or shared, it is first replaced by a copy which
+ * references the remaining elements of the original.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the data is not a tuple or the index is
+ *   out of bounds.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_data_tuple_set(bert_data_t **data_ptr,unsigned int index,bert_data_t *element);
+
+/*
+ * Sets the element at the given index of the list pointed to by data_ptr.
+ * If the list is frozen or shared, it is first replaced by a copy which
+ * references the remaining elements of the original.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the data is not a list or the index is
+ *   out of bounds.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_data_list_set(bert_data_t **data_ptr,unsigned int index,bert_data_t *element);
+
+/*
+ * Releases a reference to a previously allocated bert_data_t, destroying
+ * it once the last reference has been released.
  */
 extern void bert_data_destroy(bert_data_t *data);
 
+/*
+ * Releases a reference to a previously allocated bert_data_t like
+ * bert_data_destroy, but defers tearing down tuples, lists and dicts
+ * until bert_reclaim is called or the reclaimer thread picks them up.
+ */
+extern void bert_data_destroy_async(bert_data_t *data);
+
 #endif
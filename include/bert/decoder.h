@@ -2,6 +2,8 @@
 #define _BERT_DECODER_H_
 
 #include <bert/data.h>
+#include <bert/alloc.h>
+#include <bert/bin.h>
 #include <bert/types.h>
 
 #include <sys/types.h>
@@ -36,6 +38,47 @@ extern void bert_decoder_callback(bert_decoder_t *decoder,bert_read_func callbac
  */
 extern void bert_decoder_buffer(bert_decoder_t *decoder,const unsigned char *buffer,size_t length);
 
+/*
+ * Sets the mode of the given decoder to bert_mode_buffer, and uses the
+ * data of the given bert_bin_buffer_t as the BERT encoded data to decode.
+ * Decoded binaries of at least BERT_SHARED_BIN_MIN bytes reference the
+ * buffer instead of copying it, and keep it alive until they are
+ * destroyed.
+ */
+extern void bert_decoder_shared_buffer(bert_decoder_t *decoder,bert_bin_buffer_t *buffer);
+
+/*
+ * Sets the allocator used for the bert_data_t decoded by the given decoder,
+ * overriding the global allocator. Passing NULL restores the global
+ * allocator.
+ */
+extern void bert_decoder_allocator(bert_decoder_t *decoder,const bert_allocator_t *allocator);
+
+/*
+ * Enables or disables the atom cache of the given decoder, for decoding
+ * the terms written by an encoder with its atom cache enabled. The cache
+ * is updated by the distribution header (tag 68) preceding each term, and
+ * resolves the atom cache references (ATOM_CACHE_REF) within the term.
+ * Without an atom cache, distribution headers are rejected as invalid.
+ * Disabling the atom cache discards it.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_decoder_atom_cache(bert_decoder_t *decoder,int enabled);
+
+/*
+ * Keeps the terms nested at least the given number of levels deep within
+ * the decoded data encoded, as bert_data_raw holding their bytes, instead
+ * of decoding them. The elements of the outermost term are one level
+ * deep. Encoding the decoded data writes those terms out as they were
+ * read, so only the terms above the given depth are encoded again.
+ * Atom cache references within raw terms are replaced by their atoms.
+ * In bert_mode_buffer, raw terms of at least BERT_SHARED_BIN_MIN bytes
+ * reference a shared buffer instead of copying it.
+ * Passing 0 decodes every term, which is the default.
+ */
+extern void bert_decoder_raw_depth(bert_decoder_t *decoder,unsigned int depth);
+
 /*
  * Reads BERT encoded data from the decoder and attempts to decode it.
  * Points the given data_ptr to the newly decoded bert_data_t.
@@ -48,6 +91,19 @@ extern void bert_decoder_buffer(bert_decoder_t *decoder,const unsigned char *buf
  */
 extern int bert_decoder_pull(bert_decoder_t *decoder,bert_data_t **data_ptr);
 
+/*
+ * Behaves like bert_decoder_pull, but decodes over the bert_data_t that
+ * data_ptr already points to, such as the previously decoded message.
+ * Scalars are overwritten in place, and tuples, lists, atoms, strings and
+ * binaries keep their storage where the shapes allow, so decoding messages
+ * of the same shape does not allocate. Data which is shared or frozen is
+ * left untouched and released instead. If data_ptr points to NULL, a new
+ * bert_data_t is allocated.
+ * When no bert_data_t is decoded, the previous bert_data_t is destroyed
+ * and data_ptr is set to NULL.
+ */
+extern int bert_decoder_pull_into(bert_decoder_t *decoder,bert_data_t **data_ptr);
+
 /*
  * Returns the number of bytes read so far.
  */
@@ -3,7 +3,12 @@
 
 #include <bert/data.h>
 
+#include <sys/types.h>
+
 struct bert_data;
+struct bert_allocator;
+struct bert_cache;
+struct bert_cache_epoch;
 
 struct bert_dict_node
 {
@@ -18,6 +23,12 @@ struct bert_dict
 {
 	struct bert_dict_node *head;
 	struct bert_dict_node *tail;
+
+	unsigned int flags;
+
+	const struct bert_allocator *allocator;
+	struct bert_cache *cache;
+	struct bert_cache_epoch *epoch;
 };
 typedef struct bert_dict bert_dict_t;
 
@@ -28,10 +39,16 @@ extern bert_dict_t * bert_dict_create();
 
 /*
  * Appends the given key and value pair to the bert_dict_t.
- * Returns BERT_SUCCESS on success or BERT_ERRNO_MALLOC if malloc failed.
+ * Returns BERT_SUCCESS on success, BERT_ERRNO_FROZEN if the dict is frozen
+ * or BERT_ERRNO_MALLOC if malloc failed.
  */
 extern int bert_dict_append(bert_dict_t *dict,struct bert_data *key,struct bert_data *value);
 
+/*
+ * Returns the number of key and value pairs within the dict.
+ */
+extern size_t bert_dict_length(const bert_dict_t *dict);
+
 /*
  * Destroys a previously allocated bert_dict_t and it's contents.
  */
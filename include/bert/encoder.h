@@ -3,10 +3,45 @@
 
 #include <bert/types.h>
 #include <bert/data.h>
+#include <bert/alloc.h>
 
 #include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * Default number of bytes buffered in bert_mode_stream, before they are
+ * written to the stream.
+ */
+#define BERT_ENCODER_OUTPUT	4096
+
+/*
+ * Atoms, strings and binaries of at least this many bytes are referenced
+ * in place by bert_mode_stream and bert_mode_iovec, instead of being
+ * copied alongside their headers.
+ */
+#define BERT_ENCODER_REFERENCE	1024
+
+/*
+ * Number of bytes bert_mode_mmap extends its file by, and maps at once.
+ * Must be a multiple of the page size.
+ */
+#define BERT_ENCODER_EXTENT	(1024 * 1024 * 64)
+
+/*
+ * Number of bytes of a list of unknown length staged by the term builder,
+ * before they are written out as an improper list segment.
+ */
+#define BERT_ENCODER_STAGED	(1024 * 64)
+
+/*
+ * Smallest number of top-level elements encoded by each thread of
+ * bert_encoder_push_parallel().
+ */
+#define BERT_ENCODER_PARALLEL_MIN	4096
 
 typedef ssize_t (*bert_write_func)(const unsigned char *data,size_t length,void *user_data);
+typedef unsigned char * (*bert_reserve_func)(size_t length,size_t *available,void *user_data);
+typedef void (*bert_commit_func)(size_t length,void *user_data);
 
 struct bert_encoder;
 typedef struct bert_encoder bert_encoder_t;
@@ -19,9 +54,34 @@ extern bert_encoder_t * bert_encoder_create();
 /*
  * Sets the mode of the given encoder to bert_mode_stream, and uses the
  * given file descriptor as the stream to write BERT encoded data to.
+ * Encoded data is buffered, and written to the stream once each
+ * bert_data_t has been encoded or the buffer fills up.
  */
 extern void bert_encoder_stream(bert_encoder_t *encoder,int stream);
 
+/*
+ * Sets the mode of the given encoder to bert_mode_mmap, and creates or
+ * truncates the file at the given path to write BERT encoded data to.
+ * Encoded data is copied into a shared mapping of the file, which is
+ * extended and remapped BERT_ENCODER_EXTENT bytes at a time, leaving the
+ * kernel to write it back. The file must be closed with
+ * bert_encoder_mmap_close(), which truncates it to the bytes written,
+ * before the encoder is given another output.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_WRITE if the file could not be opened.
+ */
+extern int bert_encoder_mmap(bert_encoder_t *encoder,const char *path);
+
+/*
+ * Unmaps and closes the file opened by bert_encoder_mmap(), truncating it
+ * to the number of bytes written, and sets the mode of the given encoder
+ * to bert_mode_none.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the encoder is not in bert_mode_mmap.
+ * Returns BERT_ERRNO_WRITE if the file could not be truncated.
+ */
+extern int bert_encoder_mmap_close(bert_encoder_t *encoder);
+
 /*
  * Sets the mode of the given encoder to bert_mode_buffer, and uses the
  * given buffer to write BERT encoded data to.
@@ -30,10 +90,138 @@ extern void bert_encoder_buffer(bert_encoder_t *encoder,unsigned char *buffer,si
 
 /*
  * Sets the mode of the given encoder to bert_mode_callback, and uses the
- * given callback to write BERT encoded data to.
+ * given callback to write BERT encoded data to. Large payloads are passed
+ * to the callback in chunks. Any non-negative return is taken to mean the
+ * whole chunk was written, unless bert_encoder_partial_writes() is enabled.
+ * A negative return, or one larger than the chunk, fails with
+ * BERT_ERRNO_INVALID.
  */
 extern void bert_encoder_callback(bert_encoder_t *encoder,bert_write_func callback,void *data);
 
+/*
+ * Sets the mode of the given encoder to bert_mode_reserve, where BERT
+ * encoded data is written directly into space reserved from a sink, such
+ * as a ring buffer owned by the caller.
+ * The reserve callback is asked for at least length contiguous bytes,
+ * which bert_encoder_push() sizes to the rest of the term. It returns a
+ * pointer to the reserved space and stores its size in
+ * available, which may be less than length when the space wraps around,
+ * or NULL when there is no space left, which fails with
+ * BERT_ERRNO_SHORT_WRITE.
+ * The commit callback is given the number of bytes written to the start
+ * of the last reservation, once it is full and at the end of each
+ * bert_encoder_push(). The rest of the reservation is released. A
+ * reservation abandoned by bert_encoder_reset() is never committed.
+ */
+extern void bert_encoder_reserve(bert_encoder_t *encoder,bert_reserve_func reserve,bert_commit_func commit,void *data);
+
+/*
+ * Sets the mode of the given encoder to bert_mode_iovec, where BERT
+ * encoded data is collected into an array of iovecs for the caller to
+ * write out. Large payloads are referenced directly from the pushed
+ * bert_data_t, which must outlive the iovecs.
+ */
+extern void bert_encoder_iovec(bert_encoder_t *encoder);
+
+/*
+ * Returns the iovecs collected by the given encoder in bert_mode_iovec
+ * since it was last cleared, and stores their number in count. The array
+ * remains valid until the next call to bert_encoder_push() or
+ * bert_encoder_iovec_clear().
+ */
+extern const struct iovec * bert_encoder_iovec_get(const bert_encoder_t *encoder,unsigned int *count);
+
+/*
+ * Discards the iovecs collected by the given encoder in bert_mode_iovec.
+ */
+extern void bert_encoder_iovec_clear(bert_encoder_t *encoder);
+
+/*
+ * Sets the mode of the given encoder to bert_mode_dynamic, where BERT
+ * encoded data is written to a chain of segments owned by the encoder,
+ * which grow as needed. Data already written is never moved.
+ */
+extern void bert_encoder_dynamic(bert_encoder_t *encoder);
+
+/*
+ * Stores the data written by the given encoder in bert_mode_dynamic into
+ * buffer and length, and resets the encoder. When everything fits in a
+ * single segment it is handed off as is, otherwise the segments are
+ * flattened into a new buffer. The buffer must be freed with the
+ * allocator used by the encoder, which is free() by default.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the encoder is not in bert_mode_dynamic.
+ * Returns BERT_ERRNO_MALLOC if the segments could not be flattened.
+ */
+extern int bert_encoder_take_buffer(bert_encoder_t *encoder,unsigned char **buffer,size_t *length);
+
+/*
+ * Discards the data written by the given encoder, so that the next
+ * bert_encoder_push() starts a new message. Any buffers or segments
+ * allocated by the encoder are kept for reuse.
+ */
+extern void bert_encoder_reset(bert_encoder_t *encoder);
+
+/*
+ * Sets the allocator used for any memory the given encoder allocates while
+ * encoding, overriding the global allocator. Passing NULL restores the
+ * global allocator.
+ */
+extern void bert_encoder_allocator(bert_encoder_t *encoder,const bert_allocator_t *allocator);
+
+/*
+ * Enables or disables encoding atoms of up to 255 bytes as
+ * SMALL_ATOM_EXT, with a single byte length, instead of ATOM_EXT.
+ * Atom names are written as they are, and are read as Latin-1 either way.
+ * Bytes cached without small atoms are encoded again instead of being
+ * written out. Bytes compiled with bert_format_compile() keep using
+ * ATOM_EXT.
+ */
+extern void bert_encoder_small_atoms(bert_encoder_t *encoder,int enabled);
+
+/*
+ * Enables or disables encoding dicts as MAP_EXT, a four byte arity
+ * followed by the keys and values, instead of {bert, dict, [{K, V}, ...]}.
+ * Bytes cached without maps are encoded again instead of being written
+ * out.
+ */
+extern void bert_encoder_maps(bert_encoder_t *encoder,int enabled);
+
+/*
+ * Enables or disables partial writes in bert_mode_callback. When enabled,
+ * the callback returns the number of bytes it wrote, and is called again
+ * with the rest of the chunk when that is less than it was given.
+ * Returning 0 then fails with BERT_ERRNO_SHORT_WRITE.
+ */
+extern void bert_encoder_partial_writes(bert_encoder_t *encoder,int enabled);
+
+/*
+ * Enables or disables the atom cache of the given encoder, which should be
+ * enabled for the lifetime of a connection to a decoder with its own atom
+ * cache enabled. Each term written by bert_encoder_push() is then preceded
+ * by a distribution header (tag 68) defining the atoms it uses, and the
+ * atoms are encoded as single byte references (ATOM_CACHE_REF) into the
+ * header. Atoms already sent on the connection are only sent again by
+ * reference. Compressed terms, and terms written by the term builder or
+ * bert_format_push(), encode atoms in full. Disabling the atom cache
+ * discards it.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_encoder_atom_cache(bert_encoder_t *encoder,int enabled);
+
+/*
+ * Compresses the terms written by bert_encoder_push() which encode to at
+ * least threshold bytes, writing them as compressed terms (tag 80)
+ * deflated with the given zlib level. Terms which do not get smaller are
+ * written uncompressed. Compressed terms are encoded with ATOM_EXT atoms.
+ * A threshold of 0 disables compression.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the level is not between 0 and 9, or
+ *   libBERT was built without zlib.
+ */
+extern int bert_encoder_compress(bert_encoder_t *encoder,size_t threshold,int level);
+
 /*
  * Encodes the given bert_data_t and writes it to the encoder.
  * Returns BERT_SUCCESS on success.
@@ -41,9 +229,61 @@ extern void bert_encoder_callback(bert_encoder_t *encoder,bert_write_func callba
  * Returns BERT_ERRNO_SHORT_WRITE if there is no more space to write the
  *   encoded BERT data.
  * Returns BERT_ERRNO_WRITE if a call to write() failed.
+ * Returns BERT_ERRNO_MALLOC if the iovecs or segments could not be
+ *   allocated.
  */
 extern int bert_encoder_push(bert_encoder_t *encoder,const bert_data_t *data);
 
+/*
+ * Behaves like bert_encoder_push(), but encodes the top-level elements of
+ * a large list or tuple on up to the given number of threads. Each thread
+ * encodes a range of the elements into its own segments, which are then
+ * written out behind the list or tuple header in order. The given data
+ * must not be modified until the function returns.
+ * Other terms, terms with fewer than BERT_ENCODER_PARALLEL_MIN elements
+ * per thread, cached terms, and encoders with compression or the atom
+ * cache enabled are encoded by bert_encoder_push() instead.
+ * Returns the same values as bert_encoder_push().
+ */
+extern int bert_encoder_push_parallel(bert_encoder_t *encoder,const bert_data_t *data,unsigned int threads);
+
+/*
+ * Returns the number of bytes bert_encoder_push() writes for the given
+ * bert_data_t with the small atoms and maps settings of the given
+ * encoder, not including the leading magic byte. Compression and the
+ * atom cache may make the output smaller. Returns 0 for data which cannot
+ * be encoded.
+ */
+extern size_t bert_encoder_sizeof(const bert_encoder_t *encoder,const bert_data_t *data);
+
+/*
+ * Writes any data buffered by the given encoder to its stream.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_WRITE if a call to write() failed.
+ */
+extern int bert_encoder_flush(bert_encoder_t *encoder);
+
+/*
+ * Sets the number of bytes the given encoder buffers in bert_mode_stream,
+ * after flushing anything already buffered. A size of 0 writes encoded
+ * data straight to the stream. In bert_mode_iovec the size applies to
+ * each block of copied data.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_WRITE if a call to write() failed.
+ */
+extern int bert_encoder_output_size(bert_encoder_t *encoder,size_t size);
+
+/*
+ * Encodes the given bert_data_t, including the leading magic byte, into a
+ * newly allocated buffer of exactly bert_data_sizeof() + 1 bytes. The
+ * buffer and its length are stored in buffer and length, and must be
+ * freed with the current allocator, which is free() by default.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID when invalid bert_data_t is given.
+ * Returns BERT_ERRNO_MALLOC if malloc failed.
+ */
+extern int bert_encode_alloc(const bert_data_t *data,unsigned char **buffer,size_t *length);
+
 /*
  * Returns the number of bytes written so far.
  */
@@ -1,7 +1,9 @@
 #ifndef _BERT_ERRNO_H_
 #define _BERT_ERRNO_H_
 
-#define BERT_ERRNO_MAX		-9
+#define BERT_ERRNO_MAX		-11
+#define BERT_ERRNO_THREAD	-10
+#define BERT_ERRNO_FROZEN	-9
 #define BERT_ERRNO_BIGNUM	-8
 #define BERT_ERRNO_MALLOC	-7
 #define BERT_ERRNO_WRITE	-6
@@ -0,0 +1,81 @@
+#ifndef _BERT_FORMAT_H_
+#define _BERT_FORMAT_H_
+
+#include <bert/encoder.h>
+#include <bert/data.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/*
+ * Argument filling a hole of a compiled format, when the arguments are
+ * given as an array.
+ */
+typedef union
+{
+	int64_t integer;
+	double floating_point;
+	const char *atom;
+	const char *string;
+
+	struct
+	{
+		const unsigned char *data;
+		size_t length;
+	} bin;
+
+	const bert_data_t *term;
+} bert_format_arg_t;
+
+struct bert_format;
+typedef struct bert_format bert_format_t;
+
+/*
+ * Compiles the given format into a reusable program which encodes the
+ * described term. Formats are made of tuples {...}, lists [...], atoms,
+ * quoted 'atoms', integers, "strings" and the following holes, which
+ * are filled in when the program is pushed:
+ *
+ *   ~i  integer, given as an int64_t
+ *   ~f  float, given as a double
+ *   ~a  atom, given as a NULL terminated string
+ *   ~s  string, given as a NULL terminated string
+ *   ~b  binary, given as an unsigned char pointer and a size_t length
+ *   ~t  term, given as a bert_data_t pointer
+ *
+ * Everything other than the holes is encoded once, at compile time.
+ * Returns NULL if the format is invalid or malloc failed.
+ */
+extern bert_format_t * bert_format_compile(const char *format);
+
+/*
+ * Returns the number of holes in the given compiled format.
+ */
+extern unsigned int bert_format_holes(const bert_format_t *format);
+
+/*
+ * Encodes the given compiled format, filling its holes with the
+ * following arguments, and writes it to the encoder.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if an argument cannot be encoded.
+ * Returns the errors of bert_encoder_push() when writing fails.
+ */
+extern int bert_format_push(bert_encoder_t *encoder,const bert_format_t *format,...);
+
+/*
+ * Same as bert_format_push, but takes the arguments as a va_list.
+ */
+extern int bert_format_vpush(bert_encoder_t *encoder,const bert_format_t *format,va_list args);
+
+/*
+ * Same as bert_format_push, but takes the arguments as an array holding
+ * one bert_format_arg_t for each hole.
+ */
+extern int bert_format_push_args(bert_encoder_t *encoder,const bert_format_t *format,const bert_format_arg_t *args);
+
+/*
+ * Destroys a previously compiled format.
+ */
+extern void bert_format_destroy(bert_format_t *format);
+
+#endif
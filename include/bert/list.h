@@ -6,6 +6,9 @@
 #include <sys/types.h>
 
 struct bert_data;
+struct bert_allocator;
+struct bert_cache;
+struct bert_cache_epoch;
 
 struct bert_list_node
 {
@@ -19,6 +22,12 @@ struct bert_list
 {
 	struct bert_list_node *head;
 	struct bert_list_node *tail;
+
+	unsigned int flags;
+
+	const struct bert_allocator *allocator;
+	struct bert_cache *cache;
+	struct bert_cache_epoch *epoch;
 };
 typedef struct bert_list bert_list_t;
 
@@ -29,6 +38,8 @@ extern bert_list_t * bert_list_create();
 
 /*
  * Appends the given bert_data_t to the list.
+ * Returns BERT_SUCCESS on success, BERT_ERRNO_FROZEN if the list is frozen
+ * or BERT_ERRNO_MALLOC if malloc failed.
  */
 extern int bert_list_append(bert_list_t *list,struct bert_data *data);
 
@@ -39,6 +50,7 @@ extern struct bert_data * bert_list_get(const bert_list_t *list,unsigned int ind
 
 /*
  * Sets the data at the given index within the list.
+ * Returns 0 if the index is out of bounds or the list is frozen.
  */
 extern int bert_list_set(bert_list_t *list,unsigned int index,struct bert_data *data);
 
@@ -17,10 +17,17 @@
 #define BERT_STRING		((bert_magic_t) 107)
 #define BERT_LIST		((bert_magic_t) 108)
 #define BERT_BIN		((bert_magic_t) 109)
+#define BERT_SMALL_ATOM		((bert_magic_t) 115)
+#define BERT_ATOM_UTF8		((bert_magic_t) 118)
+#define BERT_SMALL_ATOM_UTF8	((bert_magic_t) 119)
+#define BERT_MAP		((bert_magic_t) 116)
 #define BERT_FUN		((bert_magic_t) 117)
 #define BERT_NEW_FUN		((bert_magic_t) 112)
+#define BERT_COMPRESSED		((bert_magic_t) 80)
+#define BERT_DIST_HEADER	((bert_magic_t) 68)
+#define BERT_ATOM_CACHE_REF	((bert_magic_t) 82)
 #define BERT_MAGIC		((bert_magic_t) 131)
 
-#define BERT_VALID_MAGIC(m)	(((97 <= m) && (m <= 100)) || ((104 <= m) && (m <= 111)))
+#define BERT_VALID_MAGIC(m)	(((97 <= m) && (m <= 100)) || ((104 <= m) && (m <= 111)) || (m == 68) || (m == 80) || (m == 82) || (m == 115) || (m == 116) || (m == 118) || (m == 119))
 
 #endif
@@ -0,0 +1,51 @@
+#ifndef _BERT_PACKED_H_
+#define _BERT_PACKED_H_
+
+#include <bert/data.h>
+
+#include <sys/types.h>
+
+/*
+ * Returns the number of bytes needed to pack the given bert_data_t.
+ */
+extern size_t bert_packed_sizeof(const bert_data_t *data);
+
+/*
+ * Packs the given bert_data_t into a single contiguous block within
+ * buffer, which must be aligned to 8 bytes. The pointers within the block
+ * are stored relative to the start of the block, so it may be copied,
+ * written to a file or placed in shared memory as is.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID when invalid bert_data_t is given.
+ * Returns BERT_ERRNO_SHORT_WRITE if the buffer is too small.
+ */
+extern int bert_packed_create(const bert_data_t *data,void *buffer,size_t length);
+
+/*
+ * Relocates the pointers within a packed block to its current address,
+ * and returns the packed bert_data_t. The returned data is frozen, can be
+ * read with the normal accessors, and is released along with the block
+ * rather than with bert_data_destroy. Attaching modifies the block, so
+ * blocks shared between processes should be attached from a private copy
+ * or mapping.
+ * Returns NULL if the buffer does not contain a valid packed block.
+ */
+extern bert_data_t * bert_packed_attach(void *buffer,size_t length);
+
+/*
+ * Relocates the pointers within a previously attached block back to
+ * offsets, so the block may be handed to another process.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_INVALID if the buffer does not contain a valid
+ *   packed block.
+ */
+extern int bert_packed_detach(void *buffer,size_t length);
+
+/*
+ * Allocates a new bert_data_t containing a copy of the data within an
+ * attached or detached packed block.
+ * Returns NULL if the block is invalid or malloc failed.
+ */
+extern bert_data_t * bert_packed_inflate(const void *buffer,size_t length);
+
+#endif
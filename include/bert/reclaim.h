@@ -0,0 +1,33 @@
+#ifndef _BERT_RECLAIM_H_
+#define _BERT_RECLAIM_H_
+
+#include <sys/types.h>
+
+/*
+ * Number of steps the reclaimer thread takes between checking whether
+ * it has been stopped.
+ */
+#define BERT_RECLAIM_SLICE	4096
+
+/*
+ * Tears down data released with bert_data_destroy_async, taking at most
+ * the given number of steps, where each step frees a single element or
+ * node. A budget of 0 frees all of the pending data.
+ * Returns the number of steps taken, or 0 if there was nothing to free.
+ */
+extern size_t bert_reclaim(size_t budget);
+
+/*
+ * Starts a background thread which frees data released with
+ * bert_data_destroy_async.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_THREAD if the thread could not be created.
+ */
+extern int bert_reclaimer_start();
+
+/*
+ * Stops the reclaimer thread, then frees any data still pending.
+ */
+extern void bert_reclaimer_stop();
+
+#endif
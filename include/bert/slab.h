@@ -0,0 +1,13 @@
+#ifndef _BERT_SLAB_H_
+#define _BERT_SLAB_H_
+
+/*
+ * Enables or disables the slab pools used for bert_data_t, tuples, lists,
+ * dicts and their nodes, whenever no allocator has been set with
+ * bert_set_allocator(). The pools are enabled by default when libBERT is
+ * built with BERT_SLAB. Objects are always released to the pool they were
+ * allocated from, so the pools may be toggled at any time.
+ */
+extern void bert_slab_enable(int enabled);
+
+#endif
@@ -4,11 +4,20 @@
 #include <bert/types.h>
 
 struct bert_data;
+struct bert_allocator;
+struct bert_cache;
+struct bert_cache_epoch;
 
 typedef struct bert_tuple
 {
 	bert_tuple_size_t length;
 	struct bert_data **elements;
+
+	unsigned int flags;
+
+	const struct bert_allocator *allocator;
+	struct bert_cache *cache;
+	struct bert_cache_epoch *epoch;
 } bert_tuple_t;
 
 /*
@@ -23,6 +32,7 @@ struct bert_data * bert_tuple_get(const bert_tuple_t *tuple,unsigned int index);
 
 /*
  * Sets the data at the given index within the tuple.
+ * Returns 0 if the index is out of bounds or the tuple is frozen.
  */
 int bert_tuple_set(bert_tuple_t *tuple,unsigned int index,struct bert_data *data);
 
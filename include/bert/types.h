@@ -14,12 +14,20 @@ typedef bert_bin_size_t bert_regex_size_t;
 typedef uint32_t bert_tuple_size_t;
 typedef uint32_t bert_list_size_t;
 
+#define BERT_DATA_FROZEN	0x01
+#define BERT_DATA_PACKED	0x02
+#define BERT_DATA_CACHED	0x04
+
 typedef enum
 {
 	bert_mode_none = 0,
 	bert_mode_stream,
 	bert_mode_buffer,
-	bert_mode_callback
+	bert_mode_callback,
+	bert_mode_iovec,
+	bert_mode_dynamic,
+	bert_mode_reserve,
+	bert_mode_mmap
 } bert_mode;
 
 #endif
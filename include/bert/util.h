@@ -12,6 +12,12 @@
 
 #define BERT_STRIP_SIGN(i)	((i) < 0 ? -(i) : (i))
 
+/*
+ * Absolute value of a signed integer as a uint64_t, which is also defined
+ * for INT64_MIN.
+ */
+#define BERT_MAGNITUDE(i)	((i) < 0 ? ((uint64_t)0 - (uint64_t)(i)) : (uint64_t)(i))
+
 /*
  * Reads a uint8_t from the given unsigned char pointer.
  */
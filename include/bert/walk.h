@@ -0,0 +1,30 @@
+#ifndef _BERT_WALK_H_
+#define _BERT_WALK_H_
+
+#include <bert/data.h>
+
+#define BERT_WALK_CONTINUE	0
+#define BERT_WALK_SKIP		1
+
+/*
+ * Callback given each bert_data_t visited by bert_data_walk, along with
+ * the tuple, list or dict containing it and its index within that
+ * container. The elements of a dict are visited as alternating keys and
+ * values.
+ */
+typedef int (*bert_walk_func)(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data);
+
+/*
+ * Walks over the given bert_data_t and everything it contains, using an
+ * explicit stack instead of recursion. The pre callback is called before
+ * the elements of a tuple, list or dict are visited, and may return
+ * BERT_WALK_SKIP to leave them unvisited. The post callback is called once
+ * they have all been visited. Either callback may be NULL, and NULL
+ * elements are not visited.
+ * Returns BERT_SUCCESS once everything has been visited.
+ * Returns the negative value returned by a callback, stopping the walk.
+ * Returns BERT_ERRNO_MALLOC when malloc fails while growing the stack.
+ */
+extern int bert_data_walk(const bert_data_t *data,bert_walk_func pre,bert_walk_func post,void *user_data);
+
+#endif
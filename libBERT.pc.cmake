@@ -6,4 +6,5 @@ Name: libBERT
 Description: BERT encoding/decoding C library
 Version: ${LIBRARY_VERSION}
 Libs: -L${LIB_INSTALL_DIR} -lBERT
+Libs.private: ${CMAKE_THREAD_LIBS_INIT} ${BERT_ZLIB_LIBS}
 Cflags: -I${INCLUDE_INSTALL_DIR} ${CFLAGS}
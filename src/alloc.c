@@ -0,0 +1,114 @@
+#include <bert/alloc.h>
+#include "private/alloc.h"
+#include "private/slab.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const bert_allocator_t *bert_allocator_default = NULL;
+static __thread const bert_allocator_t *bert_allocator_override = NULL;
+
+void bert_set_allocator(const bert_allocator_t *allocator)
+{
+	bert_allocator_default = allocator;
+}
+
+const bert_allocator_t * bert_allocator_current()
+{
+	if (bert_allocator_override)
+	{
+		return bert_allocator_override;
+	}
+
+	if (!bert_allocator_default && bert_slab_enabled())
+	{
+		return &bert_slab_allocator;
+	}
+
+	return bert_allocator_default;
+}
+
+const bert_allocator_t * bert_allocator_swap(const bert_allocator_t *allocator)
+{
+	const bert_allocator_t *previous = bert_allocator_override;
+
+	bert_allocator_override = allocator;
+	return previous;
+}
+
+void * bert_malloc(const bert_allocator_t *allocator,size_t size)
+{
+	if (!allocator)
+	{
+		return malloc(size);
+	}
+
+	return allocator->malloc(size,allocator->data);
+}
+
+void * bert_calloc(const bert_allocator_t *allocator,size_t count,size_t size)
+{
+	void *ptr;
+
+	if (!allocator)
+	{
+		return calloc(count,size);
+	}
+
+	if (size && count > ((size_t)-1) / size)
+	{
+		// size overflow
+		return NULL;
+	}
+
+	if (!(ptr = allocator->malloc(count * size,allocator->data)))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	memset(ptr,0,count * size);
+	return ptr;
+}
+
+void * bert_realloc(const bert_allocator_t *allocator,void *ptr,size_t size)
+{
+	if (!allocator)
+	{
+		return realloc(ptr,size);
+	}
+
+	return allocator->realloc(ptr,size,allocator->data);
+}
+
+void * bert_object_alloc(const bert_allocator_t *allocator,size_t size)
+{
+	if (allocator == &bert_slab_allocator)
+	{
+		return bert_slab_alloc(size);
+	}
+
+	return bert_malloc(allocator,size);
+}
+
+void bert_object_free(const bert_allocator_t *allocator,void *ptr,size_t size)
+{
+	if (allocator == &bert_slab_allocator)
+	{
+		bert_slab_free(ptr,size);
+		return;
+	}
+
+	bert_free(allocator,ptr);
+}
+
+void bert_free(const bert_allocator_t *allocator,void *ptr)
+{
+	if (!allocator)
+	{
+		free(ptr);
+		return;
+	}
+
+	allocator->free(ptr,allocator->data);
+}
@@ -0,0 +1,57 @@
+#include <bert/bin.h>
+#include "private/atomic.h"
+#include "private/alloc.h"
+
+#include <stdlib.h>
+
+
+bert_bin_buffer_t * bert_bin_buffer_create(unsigned char *data,size_t length,bert_bin_free_func free_func,void *user_data)
+{
+	const bert_allocator_t *allocator = bert_allocator_current();
+	bert_bin_buffer_t *new_buffer;
+
+	if (!(new_buffer = bert_object_alloc(allocator,sizeof(bert_bin_buffer_t))))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	new_buffer->refs = 1;
+	new_buffer->data = data;
+	new_buffer->length = length;
+	new_buffer->free = free_func;
+	new_buffer->user_data = user_data;
+	new_buffer->allocator = allocator;
+	return new_buffer;
+}
+
+bert_bin_buffer_t * bert_bin_buffer_ref(bert_bin_buffer_t *buffer)
+{
+	if (buffer)
+	{
+		BERT_ATOMIC_INC(&(buffer->refs));
+	}
+
+	return buffer;
+}
+
+void bert_bin_buffer_unref(bert_bin_buffer_t *buffer)
+{
+	if (!buffer)
+	{
+		return;
+	}
+
+	if (buffer->refs > 1 && BERT_ATOMIC_DEC(&(buffer->refs)) > 0)
+	{
+		// still referenced elsewhere
+		return;
+	}
+
+	if (buffer->free)
+	{
+		buffer->free(buffer->data,buffer->user_data);
+	}
+
+	bert_object_free(buffer->allocator,buffer,sizeof(bert_bin_buffer_t));
+}
@@ -0,0 +1,465 @@
+#include <bert/builder.h>
+#include <bert/util.h>
+#include <bert/magic.h>
+#include <bert/errno.h>
+#include "private/encoder.h"
+#include "private/encode.h"
+#include "private/alloc.h"
+#include "private/raw.h"
+
+#include <string.h>
+
+static struct bert_encoder_frame * bert_builder_push(bert_encoder_t *encoder,bert_data_type type)
+{
+	struct bert_encoder_frame *frame;
+
+	if (encoder->frames.length >= encoder->frames.size)
+	{
+		unsigned int size = (encoder->frames.size ? encoder->frames.size * 2 : BERT_ENCODER_FRAMES);
+		struct bert_encoder_frame *new_frames;
+
+		if (!(new_frames = bert_realloc(encoder->allocator,encoder->frames.ptr,sizeof(struct bert_encoder_frame) * size)))
+		{
+			// malloc failed
+			return NULL;
+		}
+
+		encoder->frames.ptr = new_frames;
+		encoder->frames.size = size;
+	}
+
+	frame = encoder->frames.ptr + encoder->frames.length++;
+
+	memset(frame,0,sizeof(struct bert_encoder_frame));
+	frame->type = type;
+	return frame;
+}
+
+static struct bert_encoder_frame * bert_builder_top(bert_encoder_t *encoder)
+{
+	if (!encoder->frames.length)
+	{
+		return NULL;
+	}
+
+	return encoder->frames.ptr + (encoder->frames.length - 1);
+}
+
+static int bert_builder_begin(bert_encoder_t *encoder)
+{
+	if (!encoder->frames.length)
+	{
+		// starting a new term
+		return bert_encoder_push_magic(encoder);
+	}
+
+	return BERT_SUCCESS;
+}
+
+/*
+ * Writes the staged elements of a list out to the encoder, as one segment
+ * of the list.
+ */
+static int bert_builder_unstage(bert_encoder_t *encoder,struct bert_encoder_frame *frame)
+{
+	struct bert_encoder_segment *segment;
+	size_t length = encoder->segments.length;
+	size_t chunk;
+	int result;
+
+	encoder->mode = encoder->frames.mode;
+
+	// the staged bytes were counted as they were written
+	encoder->total -= length;
+
+	if (frame->count || !frame->written)
+	{
+		if ((result = bert_encode_list_header(encoder,frame->count)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+	}
+
+	for (segment=encoder->segments.head;segment && length;segment=segment->next)
+	{
+		chunk = MIN(segment->length,length);
+
+		if ((result = bert_encoder_write(encoder,segment->data,chunk)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		length -= chunk;
+	}
+
+	bert_encoder_reset_segments(encoder);
+
+	frame->count = 0;
+	++frame->written;
+	return BERT_SUCCESS;
+}
+
+/*
+ * Counts an element as written to the innermost open term, ending any
+ * tuples which are now complete.
+ */
+static int bert_builder_next(bert_encoder_t *encoder)
+{
+	struct bert_encoder_frame *frame;
+	int result;
+
+	while ((frame = bert_builder_top(encoder)))
+	{
+		if (frame->type == bert_data_list)
+		{
+			++frame->count;
+
+			if (frame->staged && encoder->segments.length >= BERT_ENCODER_STAGED)
+			{
+				if ((result = bert_builder_unstage(encoder,frame)) != BERT_SUCCESS)
+				{
+					return result;
+				}
+
+				// keep staging the rest of the list
+				encoder->mode = bert_mode_dynamic;
+			}
+
+			return BERT_SUCCESS;
+		}
+
+		if (--frame->remaining)
+		{
+			return BERT_SUCCESS;
+		}
+
+		// the tuple is complete, which completes an element of its parent
+		--encoder->frames.length;
+	}
+
+	return bert_encoder_flush(encoder);
+}
+
+int bert_encoder_begin_tuple(bert_encoder_t *encoder,size_t elements)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_tuple_header(encoder,elements)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (!elements)
+	{
+		return bert_builder_next(encoder);
+	}
+
+	struct bert_encoder_frame *frame;
+
+	if (!(frame = bert_builder_push(encoder,bert_data_tuple)))
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	frame->remaining = elements;
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_begin_list(bert_encoder_t *encoder)
+{
+	struct bert_encoder_frame *frame;
+	int result;
+
+	switch (encoder->mode)
+	{
+		case bert_mode_stream:
+		case bert_mode_callback:
+		case bert_mode_reserve:
+		case bert_mode_iovec:
+		case bert_mode_buffer:
+		case bert_mode_dynamic:
+		case bert_mode_mmap:
+			break;
+		default:
+			return BERT_ERRNO_INVALID;
+	}
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (!(frame = bert_builder_push(encoder,bert_data_list)))
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	if (encoder->mode == bert_mode_buffer || encoder->mode == bert_mode_dynamic || encoder->mode == bert_mode_mmap)
+	{
+		// the length is patched once the list ends
+		frame->offset = bert_encoder_offset(encoder);
+
+		return bert_encode_list_header(encoder,0);
+	}
+
+	// stage the elements until enough have been written
+	encoder->frames.mode = encoder->mode;
+	encoder->mode = bert_mode_dynamic;
+	bert_encoder_reset_segments(encoder);
+
+	frame->staged = 1;
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_end_list(bert_encoder_t *encoder)
+{
+	struct bert_encoder_frame *frame = bert_builder_top(encoder);
+	int result;
+
+	if (!frame || frame->type != bert_data_list)
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	if (frame->staged)
+	{
+		if ((result = bert_builder_unstage(encoder,frame)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+	}
+	else
+	{
+		unsigned char length[4];
+
+		if (frame->count > 0xffffffff)
+		{
+			return BERT_ERRNO_INVALID;
+		}
+
+		bert_write_uint32(length,frame->count);
+
+		// skip the LIST magic byte
+		if ((result = bert_encoder_patch(encoder,frame->offset + 1,length,4)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+	}
+
+	if ((result = bert_encode_list_tail(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	--encoder->frames.length;
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_int(bert_encoder_t *encoder,int64_t i)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_integer(encoder,i)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_float(bert_encoder_t *encoder,double d)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_float(encoder,d)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_atom(bert_encoder_t *encoder,const char *atom)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_atom(encoder,atom,strlen(atom))) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_string(bert_encoder_t *encoder,const char *string)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_string(encoder,string,strlen(string))) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_bin(bert_encoder_t *encoder,const unsigned char *bin,size_t length)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_bin(encoder,bin,length)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_boolean(bert_encoder_t *encoder,unsigned int boolean)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_boolean(encoder,boolean)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_nil(bert_encoder_t *encoder)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encode_nil(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_put_term(bert_encoder_t *encoder,const bert_data_t *data)
+{
+	int result;
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encoder_push_term(encoder,data)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_builder_next(encoder);
+}
+
+int bert_encoder_splice(bert_encoder_t *encoder,const unsigned char *buffer,size_t length,size_t *consumed)
+{
+	size_t skip = 0;
+	size_t size;
+	int result;
+
+	if (length && bert_read_magic(buffer) == BERT_MAGIC)
+	{
+		// splicing a whole message
+		skip = 1;
+	}
+
+	if ((result = bert_raw_length(buffer + skip,length - skip,&size)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_builder_begin(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	// the input may be gone before the term is complete
+	if ((result = bert_encoder_write(encoder,buffer + skip,size)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (consumed)
+	{
+		*consumed = (skip + size);
+	}
+
+	return bert_builder_next(encoder);
+}
+
+unsigned int bert_encoder_depth(const bert_encoder_t *encoder)
+{
+	return encoder->frames.length;
+}
+
+void bert_encoder_reset_frames(bert_encoder_t *encoder)
+{
+	unsigned int i;
+
+	for (i=0;i<encoder->frames.length;i++)
+	{
+		if (encoder->frames.ptr[i].staged)
+		{
+			// drop the staged elements and restore the original mode
+			encoder->mode = encoder->frames.mode;
+			bert_encoder_reset_segments(encoder);
+			break;
+		}
+	}
+
+	encoder->frames.length = 0;
+}
+
+void bert_encoder_free_frames(bert_encoder_t *encoder)
+{
+	bert_free(encoder->allocator,encoder->frames.ptr);
+
+	encoder->frames.ptr = NULL;
+	encoder->frames.length = 0;
+	encoder->frames.size = 0;
+}
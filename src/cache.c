@@ -0,0 +1,288 @@
+#include <bert/cache.h>
+#include <bert/errno.h>
+#include <bert/walk.h>
+#include "private/cache.h"
+#include "private/encoder.h"
+#include "private/atomic.h"
+#include "private/alloc.h"
+#include "private/data.h"
+
+static struct bert_cache ** bert_cache_slot(const bert_data_t *data,unsigned int **flags,struct bert_cache_epoch ***epoch,const bert_allocator_t **allocator)
+{
+	switch (data->type)
+	{
+		case bert_data_tuple:
+			*flags = &(data->tuple->flags);
+			*epoch = &(data->tuple->epoch);
+			*allocator = data->tuple->allocator;
+			return &(data->tuple->cache);
+		case bert_data_list:
+			*flags = &(data->list->flags);
+			*epoch = &(data->list->epoch);
+			*allocator = data->list->allocator;
+			return &(data->list->cache);
+		case bert_data_dict:
+			*flags = &(data->dict->flags);
+			*epoch = &(data->dict->epoch);
+			*allocator = data->dict->allocator;
+			return &(data->dict->cache);
+		default:
+			return NULL;
+	}
+}
+
+static struct bert_cache_epoch * bert_cache_epoch_find(struct bert_cache_epoch *epoch)
+{
+	struct bert_cache_epoch *parent;
+
+	while ((parent = *((struct bert_cache_epoch * volatile *)&(epoch->parent))))
+	{
+		epoch = parent;
+	}
+
+	return epoch;
+}
+
+static void bert_cache_epoch_release(struct bert_cache_epoch *epoch)
+{
+	struct bert_cache_epoch *parent;
+
+	while (epoch && !BERT_ATOMIC_DEC(&(epoch->refs)))
+	{
+		// merged epochs hold a reference to the epoch they were merged into
+		parent = epoch->parent;
+		bert_free(epoch->allocator,epoch);
+		epoch = parent;
+	}
+}
+
+static void bert_cache_free(struct bert_cache *cache,const bert_allocator_t *allocator)
+{
+	if (cache)
+	{
+		bert_cache_epoch_release(cache->epoch);
+		bert_free(allocator,cache);
+	}
+}
+
+const struct bert_cache * bert_cache_lookup(const bert_data_t *data,unsigned int small_atoms,unsigned int maps)
+{
+	const bert_allocator_t *allocator;
+	struct bert_cache_epoch **epoch;
+	struct bert_cache **slot;
+	const struct bert_cache *cache;
+	unsigned int *flags;
+
+	if (!(slot = bert_cache_slot(data,&flags,&epoch,&allocator)))
+	{
+		return NULL;
+	}
+
+	if (!(cache = *((struct bert_cache * volatile *)slot)))
+	{
+		return NULL;
+	}
+
+	if (cache->epoch && (*((struct bert_cache_epoch * volatile *)&(cache->epoch->parent)) || cache->value != *((volatile unsigned int *)&(cache->epoch->value))))
+	{
+		return NULL;
+	}
+
+	if (cache->small_atoms != small_atoms || cache->maps != maps)
+	{
+		// the bytes were encoded differently than requested
+		return NULL;
+	}
+
+	return cache;
+}
+
+void bert_cache_invalidate(struct bert_cache **cache,struct bert_cache_epoch *epoch,const bert_allocator_t *allocator)
+{
+	if (*cache)
+	{
+		bert_cache_free(*cache,allocator);
+		*cache = NULL;
+	}
+
+	if (epoch)
+	{
+		// the caches of any data containing this container are now stale
+		BERT_ATOMIC_INC(&(bert_cache_epoch_find(epoch)->value));
+	}
+}
+
+void bert_cache_invalidate_data(bert_data_t *data)
+{
+	const bert_allocator_t *allocator;
+	struct bert_cache_epoch **epoch;
+	struct bert_cache **cache;
+	unsigned int *flags;
+
+	if ((cache = bert_cache_slot(data,&flags,&epoch,&allocator)))
+	{
+		bert_cache_invalidate(cache,*epoch,allocator);
+	}
+}
+
+void bert_cache_destroy(struct bert_cache *cache,struct bert_cache_epoch *epoch,const bert_allocator_t *allocator)
+{
+	bert_cache_free(cache,allocator);
+	bert_cache_epoch_release(epoch);
+}
+
+static int bert_cache_mark(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	struct bert_cache_epoch **marked = user_data;
+	struct bert_cache_epoch **epoch;
+	struct bert_cache_epoch *found;
+	const bert_allocator_t *allocator;
+	unsigned int *flags;
+
+	if (!bert_cache_slot(data,&flags,&epoch,&allocator))
+	{
+		return BERT_WALK_CONTINUE;
+	}
+
+	if (*flags & BERT_DATA_FROZEN)
+	{
+		// frozen containers only ever contain frozen data
+		return BERT_WALK_SKIP;
+	}
+
+	if (*epoch)
+	{
+		found = bert_cache_epoch_find(*epoch);
+
+		if (!*marked)
+		{
+			*marked = found;
+		}
+		else if (found != *marked)
+		{
+			// the container is covered by another cache as well
+			BERT_ATOMIC_INC(&((*marked)->refs));
+			found->parent = *marked;
+		}
+
+		return BERT_WALK_CONTINUE;
+	}
+
+	if (!*marked)
+	{
+		// epochs may outlive the allocator of any one container
+		if (!(*marked = bert_malloc(NULL,sizeof(struct bert_cache_epoch))))
+		{
+			// malloc failed
+			return BERT_ERRNO_MALLOC;
+		}
+
+		(*marked)->refs = 0;
+		(*marked)->value = 0;
+		(*marked)->parent = NULL;
+		(*marked)->allocator = NULL;
+	}
+
+	BERT_ATOMIC_INC(&((*marked)->refs));
+	*epoch = *marked;
+	*flags |= BERT_DATA_CACHED;
+	return BERT_WALK_CONTINUE;
+}
+
+static int bert_cache_build(bert_data_t *data,unsigned int small_atoms,unsigned int maps)
+{
+	const bert_allocator_t *allocator;
+	struct bert_cache_epoch **epoch;
+	struct bert_cache **cache;
+	unsigned int *flags;
+
+	if (!(cache = bert_cache_slot(data,&flags,&epoch,&allocator)))
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	if (data->flags & BERT_DATA_PACKED)
+	{
+		return BERT_ERRNO_FROZEN;
+	}
+
+	if (bert_cache_lookup(data,small_atoms,maps))
+	{
+		return BERT_SUCCESS;
+	}
+
+	struct bert_cache *old_cache = *((struct bert_cache * volatile *)cache);
+	struct bert_cache_epoch *marked = NULL;
+	struct bert_cache *new_cache;
+	size_t length;
+	int result;
+
+	if (!(length = bert_data_sizeof_encoded(data,small_atoms,maps)))
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	// modifying any of the containers must invalidate the new cache
+	if ((result = bert_data_walk(data,bert_cache_mark,NULL,&marked)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (!(new_cache = bert_malloc(allocator,sizeof(struct bert_cache) + length)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	new_cache->epoch = marked;
+	new_cache->value = 0;
+	new_cache->small_atoms = small_atoms;
+	new_cache->maps = maps;
+	new_cache->length = length;
+
+	if (marked)
+	{
+		BERT_ATOMIC_INC(&(marked->refs));
+		new_cache->value = *((volatile unsigned int *)&(marked->value));
+	}
+
+	if ((result = bert_encoder_push_exact(data,new_cache->bytes,length,0,small_atoms,maps)) != BERT_SUCCESS)
+	{
+		bert_cache_free(new_cache,allocator);
+		return result;
+	}
+
+	if (!BERT_ATOMIC_CAS(cache,old_cache,new_cache))
+	{
+		// another thread cached the data first
+		bert_cache_free(new_cache,allocator);
+		return BERT_SUCCESS;
+	}
+
+	bert_cache_free(old_cache,allocator);
+	return BERT_SUCCESS;
+}
+
+int bert_data_cache(bert_data_t *data)
+{
+	return bert_cache_build(data,0,0);
+}
+
+int bert_encoder_cache(const bert_encoder_t *encoder,bert_data_t *data)
+{
+	return bert_cache_build(data,encoder->small_atoms,encoder->maps);
+}
+
+void bert_data_uncache(bert_data_t *data)
+{
+	const bert_allocator_t *allocator;
+	struct bert_cache_epoch **epoch;
+	struct bert_cache **cache;
+	unsigned int *flags;
+
+	if ((cache = bert_cache_slot(data,&flags,&epoch,&allocator)) && *cache)
+	{
+		bert_cache_free(*cache,allocator);
+		*cache = NULL;
+	}
+}
@@ -1,50 +1,24 @@
 #include <bert/data.h>
+#include <bert/errno.h>
 #include "private/data.h"
 #include "private/regex.h"
+#include "private/atomic.h"
+#include "private/alloc.h"
+#include "private/reclaim.h"
+#include "private/walk.h"
+#include "private/raw.h"
+#include "private/cache.h"
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 
-bert_list_node_t * bert_list_node_create(bert_data_t *data)
-{
-	bert_list_node_t *new_node;
-
-	if (!(new_node = malloc(sizeof(bert_list_node_t))))
-	{
-		// malloc failed
-		return NULL;
-	}
-
-	new_node->data = data;
-	new_node->next = NULL;
-	return new_node;
-}
-
-void bert_list_node_destroy(bert_list_node_t *node)
-{
-	if (!(node))
-	{
-		return;
-	}
-
-	if (node->data)
-	{
-		bert_data_destroy(node->data);
-	}
-
-	if (node->next)
-	{
-		bert_list_node_destroy(node->next);
-	}
-
-	free(node);
-}
-
 bert_data_t * bert_data_create()
 {
+	const bert_allocator_t *allocator = bert_allocator_current();
 	bert_data_t *new_data;
 
-	if (!(new_data = malloc(sizeof(bert_data_t))))
+	if (!(new_data = bert_object_alloc(allocator,sizeof(bert_data_t))))
 	{
 		// malloc failed
 		return NULL;
@@ -54,6 +28,8 @@ bert_data_t * bert_data_create()
 
 	// be explicit about setting the type
 	new_data->type = bert_data_none;
+	new_data->refs = 1;
+	new_data->allocator = allocator;
 	return new_data;
 }
 
@@ -137,7 +113,7 @@ bert_data_t * bert_data_create_empty_atom(bert_atom_size_t length)
 	size_t new_length = length + 1;
 	char *new_name;
 
-	if (!(new_name = calloc(new_length,sizeof(char))))
+	if (!(new_name = bert_calloc(bert_allocator_current(),new_length,sizeof(char))))
 	{
 		// malloc failed
 		goto cleanup;
@@ -157,7 +133,7 @@ bert_data_t * bert_data_create_empty_atom(bert_atom_size_t length)
 	return new_data;
 
 cleanup_name:
-	free(new_name);
+	bert_free(bert_allocator_current(),new_name);
 cleanup:
 	return NULL;
 }
@@ -181,7 +157,7 @@ bert_data_t * bert_data_create_empty_string(bert_string_size_t length)
 	size_t new_length = length + 1;
 	char *new_text;
 
-	if (!(new_text = calloc(new_length,sizeof(char))))
+	if (!(new_text = bert_calloc(bert_allocator_current(),new_length,sizeof(char))))
 	{
 		goto cleanup;
 	}
@@ -199,7 +175,7 @@ bert_data_t * bert_data_create_empty_string(bert_string_size_t length)
 	return new_data;
 
 cleanup_text:
-	free(new_text);
+	bert_free(bert_allocator_current(),new_text);
 cleanup:
 	return NULL;
 }
@@ -304,7 +280,7 @@ bert_data_t * bert_data_create_empty_bin(bert_bin_size_t length)
 	size_t new_length = length + 1;
 	unsigned char *new_bin;
 
-	if (!(new_bin = calloc(new_length,sizeof(unsigned char))))
+	if (!(new_bin = bert_calloc(bert_allocator_current(),new_length,sizeof(unsigned char))))
 	{
 		// malloc failed
 		goto cleanup;
@@ -323,7 +299,7 @@ bert_data_t * bert_data_create_empty_bin(bert_bin_size_t length)
 	return new_data;
 
 cleanup_bin:
-	free(new_bin);
+	bert_free(bert_allocator_current(),new_bin);
 cleanup:
 	return NULL;
 }
@@ -342,6 +318,111 @@ bert_data_t * bert_data_create_bin(const unsigned char *binary_data,bert_bin_siz
 	return new_data;
 }
 
+static void bert_data_free_bin(unsigned char *data,void *user_data)
+{
+	bert_free((const bert_allocator_t *)user_data,data);
+}
+
+bert_data_t * bert_data_create_sub_bin(bert_data_t *parent,bert_bin_size_t offset,bert_bin_size_t length)
+{
+	if (parent->type != bert_data_bin)
+	{
+		return NULL;
+	}
+
+	if (offset > parent->bin.length || length > (parent->bin.length - offset))
+	{
+		// out of bounds
+		return NULL;
+	}
+
+	bert_bin_buffer_t *buffer;
+
+	if (!(buffer = parent->bin.buffer))
+	{
+		// hand the private binary data over to a shared buffer
+		if (!(buffer = bert_bin_buffer_create(parent->bin.data,parent->bin.length,bert_data_free_bin,(void *)parent->allocator)))
+		{
+			// malloc failed
+			return NULL;
+		}
+
+		if (!BERT_ATOMIC_CAS(&(parent->bin.buffer),NULL,buffer))
+		{
+			// another thread shared the binary data first
+			buffer->free = NULL;
+			bert_bin_buffer_unref(buffer);
+
+			buffer = parent->bin.buffer;
+		}
+	}
+
+	bert_data_t *new_data;
+
+	if (!(new_data = bert_data_create()))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	new_data->type = bert_data_bin;
+	new_data->bin.length = length;
+	new_data->bin.data = parent->bin.data + offset;
+	new_data->bin.buffer = bert_bin_buffer_ref(buffer);
+	return new_data;
+}
+
+bert_data_t * bert_data_create_file(int fd,off_t offset,bert_bin_size_t length)
+{
+	bert_data_t *new_data;
+
+	if (!(new_data = bert_data_create()))
+	{
+		return NULL;
+	}
+
+	new_data->type = bert_data_file;
+	new_data->file.length = length;
+	new_data->file.fd = fd;
+	new_data->file.offset = offset;
+	return new_data;
+}
+
+bert_data_t * bert_data_create_raw(const unsigned char *bytes,size_t length)
+{
+	size_t size;
+
+	if (bert_raw_length(bytes,length,&size) != BERT_SUCCESS || size != length)
+	{
+		// not a single complete term
+		return NULL;
+	}
+
+	unsigned char *new_raw;
+
+	if (!(new_raw = bert_malloc(bert_allocator_current(),sizeof(unsigned char)*length)))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	memcpy(new_raw,bytes,sizeof(unsigned char)*length);
+
+	bert_data_t *new_data;
+
+	if (!(new_data = bert_data_create()))
+	{
+		bert_free(bert_allocator_current(),new_raw);
+		return NULL;
+	}
+
+	new_data->type = bert_data_raw;
+	new_data->raw.length = length;
+	new_data->raw.data = new_raw;
+	new_data->raw.buffer = NULL;
+	return new_data;
+}
+
 bert_data_t * bert_data_create_time(time_t timestamp)
 {
 	bert_data_t *new_data;
@@ -362,7 +443,7 @@ bert_data_t * bert_data_create_regex(const char *source,bert_regex_size_t length
 	char *new_source;
 	size_t new_length = length + 1;
 
-	if (!(new_source = malloc(sizeof(char) * new_length)))
+	if (!(new_source = bert_malloc(bert_allocator_current(),sizeof(char) * new_length)))
 	{
 		// malloc failed
 		goto cleanup;
@@ -387,21 +468,36 @@ bert_data_t * bert_data_create_regex(const char *source,bert_regex_size_t length
 
 cleanup_source:
 	// free the new_source
-	free(new_source);
+	bert_free(bert_allocator_current(),new_source);
 cleanup:
 	// error
 	return NULL;
 }
 
-size_t bert_data_sizeof(const bert_data_t *data)
+struct bert_data_sizeof_state
 {
-	// magic byte
-	size_t count = 1;
+	size_t count;
+
+	unsigned int small_atoms;
+	unsigned int maps;
+};
 
+static int bert_data_sizeof_pre(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	struct bert_data_sizeof_state *state = user_data;
+	size_t count = 0;
+	unsigned int atoms = 0;
 	unsigned int i;
 	const char *name;
-	bert_list_node_t *list_node;
-	bert_dict_node_t *dict_node;
+
+	if (parent && parent->type == bert_data_dict && !(index & 0x01) && !state->maps)
+	{
+		// magic byte + small tuple length for each key and value pair
+		count += (1 + 1);
+	}
+
+	// magic byte
+	++count;
 
 	switch (data->type)
 	{
@@ -414,6 +510,11 @@ size_t bert_data_sizeof(const bert_data_t *data)
 		case bert_data_atom:
 			// atom length + data->atom.length
 			count += (2 + data->atom.length);
+
+			if (data->atom.length <= 0xff)
+			{
+				++atoms;
+			}
 			break;
 		case bert_data_string:
 			// string length + data->string.length
@@ -423,6 +524,14 @@ size_t bert_data_sizeof(const bert_data_t *data)
 			// binary length + data->bin.length
 			count += (4 + data->bin.length);
 			break;
+		case bert_data_file:
+			// binary length + data->file.length
+			count += (4 + data->file.length);
+			break;
+		case bert_data_raw:
+			// the raw bytes start with their own magic byte
+			count += (data->raw.length - 1);
+			break;
 		case bert_data_tuple:
 			if (data->tuple->length <= 0xff)
 			{
@@ -434,34 +543,23 @@ size_t bert_data_sizeof(const bert_data_t *data)
 			}
 			else
 			{
-				break;
-			}
-
-			for (i=0;i<data->tuple->length;i++)
-			{
-				count += bert_data_sizeof(data->tuple->elements[i]);
+				return BERT_ERRNO_INVALID;
 			}
 			break;
 		case bert_data_list:
-			count += 4;
-
-			list_node = data->list->head;
-
-			while (list_node)
-			{
-				count += bert_data_sizeof(list_node->data);
-
-				list_node = list_node->next;
-			}
+			// list length + NIL tail
+			count += (4 + 1);
 			break;
 		case bert_data_nil:
 			// small tuple length + magic byte + atom length + strlen("bert") +
 			// magic byte + atom length + strlen("nil")
 			count += (1 + 1 + 2 + 4 + 1 + 2 + 3);
+			atoms += 2;
 			break;
 		case bert_data_boolean:
 			// small tuple length + magic byte + atom length + strlen("bert")
 			count += (1 + 1 + 2 + 4);
+			atoms += 2;
 
 			switch (data->boolean)
 			{
@@ -474,38 +572,34 @@ size_t bert_data_sizeof(const bert_data_t *data)
 					count += (1 + 2 + 5);
 					break;
 				default:
-					break;
+					return BERT_ERRNO_INVALID;
 			}
 			break;
 		case bert_data_dict:
-			// small tuple length + magic byte + atom length + strlen("bert") +
-			// magic byte + atom length + strlen("dict") +
-			// magic byte + list length
-			count += (1 + 1 + 2 + 4 + 1 + 2 + 4 + 1 + 4);
-
-			dict_node = data->dict->head;
-
-			while (dict_node)
+			if (state->maps)
 			{
-				// magic byte + small tuple length
-				count += (1 + 1);
-
-				count += bert_data_sizeof(dict_node->key);
-				count += bert_data_sizeof(dict_node->value);
-
-				dict_node = dict_node->next;
+				// map arity
+				count += 4;
+				break;
 			}
+
+			// small tuple length + magic byte + atom length + strlen("bert") +
+			// magic byte + atom length + strlen("dict") +
+			// magic byte + list length + NIL tail
+			count += (1 + 1 + 2 + 4 + 1 + 2 + 4 + 1 + 4 + 1);
+			atoms += 2;
 			break;
 		case bert_data_regex:
 			// small tuple length + magic byte + atom length + strlen("bert") +
 			// magic byte + atom length + strlen("regex")
 			count += (1 + 1 + 2 + 4 + 1 + 2 + 5);
+			atoms += 2;
 
 			// magic byte + bin length + data->regex.length
 			count += (1 + 4 + data->regex.length);
 
-			// magic byte + list length
-			count += (1 + 4);
+			// magic byte + list length + NIL tail
+			count += (1 + 4 + 1);
 
 			for (i=0;i<sizeof(int);i++)
 			{
@@ -513,6 +607,7 @@ size_t bert_data_sizeof(const bert_data_t *data)
 				{
 					// magic byte + atom length + strlen(name)
 					count += (1 + 2 + strlen(name));
+					++atoms;
 				}
 			}
 			break;
@@ -520,21 +615,50 @@ size_t bert_data_sizeof(const bert_data_t *data)
 			// small tuple length + magic byte + atom length + strlen("bert") +
 			// magic byte + atom length + strlen("time")
 			count += (1 + 1 + 2 + 4 + 1 + 2 + 4);
+			atoms += 2;
 
-			// magic byte + integer bytes
-			count += (1 + bert_data_sizeof_int(data->time / 1000000));
+			// magic byte + integer bytes, encoded as unsigned ints
+			count += (1 + ((unsigned int)(data->time / 1000000) <= 0xff ? 1 : 4));
 
 			// magic byte + integer bytes
-			count += (1 + bert_data_sizeof_int(data->time % 1000000));
+			count += (1 + ((unsigned int)(data->time % 1000000) <= 0xff ? 1 : 4));
 
 			// magic byte + 0 byte
-			count += (1 + bert_data_sizeof_int(0));
+			count += (1 + 1);
 			break;
 		default:
-			return 0;
+			return BERT_ERRNO_INVALID;
 	}
 
-	return count;
+	if (state->small_atoms)
+	{
+		// SMALL_ATOM_EXT has a single byte length
+		count -= atoms;
+	}
+
+	state->count += count;
+	return BERT_WALK_CONTINUE;
+}
+
+size_t bert_data_sizeof_encoded(const bert_data_t *data,unsigned int small_atoms,unsigned int maps)
+{
+	struct bert_data_sizeof_state state;
+
+	state.count = 0;
+	state.small_atoms = small_atoms;
+	state.maps = maps;
+
+	if (bert_data_walk(data,bert_data_sizeof_pre,NULL,&state) != BERT_SUCCESS)
+	{
+		return 0;
+	}
+
+	return state.count;
+}
+
+size_t bert_data_sizeof(const bert_data_t *data)
+{
+	return bert_data_sizeof_encoded(data,0,0);
 }
 
 int bert_data_strequal(const bert_data_t *data,const char *str)
@@ -570,25 +694,183 @@ int bert_data_strequal(const bert_data_t *data,const char *str)
 	return memcmp(data_ptr,str,data_length) == 0;
 }
 
-void bert_data_destroy(bert_data_t *data)
+bert_data_t * bert_data_ref(bert_data_t *data)
 {
-	if (!data)
+	if (data)
 	{
-		return;
+		BERT_ATOMIC_INC(&(data->refs));
+	}
+
+	return data;
+}
+
+void bert_data_unref(bert_data_t *data)
+{
+	bert_data_destroy(data);
+}
+
+static int bert_data_freeze_pre(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	if (data->flags & BERT_DATA_FROZEN)
+	{
+		// frozen data only ever contains frozen data
+		return BERT_WALK_SKIP;
+	}
+
+	return BERT_WALK_CONTINUE;
+}
+
+static int bert_data_freeze_post(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	bert_data_t *frozen = (bert_data_t *)data;
+
+	// containers are only frozen once everything within them is
+	frozen->flags |= BERT_DATA_FROZEN;
+
+	switch (frozen->type)
+	{
+		case bert_data_tuple:
+			frozen->tuple->flags |= BERT_DATA_FROZEN;
+			break;
+		case bert_data_list:
+			frozen->list->flags |= BERT_DATA_FROZEN;
+			break;
+		case bert_data_dict:
+			frozen->dict->flags |= BERT_DATA_FROZEN;
+			break;
+		default:
+			break;
+	}
+
+	return BERT_WALK_CONTINUE;
+}
+
+int bert_data_freeze(bert_data_t *data)
+{
+	return bert_data_walk(data,bert_data_freeze_pre,bert_data_freeze_post,NULL);
+}
+
+int bert_data_tuple_set(bert_data_t **data_ptr,unsigned int index,bert_data_t *element)
+{
+	bert_data_t *data = *data_ptr;
+
+	if (data->type != bert_data_tuple || index >= data->tuple->length)
+	{
+		return BERT_ERRNO_INVALID;
 	}
 
+	if (data->refs == 1 && !(data->flags & BERT_DATA_FROZEN))
+	{
+		// we hold the only reference, modify the tuple in place
+		bert_tuple_set(data->tuple,index,element);
+		return BERT_SUCCESS;
+	}
+
+	bert_tuple_size_t length = data->tuple->length;
+	bert_data_t *new_data;
+
+	if (!(new_data = bert_data_create_tuple(length)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	unsigned int i;
+
+	for (i=0;i<length;i++)
+	{
+		if (i != index)
+		{
+			new_data->tuple->elements[i] = bert_data_ref(data->tuple->elements[i]);
+		}
+	}
+
+	new_data->tuple->elements[index] = element;
+
+	bert_data_unref(data);
+	*data_ptr = new_data;
+	return BERT_SUCCESS;
+}
+
+int bert_data_list_set(bert_data_t **data_ptr,unsigned int index,bert_data_t *element)
+{
+	bert_data_t *data = *data_ptr;
+
+	if (data->type != bert_data_list)
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	if (data->refs == 1 && !(data->flags & BERT_DATA_FROZEN))
+	{
+		// we hold the only reference, modify the list in place
+		return bert_list_set(data->list,index,element) ? BERT_SUCCESS : BERT_ERRNO_INVALID;
+	}
+
+	bert_data_t *new_data;
+
+	if (!(new_data = bert_data_create_list()))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	bert_list_node_t *next_node = data->list->head;
+	bert_list_node_t *index_node = NULL;
+	unsigned int i = 0;
+
+	while (next_node)
+	{
+		if (bert_list_append(new_data->list,(i == index ? NULL : next_node->data)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+
+		if (i == index)
+		{
+			index_node = new_data->list->tail;
+		}
+		else
+		{
+			bert_data_ref(next_node->data);
+		}
+
+		next_node = next_node->next;
+		++i;
+	}
+
+	if (!index_node)
+	{
+		bert_data_destroy(new_data);
+		return BERT_ERRNO_INVALID;
+	}
+
+	index_node->data = element;
+
+	bert_data_unref(data);
+	*data_ptr = new_data;
+	return BERT_SUCCESS;
+
+cleanup:
+	bert_data_destroy(new_data);
+	return BERT_ERRNO_MALLOC;
+}
+
+static void bert_data_free_payload(bert_data_t *data)
+{
 	switch (data->type)
 	{
 		case bert_data_int:
 		case bert_data_float:
 		case bert_data_nil:
 		case bert_data_none:
+		case bert_data_file:
 			break;
 		case bert_data_atom:
-			free(data->atom.name);
+			bert_free(data->allocator,data->atom.name);
 			break;
 		case bert_data_string:
-			free(data->string.text);
+			bert_free(data->allocator,data->string.text);
 			break;
 		case bert_data_tuple:
 			bert_tuple_destroy(data->tuple);
@@ -600,12 +882,179 @@ void bert_data_destroy(bert_data_t *data)
 			bert_dict_destroy(data->dict);
 			break;
 		case bert_data_bin:
-			free(data->bin.data);
+			if (data->bin.buffer)
+			{
+				bert_bin_buffer_unref(data->bin.buffer);
+			}
+			else
+			{
+				bert_free(data->allocator,data->bin.data);
+			}
+			break;
+		case bert_data_regex:
+			bert_free(data->allocator,data->regex.source);
+			break;
+		case bert_data_raw:
+			if (data->raw.buffer)
+			{
+				bert_bin_buffer_unref(data->raw.buffer);
+			}
+			else if (data->raw.data)
+			{
+				bert_free(data->allocator,data->raw.data);
+			}
 			break;
 		default:
 			// should never get here
 			break;
 	}
+}
+
+void bert_data_release(bert_data_t *data)
+{
+	bert_data_free_payload(data);
+
+	// leave an empty bert_data_t behind
+	memset(&(data->integer),0,sizeof(bert_data_t) - offsetof(bert_data_t,integer));
+	data->type = bert_data_none;
+	data->capacity = 0;
+}
+
+/*
+ * Releases a reference to the given bert_data_t. Once the last reference
+ * has been released, scalars are freed immediately while containers are
+ * pushed onto the given stack to be torn down.
+ */
+static void bert_data_drop(bert_data_t *data,bert_data_t **stack)
+{
+	if (!data)
+	{
+		return;
+	}
+
+	if (data->flags & BERT_DATA_PACKED)
+	{
+		// packed data is released along with its block
+		return;
+	}
+
+	if (data->refs > 1 && BERT_ATOMIC_DEC(&(data->refs)) > 0)
+	{
+		// still referenced elsewhere
+		return;
+	}
+
+	switch (data->type)
+	{
+		case bert_data_tuple:
+		case bert_data_list:
+		case bert_data_dict:
+			data->pending.next = *stack;
+			*stack = data;
+			return;
+		default:
+			break;
+	}
+
+	bert_data_free_payload(data);
+	bert_object_free(data->allocator,data,sizeof(bert_data_t));
+}
 
-	free(data);
+size_t bert_data_teardown(bert_data_t **stack,size_t budget)
+{
+	size_t count = 0;
+	bert_data_t *data;
+
+	while ((data = *stack) && (!budget || count < budget))
+	{
+		++count;
+
+		// release one element at a time, so that large containers
+		// can be torn down in slices
+		switch (data->type)
+		{
+			case bert_data_tuple:
+				if (data->tuple->length)
+				{
+					if (data->tuple->length > 1)
+					{
+						BERT_PREFETCH(data->tuple->elements[data->tuple->length - 2]);
+					}
+
+					bert_data_drop(data->tuple->elements[--(data->tuple->length)],stack);
+					continue;
+				}
+
+				bert_cache_destroy(data->tuple->cache,data->tuple->epoch,data->tuple->allocator);
+				bert_free(data->tuple->allocator,data->tuple->elements);
+				bert_object_free(data->tuple->allocator,data->tuple,sizeof(bert_tuple_t));
+				break;
+			case bert_data_list:
+				if (data->list->head)
+				{
+					bert_list_node_t *list_node = data->list->head;
+
+					if ((data->list->head = list_node->next))
+					{
+						BERT_PREFETCH(data->list->head);
+					}
+
+					bert_data_drop(list_node->data,stack);
+					bert_object_free(data->list->allocator,list_node,sizeof(bert_list_node_t));
+					continue;
+				}
+
+				bert_cache_destroy(data->list->cache,data->list->epoch,data->list->allocator);
+				bert_object_free(data->list->allocator,data->list,sizeof(bert_list_t));
+				break;
+			case bert_data_dict:
+				if (data->dict->head)
+				{
+					bert_dict_node_t *dict_node = data->dict->head;
+
+					if ((data->dict->head = dict_node->next))
+					{
+						BERT_PREFETCH(data->dict->head);
+					}
+
+					bert_data_drop(dict_node->key,stack);
+					bert_data_drop(dict_node->value,stack);
+					bert_object_free(data->dict->allocator,dict_node,sizeof(bert_dict_node_t));
+					continue;
+				}
+
+				bert_cache_destroy(data->dict->cache,data->dict->epoch,data->dict->allocator);
+				bert_object_free(data->dict->allocator,data->dict,sizeof(bert_dict_t));
+				break;
+			default:
+				// should never get here
+				break;
+		}
+
+		// the container is empty, pop it off of the stack
+		*stack = data->pending.next;
+		bert_object_free(data->allocator,data,sizeof(bert_data_t));
+	}
+
+	return count;
+}
+
+void bert_data_destroy(bert_data_t *data)
+{
+	bert_data_t *stack = NULL;
+
+	bert_data_drop(data,&stack);
+	bert_data_teardown(&stack,0);
+}
+
+void bert_data_destroy_async(bert_data_t *data)
+{
+	bert_data_t *stack = NULL;
+
+	bert_data_drop(data,&stack);
+
+	if (stack)
+	{
+		bert_reclaim_push(stack);
+	}
 }
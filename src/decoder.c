@@ -9,12 +9,16 @@
 
 #include "private/decoder.h"
 #include "private/decode.h"
+#include "private/compress.h"
+#include "private/atoms.h"
+#include "private/alloc.h"
 
 bert_decoder_t * bert_decoder_create()
 {
+	const bert_allocator_t *allocator = bert_allocator_current();
 	bert_decoder_t *new_decoder;
 
-	if (!(new_decoder = malloc(sizeof(bert_decoder_t))))
+	if (!(new_decoder = bert_malloc(allocator,sizeof(bert_decoder_t))))
 	{
 		// malloc failed
 		return NULL;
@@ -26,18 +30,31 @@ bert_decoder_t * bert_decoder_create()
 	new_decoder->short_index = 0;
 	memset(new_decoder->short_buffer,0,sizeof(unsigned char)*BERT_SHORT_BUFFER);
 
+	new_decoder->shared = NULL;
+	new_decoder->inflate = NULL;
+	new_decoder->atom_cache = NULL;
+	new_decoder->depth = 0;
+	new_decoder->raw_depth = 0;
+	new_decoder->allocator = allocator;
+	new_decoder->data_allocator = NULL;
 	new_decoder->total = 0;
 	return new_decoder;
 }
 
 void bert_decoder_stream(bert_decoder_t *decoder,int fd)
 {
+	bert_bin_buffer_unref(decoder->shared);
+	decoder->shared = NULL;
+
 	decoder->mode = bert_mode_stream;
 	decoder->stream = fd;
 }
 
 void bert_decoder_callback(bert_decoder_t *decoder,bert_read_func callback,void *data)
 {
+	bert_bin_buffer_unref(decoder->shared);
+	decoder->shared = NULL;
+
 	decoder->mode = bert_mode_callback;
 	decoder->callback.ptr = callback;
 	decoder->callback.data = data;
@@ -45,13 +62,52 @@ void bert_decoder_callback(bert_decoder_t *decoder,bert_read_func callback,void
 
 void bert_decoder_buffer(bert_decoder_t *decoder,const unsigned char *buffer,size_t length)
 {
+	bert_bin_buffer_unref(decoder->shared);
+	decoder->shared = NULL;
+
 	decoder->mode = bert_mode_buffer;
 	decoder->buffer.ptr = buffer;
 	decoder->buffer.length = length;
 	decoder->buffer.index = 0;
 }
 
-int bert_decoder_pull(bert_decoder_t *decoder,bert_data_t **data)
+void bert_decoder_shared_buffer(bert_decoder_t *decoder,bert_bin_buffer_t *buffer)
+{
+	bert_bin_buffer_ref(buffer);
+	bert_decoder_buffer(decoder,buffer->data,buffer->length);
+
+	decoder->shared = buffer;
+}
+
+void bert_decoder_allocator(bert_decoder_t *decoder,const bert_allocator_t *allocator)
+{
+	decoder->data_allocator = allocator;
+}
+
+int bert_decoder_atom_cache(bert_decoder_t *decoder,int enabled)
+{
+	if (!enabled)
+	{
+		bert_atom_cache_destroy(decoder->atom_cache);
+		decoder->atom_cache = NULL;
+		return BERT_SUCCESS;
+	}
+
+	if (!decoder->atom_cache && !(decoder->atom_cache = bert_atom_cache_create(decoder->allocator)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	return BERT_SUCCESS;
+}
+
+void bert_decoder_raw_depth(bert_decoder_t *decoder,unsigned int depth)
+{
+	decoder->raw_depth = depth;
+}
+
+static int bert_decoder_pull_data(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	
@@ -60,8 +116,10 @@ int bert_decoder_pull(bert_decoder_t *decoder,bert_data_t **data)
 		case BERT_SUCCESS:
 			break;
 		case BERT_ERRNO_EMPTY:
+			bert_data_destroy(reuse);
 			return 0;
 		default:
+			bert_data_destroy(reuse);
 			return result;
 	}
 
@@ -69,6 +127,7 @@ int bert_decoder_pull(bert_decoder_t *decoder,bert_data_t **data)
 	
 	if ((result = bert_decode_magic(decoder,&magic)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
@@ -77,50 +136,98 @@ int bert_decoder_pull(bert_decoder_t *decoder,bert_data_t **data)
 	{
 		if ((result = bert_decode_magic(decoder,&magic)) != BERT_SUCCESS)
 		{
+			bert_data_destroy(reuse);
 			return result;
 		}
+
+		if (magic == BERT_DIST_HEADER)
+		{
+			if ((result = bert_decode_dist_header(decoder)) != BERT_SUCCESS)
+			{
+				bert_data_destroy(reuse);
+				return result;
+			}
+
+			if ((result = bert_decode_magic(decoder,&magic)) != BERT_SUCCESS)
+			{
+				bert_data_destroy(reuse);
+				return result;
+			}
+		}
+		else if (decoder->atom_cache)
+		{
+			// references only last for the message of their header
+			decoder->atom_cache->message.length = 0;
+		}
+	}
+
+	if (decoder->raw_depth && decoder->depth >= decoder->raw_depth)
+	{
+		// keep the term as it was encoded
+		if ((result = bert_decode_raw(decoder,magic,data,reuse)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		return 1;
 	}
 
 	// decode primative data first
 	switch (magic)
 	{
 		case BERT_NIL:
-			result = bert_decode_nil(decoder,data);
+			result = bert_decode_nil(decoder,data,reuse);
 			break;
 		case BERT_SMALL_INT:
-			result = bert_decode_small_int(decoder,data);
+			result = bert_decode_small_int(decoder,data,reuse);
 			break;
 		case BERT_INT:
-			result = bert_decode_big_int(decoder,data);
+			result = bert_decode_big_int(decoder,data,reuse);
 			break;
 		case BERT_SMALL_BIGNUM:
-			result = bert_decode_small_bignum(decoder,data);
+			result = bert_decode_small_bignum(decoder,data,reuse);
 			break;
 		case BERT_LARGE_BIGNUM:
-			result = bert_decode_big_bignum(decoder,data);
+			result = bert_decode_big_bignum(decoder,data,reuse);
 			break;
 		case BERT_FLOAT:
-			result = bert_decode_float(decoder,data);
+			result = bert_decode_float(decoder,data,reuse);
 			break;
 		case BERT_ATOM:
-			result = bert_decode_atom(decoder,data);
+		case BERT_ATOM_UTF8:
+			// atom names are kept as the bytes they were encoded with
+			result = bert_decode_atom(decoder,data,reuse);
+			break;
+		case BERT_SMALL_ATOM:
+		case BERT_SMALL_ATOM_UTF8:
+			result = bert_decode_small_atom(decoder,data,reuse);
+			break;
+		case BERT_ATOM_CACHE_REF:
+			result = bert_decode_atom_cache_ref(decoder,data,reuse);
 			break;
 		case BERT_STRING:
-			result = bert_decode_string(decoder,data);
+			result = bert_decode_string(decoder,data,reuse);
 			break;
 		case BERT_BIN:
-			result = bert_decode_bin(decoder,data);
+			result = bert_decode_bin(decoder,data,reuse);
 			break;
 		case BERT_SMALL_TUPLE:
-			result = bert_decode_small_tuple(decoder,data);
+			result = bert_decode_small_tuple(decoder,data,reuse);
 			break;
 		case BERT_LARGE_TUPLE:
-			result = bert_decode_large_tuple(decoder,data);
+			result = bert_decode_large_tuple(decoder,data,reuse);
 			break;
 		case BERT_LIST:
-			result = bert_decode_list(decoder,data);
+			result = bert_decode_list(decoder,data,reuse);
+			break;
+		case BERT_MAP:
+			result = bert_decode_map(decoder,data,reuse);
+			break;
+		case BERT_COMPRESSED:
+			result = bert_decode_compressed(decoder,data,reuse);
 			break;
 		default:
+			bert_data_destroy(reuse);
 			return BERT_ERRNO_INVALID;
 	}
 
@@ -132,6 +239,56 @@ int bert_decoder_pull(bert_decoder_t *decoder,bert_data_t **data)
 	return 1;
 }
 
+int bert_decoder_pull_term(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	if (!decoder->data_allocator)
+	{
+		return bert_decoder_pull_data(decoder,data,reuse);
+	}
+
+	// allocate the decoded data with the decoder's own allocator
+	const bert_allocator_t *previous = bert_allocator_swap(decoder->data_allocator);
+	int result = bert_decoder_pull_data(decoder,data,reuse);
+
+	bert_allocator_swap(previous);
+	return result;
+}
+
+int bert_decoder_pull_element(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	int result;
+
+	++(decoder->depth);
+	result = bert_decoder_pull_term(decoder,data,reuse);
+	--(decoder->depth);
+
+	if (result == 0)
+	{
+		// running out of data within a term is a short read
+		return BERT_ERRNO_SHORT_READ;
+	}
+
+	return result;
+}
+
+int bert_decoder_pull(bert_decoder_t *decoder,bert_data_t **data)
+{
+	return bert_decoder_pull_term(decoder,data,NULL);
+}
+
+int bert_decoder_pull_into(bert_decoder_t *decoder,bert_data_t **data)
+{
+	int result;
+
+	if ((result = bert_decoder_pull_term(decoder,data,*data)) != 1)
+	{
+		// the previous bert_data_t has been destroyed
+		*data = NULL;
+	}
+
+	return result;
+}
+
 size_t bert_decoder_total(const bert_decoder_t *decoder)
 {
 	return decoder->total;
@@ -139,5 +296,8 @@ size_t bert_decoder_total(const bert_decoder_t *decoder)
 
 void bert_decoder_destroy(bert_decoder_t *decoder)
 {
-	free(decoder);
+	bert_bin_buffer_unref(decoder->shared);
+	bert_inflate_free(decoder);
+	bert_atom_cache_destroy(decoder->atom_cache);
+	bert_free(decoder->allocator,decoder);
 }
@@ -1,27 +1,39 @@
 #include <bert/dict.h>
 #include <bert/errno.h>
-
-#include <stdlib.h>
+#include "private/alloc.h"
+#include "private/cache.h"
 
 bert_dict_t * bert_dict_create()
 {
+	const bert_allocator_t *allocator = bert_allocator_current();
 	bert_dict_t *new_dict;
 
-	if (!(new_dict = malloc(sizeof(bert_dict_t))))
+	if (!(new_dict = bert_object_alloc(allocator,sizeof(bert_dict_t))))
 	{
 		return NULL;
 	}
 
 	new_dict->head = NULL;
 	new_dict->tail = NULL;
+	new_dict->flags = 0;
+	new_dict->allocator = allocator;
+	new_dict->cache = NULL;
+	new_dict->epoch = NULL;
 	return new_dict;
 }
 
 int bert_dict_append(bert_dict_t *dict,bert_data_t *key,bert_data_t *value)
 {
+	if (dict->flags & BERT_DATA_FROZEN)
+	{
+		return BERT_ERRNO_FROZEN;
+	}
+
+	bert_cache_invalidate(&(dict->cache),dict->epoch,dict->allocator);
+
 	bert_dict_node_t *new_node;
 
-	if (!(new_node = malloc(sizeof(bert_dict_node_t))))
+	if (!(new_node = bert_object_alloc(dict->allocator,sizeof(bert_dict_node_t))))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
@@ -44,6 +56,20 @@ int bert_dict_append(bert_dict_t *dict,bert_data_t *key,bert_data_t *value)
 	return BERT_SUCCESS;
 }
 
+size_t bert_dict_length(const bert_dict_t *dict)
+{
+	bert_dict_node_t *next_node = dict->head;
+	size_t length = 0;
+
+	while (next_node)
+	{
+		next_node = next_node->next;
+		++length;
+	}
+
+	return length;
+}
+
 void bert_dict_destroy(bert_dict_t *dict)
 {
 	bert_dict_node_t *last_node = NULL;
@@ -57,8 +83,9 @@ void bert_dict_destroy(bert_dict_t *dict)
 		bert_data_destroy(last_node->key);
 		bert_data_destroy(last_node->value);
 
-		free(last_node);
+		bert_object_free(dict->allocator,last_node,sizeof(bert_dict_node_t));
 	}
 
-	free(dict);
+	bert_cache_destroy(dict->cache,dict->epoch,dict->allocator);
+	bert_object_free(dict->allocator,dict,sizeof(bert_dict_t));
 }
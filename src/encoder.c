@@ -1,18 +1,27 @@
+#include <bert/config.h>
 #include <bert/encoder.h>
 #include <bert/magic.h>
 #include <bert/util.h>
 #include <bert/errno.h>
+#include <bert/walk.h>
 
 #include "private/encoder.h"
 #include "private/encode.h"
+#include "private/alloc.h"
+#include "private/cache.h"
+#include "private/compress.h"
+#include "private/atoms.h"
+#include "private/data.h"
 
-#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
 
 bert_encoder_t * bert_encoder_create()
 {
+	const bert_allocator_t *allocator = bert_allocator_current();
 	bert_encoder_t *new_encoder;
 
-	if (!(new_encoder = malloc(sizeof(bert_encoder_t))))
+	if (!(new_encoder = bert_malloc(allocator,sizeof(bert_encoder_t))))
 	{
 		// malloc failed
 		return NULL;
@@ -20,8 +29,38 @@ bert_encoder_t * bert_encoder_create()
 
 	new_encoder->mode = bert_mode_none;
 	new_encoder->wrote_magic = 0;
+	new_encoder->small_atoms = 0;
+	new_encoder->maps = 0;
+	new_encoder->partial_writes = 0;
+	new_encoder->compress.threshold = 0;
+	new_encoder->compress.level = 0;
+	new_encoder->atom_cache = NULL;
+	new_encoder->atom_refs = NULL;
 	new_encoder->total = 0;
 
+	new_encoder->allocator = allocator;
+	new_encoder->data_allocator = NULL;
+
+	new_encoder->output.block = NULL;
+	new_encoder->output.retired = NULL;
+	new_encoder->output.size = BERT_ENCODER_OUTPUT;
+	new_encoder->output.length = 0;
+	new_encoder->output.mark = 0;
+	new_encoder->output.allocator = NULL;
+
+	new_encoder->vector.ptr = NULL;
+	new_encoder->vector.length = 0;
+	new_encoder->vector.size = 0;
+
+	new_encoder->segments.head = NULL;
+	new_encoder->segments.tail = NULL;
+	new_encoder->segments.length = 0;
+
+	new_encoder->frames.ptr = NULL;
+	new_encoder->frames.length = 0;
+	new_encoder->frames.size = 0;
+	new_encoder->frames.mode = bert_mode_none;
+
 	return new_encoder;
 }
 
@@ -29,6 +68,41 @@ void bert_encoder_stream(bert_encoder_t *encoder,int stream)
 {
 	encoder->mode = bert_mode_stream;
 	encoder->stream = stream;
+
+	bert_encoder_reset_output(encoder);
+}
+
+int bert_encoder_mmap(bert_encoder_t *encoder,const char *path)
+{
+	int fd;
+
+	if ((fd = open(path,O_RDWR | O_CREAT | O_TRUNC,0644)) < 0)
+	{
+		return BERT_ERRNO_WRITE;
+	}
+
+	if (encoder->mode == bert_mode_mmap)
+	{
+		bert_encoder_unmap(encoder);
+	}
+
+	encoder->mode = bert_mode_mmap;
+	encoder->mapped.fd = fd;
+	encoder->mapped.ptr = NULL;
+	encoder->mapped.offset = 0;
+	encoder->mapped.size = 0;
+	encoder->mapped.length = 0;
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_mmap_close(bert_encoder_t *encoder)
+{
+	if (encoder->mode != bert_mode_mmap)
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	return bert_encoder_unmap(encoder);
 }
 
 void bert_encoder_buffer(bert_encoder_t *encoder,unsigned char *buffer,size_t length)
@@ -46,31 +120,122 @@ void bert_encoder_callback(bert_encoder_t *encoder,bert_write_func callback,void
 	encoder->callback.data = data;
 }
 
-int bert_encoder_push(bert_encoder_t *encoder,const bert_data_t *data)
+void bert_encoder_reserve(bert_encoder_t *encoder,bert_reserve_func reserve,bert_commit_func commit,void *data)
 {
-	if (!(encoder->wrote_magic))
+	encoder->mode = bert_mode_reserve;
+	encoder->sink.reserve = reserve;
+	encoder->sink.commit = commit;
+	encoder->sink.data = data;
+	encoder->sink.ptr = NULL;
+	encoder->sink.available = 0;
+	encoder->sink.used = 0;
+	encoder->sink.expected = 0;
+}
+
+void bert_encoder_iovec(bert_encoder_t *encoder)
+{
+	encoder->mode = bert_mode_iovec;
+
+	bert_encoder_reset_output(encoder);
+}
+
+const struct iovec * bert_encoder_iovec_get(const bert_encoder_t *encoder,unsigned int *count)
+{
+	*count = encoder->vector.length;
+	return encoder->vector.ptr;
+}
+
+void bert_encoder_iovec_clear(bert_encoder_t *encoder)
+{
+	bert_encoder_reset_output(encoder);
+}
+
+void bert_encoder_dynamic(bert_encoder_t *encoder)
+{
+	encoder->mode = bert_mode_dynamic;
+
+	bert_encoder_reset_segments(encoder);
+}
+
+int bert_encoder_take_buffer(bert_encoder_t *encoder,unsigned char **buffer,size_t *length)
+{
+	int result;
+
+	if (encoder->mode != bert_mode_dynamic)
 	{
-		int result;
+		return BERT_ERRNO_INVALID;
+	}
 
-		if ((result = bert_encode_magic(encoder,BERT_MAGIC)) != BERT_SUCCESS)
+	if ((result = bert_encoder_take_segments(encoder,buffer,length)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	bert_encoder_reset(encoder);
+	return BERT_SUCCESS;
+}
+
+void bert_encoder_reset(bert_encoder_t *encoder)
+{
+	encoder->wrote_magic = 0;
+	encoder->total = 0;
+
+	// abandon any term left open by the term builder
+	bert_encoder_reset_frames(encoder);
+
+	switch (encoder->mode)
+	{
+		case bert_mode_buffer:
+			encoder->buffer.index = 0;
+			break;
+		case bert_mode_iovec:
+			bert_encoder_reset_output(encoder);
+			break;
+		case bert_mode_dynamic:
+			bert_encoder_reset_segments(encoder);
+			break;
+		case bert_mode_reserve:
+			// abandon the reservation without committing it
+			encoder->sink.ptr = NULL;
+			encoder->sink.available = 0;
+			encoder->sink.used = 0;
+			encoder->sink.expected = 0;
+			break;
+		default:
+			break;
+	}
+}
+
+static int bert_encoder_push_pre(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	bert_encoder_t *encoder = user_data;
+	const struct bert_cache *cache;
+	int result;
+
+	if (parent && parent->type == bert_data_dict && !(index & 0x01) && !encoder->maps)
+	{
+		// each key and value pair is encoded as a tuple
+		if ((result = bert_encode_tuple_header(encoder,2)) != BERT_SUCCESS)
 		{
 			return result;
 		}
+	}
 
-		encoder->wrote_magic = 1;
+	if ((cache = bert_cache_lookup(data,encoder->small_atoms,encoder->maps)))
+	{
+		// write the cached bytes instead of encoding the container again
+		if ((result = bert_encoder_write_ref(encoder,cache->bytes,cache->length)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		return BERT_WALK_SKIP;
 	}
 
 	switch (data->type)
 	{
 		case bert_data_int:
-			if (data->integer <= BERT_MAX_INT && data->integer >= BERT_MIN_INT)
-			{
-				return bert_encode_int(encoder,data->integer);
-			}
-			else
-			{
-				return bert_encode_bignum(encoder,data->integer);
-			}
+			return bert_encode_integer(encoder,data->integer);
 		case bert_data_float:
 			return bert_encode_float(encoder,data->floating_point);
 		case bert_data_atom:
@@ -79,16 +244,26 @@ int bert_encoder_push(bert_encoder_t *encoder,const bert_data_t *data)
 			return bert_encode_string(encoder,data->string.text,data->string.length);
 		case bert_data_bin:
 			return bert_encode_bin(encoder,data->bin.data,data->bin.length);
+		case bert_data_file:
+			return bert_encode_file(encoder,data->file.fd,data->file.offset,data->file.length);
+		case bert_data_raw:
+			// already encoded
+			return bert_encoder_write_ref(encoder,data->raw.data,data->raw.length);
 		case bert_data_tuple:
-			return bert_encode_tuple(encoder,(const bert_data_t **)(data->tuple->elements),data->tuple->length);
+			return bert_encode_tuple_header(encoder,data->tuple->length);
 		case bert_data_list:
-			return bert_encode_list(encoder,data->list);
+			return bert_encode_list_header(encoder,bert_list_length(data->list));
 		case bert_data_nil:
 			return bert_encode_nil(encoder);
 		case bert_data_boolean:
 			return bert_encode_boolean(encoder,data->boolean);
 		case bert_data_dict:
-			return bert_encode_dict(encoder,data->dict);
+			if (encoder->maps)
+			{
+				return bert_encode_map_header(encoder,bert_dict_length(data->dict));
+			}
+
+			return bert_encode_dict_header(encoder,bert_dict_length(data->dict));
 		case bert_data_regex:
 			return bert_encode_regex(encoder,data->regex.source,data->regex.length,data->regex.options);
 		case bert_data_time:
@@ -100,6 +275,366 @@ int bert_encoder_push(bert_encoder_t *encoder,const bert_data_t *data)
 	return BERT_SUCCESS;
 }
 
+static int bert_encoder_push_post(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	bert_encoder_t *encoder = user_data;
+
+	switch (data->type)
+	{
+		case bert_data_list:
+			// terminate the list as a proper list
+			return bert_encode_list_tail(encoder);
+		case bert_data_dict:
+			// maps have no tail
+			return (encoder->maps ? BERT_SUCCESS : bert_encode_list_tail(encoder));
+		default:
+			return BERT_SUCCESS;
+	}
+}
+
+int bert_encoder_push_magic(bert_encoder_t *encoder)
+{
+	int result;
+
+	if (!(encoder->wrote_magic))
+	{
+		if ((result = bert_encode_magic(encoder,BERT_MAGIC)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		encoder->wrote_magic = 1;
+	}
+
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_push_term(bert_encoder_t *encoder,const bert_data_t *data)
+{
+	return bert_data_walk(data,bert_encoder_push_pre,bert_encoder_push_post,encoder);
+}
+
+static int bert_encoder_push_compressed(bert_encoder_t *encoder,const bert_data_t *data,size_t size)
+{
+	const bert_allocator_t *allocator = (encoder->data_allocator ? encoder->data_allocator : bert_allocator_current());
+	unsigned char *term;
+	unsigned char *compressed = NULL;
+	size_t compressed_length;
+	int result;
+
+	if (!(term = bert_malloc(allocator,size)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	if ((result = bert_encoder_push_exact(data,term,size,0,encoder->small_atoms,encoder->maps)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	if ((result = bert_deflate(allocator,term,size,encoder->compress.level,&compressed,&compressed_length)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	if ((1 + 4 + compressed_length) >= size)
+	{
+		// compressing the term did not make it any smaller
+		result = bert_encoder_write(encoder,term,size);
+		goto cleanup;
+	}
+
+	unsigned char header[1 + 4];
+
+	bert_write_magic(header,BERT_COMPRESSED);
+	bert_write_uint32(header+1,size);
+
+	if ((result = bert_encoder_write(encoder,header,1 + 4)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	result = bert_encoder_write(encoder,compressed,compressed_length);
+
+cleanup:
+	if (compressed)
+	{
+		bert_free(allocator,compressed);
+	}
+
+	bert_free(allocator,term);
+	return result;
+}
+
+static int bert_encoder_push_cached(bert_encoder_t *encoder,const bert_data_t *data,size_t size)
+{
+	const bert_allocator_t *allocator = (encoder->data_allocator ? encoder->data_allocator : bert_allocator_current());
+	bert_encoder_t term_encoder;
+	struct bert_atom_refs refs;
+	unsigned char *term;
+	int result;
+
+	if (!size)
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	// references are never longer than the atoms they replace
+	if (!(term = bert_malloc(allocator,size)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	memset(&term_encoder,0,sizeof(bert_encoder_t));
+
+	term_encoder.mode = bert_mode_buffer;
+	term_encoder.wrote_magic = 1;
+	term_encoder.small_atoms = encoder->small_atoms;
+	term_encoder.maps = encoder->maps;
+	term_encoder.atom_refs = &refs;
+	term_encoder.buffer.ptr = term;
+	term_encoder.buffer.length = size;
+
+	bert_atom_refs_begin(&refs,encoder->atom_cache);
+
+	// the header has to be written before the term which uses it
+	if ((result = bert_encoder_push_term(&term_encoder,data)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	if (refs.length)
+	{
+		// every message with a header starts with the magic byte
+		if ((result = bert_encode_magic(encoder,BERT_MAGIC)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+
+		encoder->wrote_magic = 1;
+
+		if ((result = bert_encode_dist_header(encoder,&refs)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+	}
+	else if ((result = bert_encoder_push_magic(encoder)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	if ((result = bert_encoder_write(encoder,term,term_encoder.buffer.index)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	bert_atom_refs_commit(&refs);
+
+cleanup:
+	bert_free(allocator,term);
+	return result;
+}
+
+int bert_encoder_push(bert_encoder_t *encoder,const bert_data_t *data)
+{
+	size_t size = 0;
+	int result;
+
+	if (encoder->mode == bert_mode_reserve)
+	{
+		// one reservation for the whole term, unless it wraps around
+		size = bert_encoder_sizeof(encoder,data);
+		encoder->sink.expected = size + !encoder->wrote_magic;
+	}
+
+	if (encoder->compress.threshold && (size ? size : (size = bert_encoder_sizeof(encoder,data))) >= encoder->compress.threshold)
+	{
+		if ((result = bert_encoder_push_magic(encoder)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		result = bert_encoder_push_compressed(encoder,data,size);
+	}
+	else if (encoder->atom_cache)
+	{
+		result = bert_encoder_push_cached(encoder,data,(size ? size : bert_encoder_sizeof(encoder,data)));
+	}
+	else
+	{
+		if ((result = bert_encoder_push_magic(encoder)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		result = bert_encoder_push_term(encoder,data);
+	}
+
+	if (result != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_encoder_flush(encoder);
+}
+
+size_t bert_encoder_sizeof(const bert_encoder_t *encoder,const bert_data_t *data)
+{
+	return bert_data_sizeof_encoded(data,encoder->small_atoms,encoder->maps);
+}
+
+int bert_encoder_flush(bert_encoder_t *encoder)
+{
+	switch (encoder->mode)
+	{
+		case bert_mode_stream:
+		case bert_mode_iovec:
+			return bert_encoder_flush_output(encoder);
+		case bert_mode_reserve:
+			bert_encoder_commit(encoder);
+			encoder->sink.expected = 0;
+			return BERT_SUCCESS;
+		default:
+			return BERT_SUCCESS;
+	}
+}
+
+int bert_encoder_output_size(bert_encoder_t *encoder,size_t size)
+{
+	int result;
+
+	if ((result = bert_encoder_flush(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (encoder->mode != bert_mode_iovec)
+	{
+		// the buffer is reallocated on the next write
+		bert_encoder_free_output(encoder);
+	}
+
+	encoder->output.size = size;
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_push_exact(const bert_data_t *data,unsigned char *buffer,size_t length,int magic,unsigned int small_atoms,unsigned int maps)
+{
+	bert_encoder_t encoder;
+	int result;
+
+	memset(&encoder,0,sizeof(bert_encoder_t));
+
+	// buffers sized by bert_data_sizeof may no longer fit data modified
+	// while it is being encoded
+	encoder.mode = bert_mode_buffer;
+	encoder.wrote_magic = !magic;
+	encoder.small_atoms = small_atoms;
+	encoder.maps = maps;
+	encoder.buffer.ptr = buffer;
+	encoder.buffer.length = length;
+
+	if ((result = bert_encoder_push(&encoder,data)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (encoder.buffer.index != length)
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	return BERT_SUCCESS;
+}
+
+int bert_encode_alloc(const bert_data_t *data,unsigned char **buffer,size_t *length)
+{
+	const bert_allocator_t *allocator = bert_allocator_current();
+	unsigned char *new_buffer;
+	size_t size;
+	int result;
+
+	if (!(size = bert_data_sizeof(data)))
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	// magic byte
+	++size;
+
+	if (!(new_buffer = bert_malloc(allocator,size)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	if ((result = bert_encoder_push_exact(data,new_buffer,size,1,0,0)) != BERT_SUCCESS)
+	{
+		bert_free(allocator,new_buffer);
+		return result;
+	}
+
+	*buffer = new_buffer;
+	*length = size;
+	return BERT_SUCCESS;
+}
+
+void bert_encoder_allocator(bert_encoder_t *encoder,const bert_allocator_t *allocator)
+{
+	encoder->data_allocator = allocator;
+}
+
+void bert_encoder_small_atoms(bert_encoder_t *encoder,int enabled)
+{
+	encoder->small_atoms = (enabled != 0);
+}
+
+void bert_encoder_maps(bert_encoder_t *encoder,int enabled)
+{
+	encoder->maps = (enabled != 0);
+}
+
+void bert_encoder_partial_writes(bert_encoder_t *encoder,int enabled)
+{
+	encoder->partial_writes = (enabled != 0);
+}
+
+int bert_encoder_atom_cache(bert_encoder_t *encoder,int enabled)
+{
+	if (!enabled)
+	{
+		bert_atom_cache_destroy(encoder->atom_cache);
+		encoder->atom_cache = NULL;
+		return BERT_SUCCESS;
+	}
+
+	if (!encoder->atom_cache && !(encoder->atom_cache = bert_atom_cache_create(encoder->allocator)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_compress(bert_encoder_t *encoder,size_t threshold,int level)
+{
+#if defined(BERT_ZLIB)
+	if (level < 0 || level > 9)
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	encoder->compress.threshold = threshold;
+	encoder->compress.level = level;
+	return BERT_SUCCESS;
+#else
+	return BERT_ERRNO_INVALID;
+#endif
+}
+
 size_t bert_encoder_total(const bert_encoder_t *encoder)
 {
 	return encoder->total;
@@ -107,5 +642,14 @@ size_t bert_encoder_total(const bert_encoder_t *encoder)
 
 void bert_encoder_destroy(bert_encoder_t *encoder)
 {
-	free(encoder);
+	if (encoder->mode == bert_mode_mmap)
+	{
+		bert_encoder_unmap(encoder);
+	}
+
+	bert_encoder_free_output(encoder);
+	bert_encoder_free_segments(encoder);
+	bert_encoder_free_frames(encoder);
+	bert_atom_cache_destroy(encoder->atom_cache);
+	bert_free(encoder->allocator,encoder);
 }
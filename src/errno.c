@@ -12,7 +12,9 @@ const char *bert_errors[] = {
 	"read error",
 	"write error",
 	"malloc failed",
-	"BERT large bignums are not fully supported yet"
+	"BERT large bignums are not fully supported yet",
+	"BERT data is frozen",
+	"failed to create thread"
 };
 
 const char * bert_strerror(int code)
@@ -0,0 +1,524 @@
+#include <bert/format.h>
+#include <bert/errno.h>
+#include "private/format.h"
+#include "private/encoder.h"
+#include "private/encode.h"
+#include "private/alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define BERT_FORMAT_OPS	8
+
+struct bert_format_compiler
+{
+	bert_encoder_t *encoder;
+	size_t mark;
+
+	struct bert_format_op *ops;
+	unsigned int count;
+	unsigned int size;
+	unsigned int holes;
+
+	const bert_allocator_t *allocator;
+};
+
+static const char * bert_format_skip(const char *ptr)
+{
+	while (isspace((unsigned char)*ptr))
+	{
+		++ptr;
+	}
+
+	return ptr;
+}
+
+static const char * bert_format_quoted(const char *ptr)
+{
+	char quote = *ptr;
+
+	for (++ptr;*ptr && *ptr != quote;ptr++)
+	{
+		if (*ptr == '\\' && ptr[1])
+		{
+			++ptr;
+		}
+	}
+
+	return (*ptr ? ptr + 1 : NULL);
+}
+
+/*
+ * Counts the elements of the tuple or list starting after ptr, without
+ * parsing them.
+ */
+static unsigned int bert_format_count(const char *ptr)
+{
+	unsigned int depth = 0;
+	unsigned int count = 0;
+	int empty = 1;
+
+	while (*ptr)
+	{
+		switch (*ptr)
+		{
+			case '{':
+			case '[':
+				++depth;
+				break;
+			case '}':
+			case ']':
+				if (!depth)
+				{
+					return (empty ? 0 : count + 1);
+				}
+
+				--depth;
+				break;
+			case ',':
+				if (!depth)
+				{
+					++count;
+				}
+				break;
+			case '\'':
+			case '"':
+				if (!(ptr = bert_format_quoted(ptr)))
+				{
+					return 0;
+				}
+
+				empty = 0;
+				continue;
+			default:
+				break;
+		}
+
+		if (!isspace((unsigned char)*ptr))
+		{
+			empty = 0;
+		}
+
+		++ptr;
+	}
+
+	return 0;
+}
+
+static int bert_format_append(struct bert_format_compiler *compiler,bert_format_op_type type,size_t offset,size_t length)
+{
+	if (compiler->count >= compiler->size)
+	{
+		unsigned int size = (compiler->size ? compiler->size * 2 : BERT_FORMAT_OPS);
+		struct bert_format_op *new_ops;
+
+		if (!(new_ops = bert_realloc(compiler->allocator,compiler->ops,sizeof(struct bert_format_op) * size)))
+		{
+			// malloc failed
+			return BERT_ERRNO_MALLOC;
+		}
+
+		compiler->ops = new_ops;
+		compiler->size = size;
+	}
+
+	struct bert_format_op *op = compiler->ops + compiler->count;
+
+	op->type = type;
+	op->offset = offset;
+	op->length = length;
+
+	++compiler->count;
+	return BERT_SUCCESS;
+}
+
+/*
+ * Ends the current run of pre-encoded bytes.
+ */
+static int bert_format_seal(struct bert_format_compiler *compiler)
+{
+	size_t length = compiler->encoder->segments.length;
+	int result;
+
+	if (length > compiler->mark)
+	{
+		if ((result = bert_format_append(compiler,bert_format_bytes,compiler->mark,length - compiler->mark)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		compiler->mark = length;
+	}
+
+	return BERT_SUCCESS;
+}
+
+static const char * bert_format_hole(struct bert_format_compiler *compiler,const char *ptr)
+{
+	bert_format_op_type type;
+
+	switch (ptr[1])
+	{
+		case 'i':
+			type = bert_format_int;
+			break;
+		case 'f':
+			type = bert_format_float;
+			break;
+		case 'a':
+			type = bert_format_atom;
+			break;
+		case 's':
+			type = bert_format_string;
+			break;
+		case 'b':
+			type = bert_format_bin;
+			break;
+		case 't':
+			type = bert_format_term;
+			break;
+		default:
+			return NULL;
+	}
+
+	if (bert_format_seal(compiler) != BERT_SUCCESS)
+	{
+		return NULL;
+	}
+
+	if (bert_format_append(compiler,type,0,0) != BERT_SUCCESS)
+	{
+		return NULL;
+	}
+
+	++compiler->holes;
+	return ptr + 2;
+}
+
+static const char * bert_format_literal(struct bert_format_compiler *compiler,const char *ptr)
+{
+	const char *end;
+	int result;
+
+	if (*ptr == '\'' || *ptr == '"')
+	{
+		if (!(end = bert_format_quoted(ptr)))
+		{
+			return NULL;
+		}
+
+		size_t length = (end - ptr) - 2;
+		char text[length + 1];
+		size_t i = 0;
+
+		for (++ptr;ptr < (end - 1);ptr++)
+		{
+			if (*ptr == '\\')
+			{
+				++ptr;
+			}
+
+			text[i++] = *ptr;
+		}
+
+		if (end[-1] == '\'')
+		{
+			result = bert_encode_atom(compiler->encoder,text,i);
+		}
+		else
+		{
+			result = bert_encode_string(compiler->encoder,text,i);
+		}
+
+		return (result == BERT_SUCCESS ? end : NULL);
+	}
+
+	if (*ptr == '-' || isdigit((unsigned char)*ptr))
+	{
+		char *number_end;
+		long long integer = strtoll(ptr,&number_end,10);
+
+		if (number_end == ptr)
+		{
+			return NULL;
+		}
+
+		return (bert_encode_integer(compiler->encoder,integer) == BERT_SUCCESS ? number_end : NULL);
+	}
+
+	if (islower((unsigned char)*ptr))
+	{
+		for (end=ptr;isalnum((unsigned char)*end) || *end == '_' || *end == '@';end++)
+		{
+		}
+
+		return (bert_encode_atom(compiler->encoder,ptr,end - ptr) == BERT_SUCCESS ? end : NULL);
+	}
+
+	return NULL;
+}
+
+static const char * bert_format_parse(struct bert_format_compiler *compiler,const char *ptr)
+{
+	char close;
+	unsigned int count;
+	unsigned int i;
+	int result;
+
+	ptr = bert_format_skip(ptr);
+
+	switch (*ptr)
+	{
+		case '~':
+			return bert_format_hole(compiler,ptr);
+		case '{':
+			close = '}';
+			count = bert_format_count(ptr + 1);
+			result = bert_encode_tuple_header(compiler->encoder,count);
+			break;
+		case '[':
+			close = ']';
+			count = bert_format_count(ptr + 1);
+			result = bert_encode_list_header(compiler->encoder,count);
+			break;
+		default:
+			return bert_format_literal(compiler,ptr);
+	}
+
+	if (result != BERT_SUCCESS)
+	{
+		return NULL;
+	}
+
+	++ptr;
+
+	for (i=0;i<count;i++)
+	{
+		if (i)
+		{
+			ptr = bert_format_skip(ptr);
+
+			if (*ptr != ',')
+			{
+				return NULL;
+			}
+
+			++ptr;
+		}
+
+		if (!(ptr = bert_format_parse(compiler,ptr)))
+		{
+			return NULL;
+		}
+	}
+
+	ptr = bert_format_skip(ptr);
+
+	if (*ptr != close)
+	{
+		return NULL;
+	}
+
+	if (close == ']' && bert_encode_list_tail(compiler->encoder) != BERT_SUCCESS)
+	{
+		return NULL;
+	}
+
+	return ptr + 1;
+}
+
+bert_format_t * bert_format_compile(const char *format)
+{
+	const bert_allocator_t *allocator = bert_allocator_current();
+	struct bert_format_compiler compiler;
+	bert_format_t *new_format = NULL;
+	const char *ptr;
+
+	memset(&compiler,0,sizeof(struct bert_format_compiler));
+	compiler.allocator = allocator;
+
+	if (!(compiler.encoder = bert_encoder_create()))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	bert_encoder_allocator(compiler.encoder,allocator);
+	bert_encoder_dynamic(compiler.encoder);
+
+	if (!(ptr = bert_format_parse(&compiler,format)))
+	{
+		goto cleanup;
+	}
+
+	if (*bert_format_skip(ptr) != '\0')
+	{
+		// trailing characters
+		goto cleanup;
+	}
+
+	if (bert_format_seal(&compiler) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	if (!(new_format = bert_malloc(allocator,sizeof(bert_format_t))))
+	{
+		// malloc failed
+		goto cleanup;
+	}
+
+	if (bert_encoder_take_buffer(compiler.encoder,&(new_format->bytes),&(new_format->length)) != BERT_SUCCESS)
+	{
+		bert_free(allocator,new_format);
+		new_format = NULL;
+		goto cleanup;
+	}
+
+	new_format->ops = compiler.ops;
+	new_format->count = compiler.count;
+	new_format->holes = compiler.holes;
+	new_format->allocator = allocator;
+
+	bert_encoder_destroy(compiler.encoder);
+	return new_format;
+
+cleanup:
+	bert_free(allocator,compiler.ops);
+	bert_encoder_destroy(compiler.encoder);
+	return NULL;
+}
+
+unsigned int bert_format_holes(const bert_format_t *format)
+{
+	return format->holes;
+}
+
+static int bert_format_fill(bert_encoder_t *encoder,const struct bert_format_op *op,const bert_format_arg_t *arg)
+{
+	switch (op->type)
+	{
+		case bert_format_int:
+			return bert_encode_integer(encoder,arg->integer);
+		case bert_format_float:
+			return bert_encode_float(encoder,arg->floating_point);
+		case bert_format_atom:
+			return bert_encode_atom(encoder,arg->atom,strlen(arg->atom));
+		case bert_format_string:
+			return bert_encode_string(encoder,arg->string,strlen(arg->string));
+		case bert_format_bin:
+			return bert_encode_bin(encoder,arg->bin.data,arg->bin.length);
+		case bert_format_term:
+			if (!arg->term)
+			{
+				return BERT_ERRNO_INVALID;
+			}
+
+			return bert_encoder_push_term(encoder,arg->term);
+		default:
+			return BERT_ERRNO_INVALID;
+	}
+}
+
+static int bert_format_run(bert_encoder_t *encoder,const bert_format_t *format,va_list *args,const bert_format_arg_t *array)
+{
+	const struct bert_format_op *op;
+	bert_format_arg_t arg;
+	unsigned int hole = 0;
+	unsigned int i;
+	int result;
+
+	if ((result = bert_encoder_push_magic(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	for (i=0;i<format->count;i++)
+	{
+		op = format->ops + i;
+
+		if (op->type == bert_format_bytes)
+		{
+			result = bert_encoder_write_ref(encoder,format->bytes + op->offset,op->length);
+		}
+		else
+		{
+			if (array)
+			{
+				arg = array[hole];
+			}
+			else
+			{
+				switch (op->type)
+				{
+					case bert_format_int:
+						arg.integer = va_arg(*args,int64_t);
+						break;
+					case bert_format_float:
+						arg.floating_point = va_arg(*args,double);
+						break;
+					case bert_format_atom:
+						arg.atom = va_arg(*args,const char *);
+						break;
+					case bert_format_string:
+						arg.string = va_arg(*args,const char *);
+						break;
+					case bert_format_bin:
+						arg.bin.data = va_arg(*args,const unsigned char *);
+						arg.bin.length = va_arg(*args,size_t);
+						break;
+					default:
+						arg.term = va_arg(*args,const bert_data_t *);
+						break;
+				}
+			}
+
+			result = bert_format_fill(encoder,op,&arg);
+			++hole;
+		}
+
+		if (result != BERT_SUCCESS)
+		{
+			return result;
+		}
+	}
+
+	return bert_encoder_flush(encoder);
+}
+
+int bert_format_push(bert_encoder_t *encoder,const bert_format_t *format,...)
+{
+	va_list args;
+	int result;
+
+	va_start(args,format);
+	result = bert_format_run(encoder,format,&args,NULL);
+	va_end(args);
+
+	return result;
+}
+
+int bert_format_vpush(bert_encoder_t *encoder,const bert_format_t *format,va_list args)
+{
+	va_list copy;
+	int result;
+
+	va_copy(copy,args);
+	result = bert_format_run(encoder,format,&copy,NULL);
+	va_end(copy);
+
+	return result;
+}
+
+int bert_format_push_args(bert_encoder_t *encoder,const bert_format_t *format,const bert_format_arg_t *args)
+{
+	return bert_format_run(encoder,format,NULL,args);
+}
+
+void bert_format_destroy(bert_format_t *format)
+{
+	bert_free(format->allocator,format->bytes);
+	bert_free(format->allocator,format->ops);
+	bert_free(format->allocator,format);
+}
@@ -1,27 +1,39 @@
 #include <bert/list.h>
 #include <bert/errno.h>
-
-#include <stdlib.h>
+#include "private/alloc.h"
+#include "private/cache.h"
 
 bert_list_t * bert_list_create()
 {
+	const bert_allocator_t *allocator = bert_allocator_current();
 	bert_list_t *new_list;
 
-	if (!(new_list = malloc(sizeof(bert_list_t))))
+	if (!(new_list = bert_object_alloc(allocator,sizeof(bert_list_t))))
 	{
 		return NULL;
 	}
 
 	new_list->head = NULL;
 	new_list->tail = NULL;
+	new_list->flags = 0;
+	new_list->allocator = allocator;
+	new_list->cache = NULL;
+	new_list->epoch = NULL;
 	return new_list;
 }
 
 int bert_list_append(bert_list_t *list,struct bert_data *data)
 {
+	if (list->flags & BERT_DATA_FROZEN)
+	{
+		return BERT_ERRNO_FROZEN;
+	}
+
+	bert_cache_invalidate(&(list->cache),list->epoch,list->allocator);
+
 	bert_list_node_t *new_node;
 
-	if (!(new_node = malloc(sizeof(bert_list_node_t))))
+	if (!(new_node = bert_object_alloc(list->allocator,sizeof(bert_list_node_t))))
 	{
 		// malloc failed
 		return BERT_ERRNO_MALLOC;
@@ -65,6 +77,11 @@ struct bert_data * bert_list_get(const bert_list_t *list,unsigned int index)
 
 int bert_list_set(bert_list_t *list,unsigned int index,struct bert_data *data)
 {
+	if (list->flags & BERT_DATA_FROZEN)
+	{
+		return 0;
+	}
+
 	bert_list_node_t *next_node = list->head;
 	unsigned int i = 0;
 
@@ -79,6 +96,7 @@ int bert_list_set(bert_list_t *list,unsigned int index,struct bert_data *data)
 		return 0;
 	}
 
+	bert_cache_invalidate(&(list->cache),list->epoch,list->allocator);
 	bert_data_destroy(next_node->data);
 	next_node->data = data;
 
@@ -119,8 +137,9 @@ void bert_list_destroy(bert_list_t *list)
 			bert_data_destroy(last_node->data);
 		}
 
-		free(last_node);
+		bert_object_free(list->allocator,last_node,sizeof(bert_list_node_t));
 	}
 
-	free(list);
+	bert_cache_destroy(list->cache,list->epoch,list->allocator);
+	bert_object_free(list->allocator,list,sizeof(bert_list_t));
 }
@@ -0,0 +1,574 @@
+#include <bert/packed.h>
+#include <bert/errno.h>
+#include "private/packed.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#define BERT_PACKER_PTR(packer,offset)	((packer)->buffer ? ((packer)->buffer + (offset)) : NULL)
+#define BERT_PACKED_RESOLVE(buffer,header,ptr)	((void *)((buffer) + ((uintptr_t)(ptr) - (header)->base)))
+
+static size_t bert_packed_alloc(struct bert_packer *packer,size_t size)
+{
+	size_t offset = packer->index;
+
+	packer->index += BERT_PACKED_ALIGN(size);
+	return offset;
+}
+
+static void bert_packed_pointer(struct bert_packer *packer,void *slot,size_t offset)
+{
+	if (slot)
+	{
+		*((uintptr_t *)slot) = offset;
+		packer->relocs[packer->reloc_count] = ((unsigned char *)slot - packer->buffer);
+	}
+
+	++(packer->reloc_count);
+}
+
+static void bert_packed_bytes(struct bert_packer *packer,void *slot,const void *bytes,size_t length)
+{
+	// +1 is for null terminating byte
+	size_t offset = bert_packed_alloc(packer,length + 1);
+	unsigned char *ptr;
+
+	if ((ptr = BERT_PACKER_PTR(packer,offset)))
+	{
+		memcpy(ptr,bytes,length);
+		ptr[length] = '\0';
+	}
+
+	bert_packed_pointer(packer,slot,offset);
+}
+
+static size_t bert_packed_data(struct bert_packer *packer,const bert_data_t *data);
+
+static size_t bert_packed_tuple(struct bert_packer *packer,const bert_tuple_t *tuple)
+{
+	size_t offset = bert_packed_alloc(packer,sizeof(bert_tuple_t));
+	size_t elements_offset = bert_packed_alloc(packer,sizeof(bert_data_t *) * tuple->length);
+
+	bert_tuple_t *new_tuple = (bert_tuple_t *)BERT_PACKER_PTR(packer,offset);
+	bert_data_t **new_elements = (bert_data_t **)BERT_PACKER_PTR(packer,elements_offset);
+
+	if (new_tuple)
+	{
+		new_tuple->length = tuple->length;
+		new_tuple->flags = BERT_DATA_FROZEN;
+		new_tuple->cache = NULL;
+		new_tuple->epoch = NULL;
+		new_tuple->allocator = NULL;
+	}
+
+	bert_packed_pointer(packer,(new_tuple ? &(new_tuple->elements) : NULL),elements_offset);
+
+	unsigned int i;
+	size_t element_offset;
+
+	for (i=0;i<tuple->length;i++)
+	{
+		if (!(tuple->elements[i]))
+		{
+			if (new_elements)
+			{
+				new_elements[i] = NULL;
+			}
+			continue;
+		}
+
+		element_offset = bert_packed_data(packer,tuple->elements[i]);
+		bert_packed_pointer(packer,(new_elements ? new_elements+i : NULL),element_offset);
+	}
+
+	return offset;
+}
+
+static size_t bert_packed_list(struct bert_packer *packer,const bert_list_t *list)
+{
+	size_t offset = bert_packed_alloc(packer,sizeof(bert_list_t));
+	bert_list_t *new_list = (bert_list_t *)BERT_PACKER_PTR(packer,offset);
+
+	if (new_list)
+	{
+		new_list->head = NULL;
+		new_list->tail = NULL;
+		new_list->flags = BERT_DATA_FROZEN;
+		new_list->cache = NULL;
+		new_list->epoch = NULL;
+		new_list->allocator = NULL;
+	}
+
+	bert_list_node_t *next_node = list->head;
+	bert_list_node_t *last_node = NULL;
+	bert_list_node_t *new_node;
+
+	size_t node_offset;
+	size_t data_offset;
+
+	while (next_node)
+	{
+		node_offset = bert_packed_alloc(packer,sizeof(bert_list_node_t));
+
+		if ((new_node = (bert_list_node_t *)BERT_PACKER_PTR(packer,node_offset)))
+		{
+			new_node->data = NULL;
+			new_node->next = NULL;
+		}
+
+		if (next_node->data)
+		{
+			data_offset = bert_packed_data(packer,next_node->data);
+			bert_packed_pointer(packer,(new_node ? &(new_node->data) : NULL),data_offset);
+		}
+
+		if (last_node)
+		{
+			bert_packed_pointer(packer,(new_node ? &(last_node->next) : NULL),node_offset);
+		}
+		else
+		{
+			bert_packed_pointer(packer,(new_node ? &(new_list->head) : NULL),node_offset);
+		}
+
+		last_node = new_node;
+		next_node = next_node->next;
+
+		if (!next_node)
+		{
+			bert_packed_pointer(packer,(new_node ? &(new_list->tail) : NULL),node_offset);
+		}
+	}
+
+	return offset;
+}
+
+static size_t bert_packed_dict(struct bert_packer *packer,const bert_dict_t *dict)
+{
+	size_t offset = bert_packed_alloc(packer,sizeof(bert_dict_t));
+	bert_dict_t *new_dict = (bert_dict_t *)BERT_PACKER_PTR(packer,offset);
+
+	if (new_dict)
+	{
+		new_dict->head = NULL;
+		new_dict->tail = NULL;
+		new_dict->flags = BERT_DATA_FROZEN;
+		new_dict->cache = NULL;
+		new_dict->epoch = NULL;
+		new_dict->allocator = NULL;
+	}
+
+	bert_dict_node_t *next_node = dict->head;
+	bert_dict_node_t *last_node = NULL;
+	bert_dict_node_t *new_node;
+
+	size_t node_offset;
+	size_t key_offset;
+	size_t value_offset;
+
+	while (next_node)
+	{
+		node_offset = bert_packed_alloc(packer,sizeof(bert_dict_node_t));
+
+		if ((new_node = (bert_dict_node_t *)BERT_PACKER_PTR(packer,node_offset)))
+		{
+			new_node->key = NULL;
+			new_node->value = NULL;
+			new_node->next = NULL;
+		}
+
+		key_offset = bert_packed_data(packer,next_node->key);
+		bert_packed_pointer(packer,(new_node ? &(new_node->key) : NULL),key_offset);
+
+		value_offset = bert_packed_data(packer,next_node->value);
+		bert_packed_pointer(packer,(new_node ? &(new_node->value) : NULL),value_offset);
+
+		if (last_node)
+		{
+			bert_packed_pointer(packer,(new_node ? &(last_node->next) : NULL),node_offset);
+		}
+		else
+		{
+			bert_packed_pointer(packer,(new_node ? &(new_dict->head) : NULL),node_offset);
+		}
+
+		last_node = new_node;
+		next_node = next_node->next;
+
+		if (!next_node)
+		{
+			bert_packed_pointer(packer,(new_node ? &(new_dict->tail) : NULL),node_offset);
+		}
+	}
+
+	return offset;
+}
+
+static size_t bert_packed_data(struct bert_packer *packer,const bert_data_t *data)
+{
+	size_t offset = bert_packed_alloc(packer,sizeof(bert_data_t));
+	bert_data_t *new_data = (bert_data_t *)BERT_PACKER_PTR(packer,offset);
+
+	if (new_data)
+	{
+		memcpy(new_data,data,sizeof(bert_data_t));
+
+		new_data->refs = 1;
+		new_data->flags = (BERT_DATA_FROZEN | BERT_DATA_PACKED);
+		new_data->capacity = 0;
+
+		// allocators only mean something within the packing process
+		new_data->allocator = NULL;
+	}
+
+	switch (data->type)
+	{
+		case bert_data_atom:
+			bert_packed_bytes(packer,(new_data ? &(new_data->atom.name) : NULL),data->atom.name,data->atom.length);
+			break;
+		case bert_data_string:
+			bert_packed_bytes(packer,(new_data ? &(new_data->string.text) : NULL),data->string.text,data->string.length);
+			break;
+		case bert_data_bin:
+			if (new_data)
+			{
+				new_data->bin.buffer = NULL;
+			}
+
+			bert_packed_bytes(packer,(new_data ? &(new_data->bin.data) : NULL),data->bin.data,data->bin.length);
+			break;
+		case bert_data_raw:
+			if (new_data)
+			{
+				new_data->raw.buffer = NULL;
+			}
+
+			bert_packed_bytes(packer,(new_data ? &(new_data->raw.data) : NULL),data->raw.data,data->raw.length);
+			break;
+		case bert_data_regex:
+			bert_packed_bytes(packer,(new_data ? &(new_data->regex.source) : NULL),data->regex.source,data->regex.length);
+			break;
+		case bert_data_tuple:
+			bert_packed_pointer(packer,(new_data ? &(new_data->tuple) : NULL),bert_packed_tuple(packer,data->tuple));
+			break;
+		case bert_data_list:
+			bert_packed_pointer(packer,(new_data ? &(new_data->list) : NULL),bert_packed_list(packer,data->list));
+			break;
+		case bert_data_dict:
+			bert_packed_pointer(packer,(new_data ? &(new_data->dict) : NULL),bert_packed_dict(packer,data->dict));
+			break;
+		default:
+			break;
+	}
+
+	return offset;
+}
+
+static void bert_packed_measure(const bert_data_t *data,size_t *data_length,size_t *reloc_count)
+{
+	struct bert_packer packer;
+
+	packer.buffer = NULL;
+	packer.index = 0;
+	packer.relocs = NULL;
+	packer.reloc_count = 0;
+
+	bert_packed_alloc(&packer,sizeof(struct bert_packed));
+	bert_packed_data(&packer,data);
+
+	*data_length = packer.index;
+	*reloc_count = packer.reloc_count;
+}
+
+size_t bert_packed_sizeof(const bert_data_t *data)
+{
+	size_t data_length;
+	size_t reloc_count;
+
+	bert_packed_measure(data,&data_length,&reloc_count);
+	return data_length + (sizeof(uint64_t) * reloc_count);
+}
+
+int bert_packed_create(const bert_data_t *data,void *buffer,size_t length)
+{
+	if ((uintptr_t)buffer & 7)
+	{
+		// the block must be aligned for the structures within it
+		return BERT_ERRNO_INVALID;
+	}
+
+	size_t data_length;
+	size_t reloc_count;
+
+	bert_packed_measure(data,&data_length,&reloc_count);
+
+	size_t packed_length = data_length + (sizeof(uint64_t) * reloc_count);
+
+	if (packed_length > length)
+	{
+		return BERT_ERRNO_SHORT_WRITE;
+	}
+
+	struct bert_packer packer;
+
+	packer.buffer = buffer;
+	packer.index = 0;
+	packer.relocs = (uint64_t *)(packer.buffer + data_length);
+	packer.reloc_count = 0;
+
+	struct bert_packed *header = (struct bert_packed *)(packer.buffer + bert_packed_alloc(&packer,sizeof(struct bert_packed)));
+
+	header->magic = BERT_PACKED_MAGIC;
+	header->version = BERT_PACKED_VERSION;
+	header->length = packed_length;
+	header->base = 0;
+	header->root = bert_packed_data(&packer,data);
+	header->reloc_offset = data_length;
+	header->reloc_count = reloc_count;
+	return BERT_SUCCESS;
+}
+
+static const struct bert_packed * bert_packed_header(const void *buffer,size_t length)
+{
+	const struct bert_packed *header = buffer;
+
+	if (((uintptr_t)buffer & 7) || length < sizeof(struct bert_packed))
+	{
+		return NULL;
+	}
+
+	if (header->magic != BERT_PACKED_MAGIC || header->version != BERT_PACKED_VERSION)
+	{
+		return NULL;
+	}
+
+	if (header->length > length || (header->root + sizeof(bert_data_t)) > header->length)
+	{
+		return NULL;
+	}
+
+	if (header->reloc_offset > header->length || header->reloc_count > ((header->length - header->reloc_offset) / sizeof(uint64_t)))
+	{
+		return NULL;
+	}
+
+	const unsigned char *bytes = buffer;
+	const uint64_t *relocs = (const uint64_t *)(bytes + header->reloc_offset);
+	uint64_t slot;
+	uint64_t target;
+	unsigned int i;
+
+	for (i=0;i<header->reloc_count;i++)
+	{
+		if ((slot = relocs[i]) & 7 || (slot + sizeof(uintptr_t)) > header->reloc_offset)
+		{
+			return NULL;
+		}
+
+		target = (*((const uintptr_t *)(bytes + slot)) - header->base);
+
+		if (target >= header->reloc_offset)
+		{
+			return NULL;
+		}
+	}
+
+	return header;
+}
+
+static void bert_packed_relocate(unsigned char *buffer,uint64_t base)
+{
+	struct bert_packed *header = (struct bert_packed *)buffer;
+	uint64_t *relocs = (uint64_t *)(buffer + header->reloc_offset);
+	unsigned int i;
+
+	for (i=0;i<header->reloc_count;i++)
+	{
+		*((uintptr_t *)(buffer + relocs[i])) += (base - header->base);
+	}
+
+	header->base = base;
+}
+
+bert_data_t * bert_packed_attach(void *buffer,size_t length)
+{
+	if (!bert_packed_header(buffer,length))
+	{
+		return NULL;
+	}
+
+	unsigned char *bytes = buffer;
+	struct bert_packed *header = buffer;
+
+	if (header->base != (uintptr_t)bytes)
+	{
+		// the block was created, detached or copied elsewhere
+		bert_packed_relocate(bytes,(uintptr_t)bytes);
+	}
+
+	return (bert_data_t *)(bytes + header->root);
+}
+
+int bert_packed_detach(void *buffer,size_t length)
+{
+	if (!bert_packed_header(buffer,length))
+	{
+		return BERT_ERRNO_INVALID;
+	}
+
+	bert_packed_relocate(buffer,0);
+	return BERT_SUCCESS;
+}
+
+static bert_data_t * bert_packed_inflate_data(const unsigned char *buffer,const struct bert_packed *header,const bert_data_t *data)
+{
+	bert_data_t *new_data = NULL;
+	bert_data_t *element;
+	unsigned int i;
+
+	const bert_tuple_t *tuple;
+	bert_data_t **elements;
+
+	const bert_list_node_t *list_node;
+	const bert_dict_node_t *dict_node;
+	bert_data_t *key;
+	bert_data_t *value;
+
+	switch (data->type)
+	{
+		case bert_data_atom:
+			if (!(new_data = bert_data_create_empty_atom(data->atom.length)))
+			{
+				return NULL;
+			}
+
+			memcpy(new_data->atom.name,BERT_PACKED_RESOLVE(buffer,header,data->atom.name),data->atom.length);
+			return new_data;
+		case bert_data_string:
+			if (!(new_data = bert_data_create_empty_string(data->string.length)))
+			{
+				return NULL;
+			}
+
+			memcpy(new_data->string.text,BERT_PACKED_RESOLVE(buffer,header,data->string.text),data->string.length);
+			return new_data;
+		case bert_data_bin:
+			return bert_data_create_bin(BERT_PACKED_RESOLVE(buffer,header,data->bin.data),data->bin.length);
+		case bert_data_raw:
+			return bert_data_create_raw(BERT_PACKED_RESOLVE(buffer,header,data->raw.data),data->raw.length);
+		case bert_data_regex:
+			return bert_data_create_regex(BERT_PACKED_RESOLVE(buffer,header,data->regex.source),data->regex.length,data->regex.options);
+		case bert_data_tuple:
+			tuple = BERT_PACKED_RESOLVE(buffer,header,data->tuple);
+			elements = BERT_PACKED_RESOLVE(buffer,header,tuple->elements);
+
+			if (!(new_data = bert_data_create_tuple(tuple->length)))
+			{
+				return NULL;
+			}
+
+			for (i=0;i<tuple->length;i++)
+			{
+				if (!(elements[i]))
+				{
+					continue;
+				}
+
+				if (!(new_data->tuple->elements[i] = bert_packed_inflate_data(buffer,header,BERT_PACKED_RESOLVE(buffer,header,elements[i]))))
+				{
+					goto cleanup;
+				}
+			}
+			return new_data;
+		case bert_data_list:
+			if (!(new_data = bert_data_create_list()))
+			{
+				return NULL;
+			}
+
+			list_node = (((const bert_list_t *)BERT_PACKED_RESOLVE(buffer,header,data->list))->head);
+
+			while (list_node)
+			{
+				list_node = BERT_PACKED_RESOLVE(buffer,header,list_node);
+				element = NULL;
+
+				if (list_node->data && !(element = bert_packed_inflate_data(buffer,header,BERT_PACKED_RESOLVE(buffer,header,list_node->data))))
+				{
+					goto cleanup;
+				}
+
+				if (bert_list_append(new_data->list,element) != BERT_SUCCESS)
+				{
+					bert_data_destroy(element);
+					goto cleanup;
+				}
+
+				list_node = list_node->next;
+			}
+			return new_data;
+		case bert_data_dict:
+			if (!(new_data = bert_data_create_dict()))
+			{
+				return NULL;
+			}
+
+			dict_node = (((const bert_dict_t *)BERT_PACKED_RESOLVE(buffer,header,data->dict))->head);
+
+			while (dict_node)
+			{
+				dict_node = BERT_PACKED_RESOLVE(buffer,header,dict_node);
+
+				if (!(key = bert_packed_inflate_data(buffer,header,BERT_PACKED_RESOLVE(buffer,header,dict_node->key))))
+				{
+					goto cleanup;
+				}
+
+				if (!(value = bert_packed_inflate_data(buffer,header,BERT_PACKED_RESOLVE(buffer,header,dict_node->value))))
+				{
+					bert_data_destroy(key);
+					goto cleanup;
+				}
+
+				if (bert_dict_append(new_data->dict,key,value) != BERT_SUCCESS)
+				{
+					bert_data_destroy(value);
+					bert_data_destroy(key);
+					goto cleanup;
+				}
+
+				dict_node = dict_node->next;
+			}
+			return new_data;
+		default:
+			if (!(new_data = bert_data_create()))
+			{
+				return NULL;
+			}
+
+			// scalar data contains no pointers, but keeps the allocator
+			// it was just created with
+			new_data->type = data->type;
+			memcpy(&(new_data->integer),&(data->integer),sizeof(bert_data_t) - offsetof(bert_data_t,integer));
+			return new_data;
+	}
+
+cleanup:
+	bert_data_destroy(new_data);
+	return NULL;
+}
+
+bert_data_t * bert_packed_inflate(const void *buffer,size_t length)
+{
+	const struct bert_packed *header;
+
+	if (!(header = bert_packed_header(buffer,length)))
+	{
+		return NULL;
+	}
+
+	const unsigned char *bytes = buffer;
+
+	return bert_packed_inflate_data(bytes,header,(const bert_data_t *)(bytes + header->root));
+}
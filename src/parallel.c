@@ -0,0 +1,254 @@
+#include <bert/encoder.h>
+#include <bert/util.h>
+#include <bert/errno.h>
+#include "private/encoder.h"
+#include "private/encode.h"
+#include "private/alloc.h"
+#include "private/cache.h"
+
+#include <pthread.h>
+#include <string.h>
+
+/*
+ * Range of the top-level elements of a term, encoded by a single thread
+ * into the segments of its own encoder.
+ */
+struct bert_parallel_range
+{
+	const bert_data_t *data;
+
+	size_t index;
+	size_t length;
+	const bert_list_node_t *node;
+
+	bert_encoder_t *encoder;
+	pthread_t thread;
+	int started;
+	int result;
+};
+
+static void * bert_parallel_encode(void *ptr)
+{
+	struct bert_parallel_range *range = ptr;
+	const bert_list_node_t *node = range->node;
+	const bert_data_t *element;
+	size_t i;
+
+	range->result = BERT_SUCCESS;
+
+	for (i=0;i<range->length;i++)
+	{
+		if (range->data->type == bert_data_list)
+		{
+			element = node->data;
+			node = node->next;
+		}
+		else
+		{
+			element = range->data->tuple->elements[range->index + i];
+		}
+
+		if ((range->result = bert_encoder_push_term(range->encoder,element)) != BERT_SUCCESS)
+		{
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Writes the segments encoded for a range out to the encoder.
+ */
+static int bert_parallel_write(bert_encoder_t *encoder,const struct bert_parallel_range *range)
+{
+	const struct bert_encoder_segment *segment;
+	size_t length = range->encoder->segments.length;
+	size_t chunk;
+	int result;
+
+	for (segment=range->encoder->segments.head;segment && length;segment=segment->next)
+	{
+		chunk = MIN(segment->length,length);
+
+		if (encoder->mode == bert_mode_iovec)
+		{
+			// the segments are freed before the iovecs are written
+			result = bert_encoder_write(encoder,segment->data,chunk);
+		}
+		else
+		{
+			result = bert_encoder_write_ref(encoder,segment->data,chunk);
+		}
+
+		if (result != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		length -= chunk;
+	}
+
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_push_parallel(bert_encoder_t *encoder,const bert_data_t *data,unsigned int threads)
+{
+	size_t length;
+
+	switch (data->type)
+	{
+		case bert_data_tuple:
+			length = data->tuple->length;
+			break;
+		case bert_data_list:
+			length = bert_list_length(data->list);
+			break;
+		default:
+			return bert_encoder_push(encoder,data);
+	}
+
+	if (threads > (length / BERT_ENCODER_PARALLEL_MIN))
+	{
+		threads = (length / BERT_ENCODER_PARALLEL_MIN);
+	}
+
+	if (threads < 2 || encoder->atom_cache || encoder->compress.threshold || bert_cache_lookup(data,encoder->small_atoms,encoder->maps))
+	{
+		// not worth splitting, or the term has to be encoded as a whole
+		return bert_encoder_push(encoder,data);
+	}
+
+	struct bert_parallel_range *ranges;
+	struct bert_parallel_range *range;
+	const bert_list_node_t *node = (data->type == bert_data_list ? data->list->head : NULL);
+	size_t index = 0;
+	unsigned int i;
+	int result = BERT_SUCCESS;
+
+	if (!(ranges = bert_calloc(encoder->allocator,threads,sizeof(struct bert_parallel_range))))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	for (i=0;i<threads;i++)
+	{
+		range = ranges + i;
+		range->data = data;
+		range->index = index;
+		range->length = (length / threads) + (i < (length % threads));
+		range->node = node;
+
+		if (!(range->encoder = bert_encoder_create()))
+		{
+			// malloc failed
+			result = BERT_ERRNO_MALLOC;
+			goto cleanup;
+		}
+
+		bert_encoder_dynamic(range->encoder);
+		range->encoder->small_atoms = encoder->small_atoms;
+		range->encoder->maps = encoder->maps;
+
+		if (node)
+		{
+			size_t skip;
+
+			for (skip=0;skip<range->length;skip++)
+			{
+				node = node->next;
+			}
+		}
+
+		index += range->length;
+	}
+
+	// the first range is encoded by the calling thread
+	for (i=1;i<threads;i++)
+	{
+		range = ranges + i;
+		range->started = !pthread_create(&(range->thread),NULL,bert_parallel_encode,range);
+	}
+
+	for (i=0;i<threads;i++)
+	{
+		if (!ranges[i].started)
+		{
+			// encode the range here if its thread could not be started
+			bert_parallel_encode(ranges + i);
+		}
+	}
+
+	for (i=1;i<threads;i++)
+	{
+		if (ranges[i].started)
+		{
+			pthread_join(ranges[i].thread,NULL);
+		}
+	}
+
+	for (i=0;i<threads;i++)
+	{
+		if ((result = ranges[i].result) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+	}
+
+	if ((result = bert_encoder_push_magic(encoder)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	if (data->type == bert_data_list)
+	{
+		result = bert_encode_list_header(encoder,length);
+	}
+	else
+	{
+		result = bert_encode_tuple_header(encoder,length);
+	}
+
+	if (result != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	for (i=0;i<threads;i++)
+	{
+		if ((result = bert_parallel_write(encoder,ranges + i)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+	}
+
+	if (data->type == bert_data_list)
+	{
+		if ((result = bert_encode_list_tail(encoder)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+	}
+
+	// referenced segments must be written before they are freed
+	result = bert_encoder_flush(encoder);
+
+cleanup:
+	if (result != BERT_SUCCESS && encoder->mode == bert_mode_stream)
+	{
+		// drop any references to the segments about to be freed
+		bert_encoder_reset_output(encoder);
+	}
+
+	for (i=0;i<threads;i++)
+	{
+		if (ranges[i].encoder)
+		{
+			bert_encoder_destroy(ranges[i].encoder);
+		}
+	}
+
+	bert_free(encoder->allocator,ranges);
+	return result;
+}
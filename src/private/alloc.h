@@ -0,0 +1,21 @@
+#ifndef _BERT_PRIVATE_ALLOC_H_
+#define _BERT_PRIVATE_ALLOC_H_
+
+#include <bert/alloc.h>
+
+const bert_allocator_t * bert_allocator_current();
+const bert_allocator_t * bert_allocator_swap(const bert_allocator_t *allocator);
+
+void * bert_malloc(const bert_allocator_t *allocator,size_t size);
+void * bert_calloc(const bert_allocator_t *allocator,size_t count,size_t size);
+void * bert_realloc(const bert_allocator_t *allocator,void *ptr,size_t size);
+void bert_free(const bert_allocator_t *allocator,void *ptr);
+
+/*
+ * Allocates and frees fixed sized objects, which may be taken from the
+ * slab pools. The size given when freeing must match the allocated size.
+ */
+void * bert_object_alloc(const bert_allocator_t *allocator,size_t size);
+void bert_object_free(const bert_allocator_t *allocator,void *ptr,size_t size);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _BERT_PRIVATE_ATOMIC_H_
+#define _BERT_PRIVATE_ATOMIC_H_
+
+#define BERT_ATOMIC_INC(ptr)	__sync_add_and_fetch((ptr),1)
+#define BERT_ATOMIC_DEC(ptr)	__sync_sub_and_fetch((ptr),1)
+#define BERT_ATOMIC_SWAP(ptr,new_value)	__sync_lock_test_and_set((ptr),(new_value))
+#define BERT_ATOMIC_CAS(ptr,old_value,new_value)	__sync_bool_compare_and_swap((ptr),(old_value),(new_value))
+
+#endif
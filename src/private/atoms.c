@@ -0,0 +1,153 @@
+#include "atoms.h"
+#include "alloc.h"
+
+#include <string.h>
+
+struct bert_atom_cache * bert_atom_cache_create(const bert_allocator_t *allocator)
+{
+	struct bert_atom_cache *new_cache;
+
+	if (!(new_cache = bert_calloc(allocator,1,sizeof(struct bert_atom_cache))))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	new_cache->allocator = allocator;
+	return new_cache;
+}
+
+void bert_atom_cache_destroy(struct bert_atom_cache *cache)
+{
+	unsigned int i;
+
+	if (!cache)
+	{
+		return;
+	}
+
+	for (i=0;i<BERT_ATOM_CACHE_SIZE;i++)
+	{
+		if (cache->entries[i].name)
+		{
+			bert_free(cache->allocator,cache->entries[i].name);
+		}
+	}
+
+	bert_free(cache->allocator,cache);
+}
+
+unsigned int bert_atom_cache_index(const char *name,size_t length)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	// FNV-1a
+	for (i=0;i<length;i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+
+	return (hash ^ (hash >> 16)) & (BERT_ATOM_CACHE_SIZE - 1);
+}
+
+char * bert_atom_cache_store(struct bert_atom_cache *cache,unsigned int index,size_t length)
+{
+	struct bert_atom_entry *entry = cache->entries + index;
+
+	if (entry->name)
+	{
+		bert_free(cache->allocator,entry->name);
+	}
+
+	entry->length = 0;
+
+	if (!(entry->name = bert_malloc(cache->allocator,length + 1)))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	entry->name[length] = '\0';
+	entry->length = length;
+	return entry->name;
+}
+
+void bert_atom_refs_begin(struct bert_atom_refs *refs,struct bert_atom_cache *cache)
+{
+	refs->cache = cache;
+	refs->length = 0;
+
+	if (!(++cache->stamp))
+	{
+		unsigned int i;
+
+		// the stamps wrapped around, so old stamps could match again
+		for (i=0;i<BERT_ATOM_CACHE_SIZE;i++)
+		{
+			cache->entries[i].stamp = 0;
+		}
+
+		cache->stamp = 1;
+	}
+}
+
+int bert_atom_refs_lookup(struct bert_atom_refs *refs,const char *name,size_t length)
+{
+	struct bert_atom_cache *cache = refs->cache;
+	unsigned int index = bert_atom_cache_index(name,length);
+	struct bert_atom_entry *entry = cache->entries + index;
+	struct bert_atom_ref *ref;
+
+	if (entry->stamp == cache->stamp)
+	{
+		ref = refs->refs + entry->ref;
+
+		if (ref->length == length && !memcmp(ref->name,name,length))
+		{
+			return entry->ref;
+		}
+
+		// the entry is taken by another atom in this message
+		return -1;
+	}
+
+	if (refs->length >= BERT_ATOM_CACHE_REFS || length > 0xffff)
+	{
+		return -1;
+	}
+
+	ref = refs->refs + refs->length;
+	ref->index = index;
+	ref->name = name;
+	ref->length = length;
+	ref->new_entry = !(entry->name && entry->length == length && !memcmp(entry->name,name,length));
+
+	entry->stamp = cache->stamp;
+	entry->ref = refs->length;
+	return refs->length++;
+}
+
+void bert_atom_refs_commit(struct bert_atom_refs *refs)
+{
+	const struct bert_atom_ref *ref;
+	char *name;
+	unsigned int i;
+
+	for (i=0;i<refs->length;i++)
+	{
+		ref = refs->refs + i;
+
+		if (!ref->new_entry)
+		{
+			continue;
+		}
+
+		// an entry left empty is simply sent in full again
+		if ((name = bert_atom_cache_store(refs->cache,ref->index,ref->length)))
+		{
+			memcpy(name,ref->name,sizeof(char)*ref->length);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#ifndef _BERT_PRIVATE_ATOMS_H_
+#define _BERT_PRIVATE_ATOMS_H_
+
+#include <bert/alloc.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Number of entries in an atom cache, addressed by a 3 bit segment index
+ * and an 8 bit internal segment index.
+ */
+#define BERT_ATOM_CACHE_SIZE	2048
+
+/*
+ * Largest number of atom cache references in a distribution header.
+ */
+#define BERT_ATOM_CACHE_REFS	255
+
+struct bert_atom_entry
+{
+	char *name;
+	size_t length;
+
+	// message the entry was last referenced in, and by which reference
+	unsigned int stamp;
+	unsigned int ref;
+};
+
+/*
+ * Atom cache kept by an encoder or decoder for the lifetime of a
+ * connection. The entries of both ends are kept in sync by the
+ * distribution headers sent along with each message.
+ */
+struct bert_atom_cache
+{
+	const bert_allocator_t *allocator;
+	unsigned int stamp;
+
+	// entries referenced by the message being decoded
+	struct
+	{
+		unsigned int length;
+		uint16_t index[BERT_ATOM_CACHE_REFS];
+	} message;
+
+	struct bert_atom_entry entries[BERT_ATOM_CACHE_SIZE];
+};
+
+struct bert_atom_ref
+{
+	unsigned int index;
+	int new_entry;
+
+	const char *name;
+	size_t length;
+};
+
+/*
+ * Atom cache references collected while encoding a single message.
+ */
+struct bert_atom_refs
+{
+	struct bert_atom_cache *cache;
+	unsigned int length;
+
+	struct bert_atom_ref refs[BERT_ATOM_CACHE_REFS];
+};
+
+struct bert_atom_cache * bert_atom_cache_create(const bert_allocator_t *allocator);
+void bert_atom_cache_destroy(struct bert_atom_cache *cache);
+
+/*
+ * Returns the cache entry an atom of the given name is stored in.
+ */
+unsigned int bert_atom_cache_index(const char *name,size_t length);
+
+/*
+ * Replaces the name of a cache entry with a new name of the given length,
+ * and returns the buffer to fill it in, or NULL if malloc failed.
+ */
+char * bert_atom_cache_store(struct bert_atom_cache *cache,unsigned int index,size_t length);
+
+void bert_atom_refs_begin(struct bert_atom_refs *refs,struct bert_atom_cache *cache);
+
+/*
+ * Returns the reference to use for an atom in the message, or -1 if the
+ * atom has to be encoded in full.
+ */
+int bert_atom_refs_lookup(struct bert_atom_refs *refs,const char *name,size_t length);
+
+/*
+ * Stores the new entries of a message in the cache, once it has been sent.
+ */
+void bert_atom_refs_commit(struct bert_atom_refs *refs);
+
+#endif
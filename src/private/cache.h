@@ -0,0 +1,63 @@
+#ifndef _BERT_PRIVATE_CACHE_H_
+#define _BERT_PRIVATE_CACHE_H_
+
+#include <bert/cache.h>
+#include <bert/alloc.h>
+
+/*
+ * Epoch shared by the containers covered by one or more caches. Modifying
+ * any of them advances the epoch, which invalidates only the caches built
+ * against it. Epochs of overlapping caches are merged by pointing one at
+ * the other, and the caches built against the merged epoch become stale.
+ */
+struct bert_cache_epoch
+{
+	unsigned int refs;
+	unsigned int value;
+	struct bert_cache_epoch *parent;
+
+	const bert_allocator_t *allocator;
+};
+
+/*
+ * Encoded bytes of a tuple, list or dict. A cache is only valid while the
+ * epoch it was built against has not been advanced or merged. A cache
+ * without an epoch only covers frozen containers, and is always valid.
+ */
+struct bert_cache
+{
+	struct bert_cache_epoch *epoch;
+	unsigned int value;
+
+	// the encoder settings the bytes were encoded with
+	unsigned int small_atoms;
+	unsigned int maps;
+
+	size_t length;
+
+	unsigned char bytes[];
+};
+
+/*
+ * Returns the valid cache of the given data, encoded with the given small
+ * atoms and maps settings, or NULL.
+ */
+const struct bert_cache * bert_cache_lookup(const bert_data_t *data,unsigned int small_atoms,unsigned int maps);
+
+/*
+ * Drops the cache of a container which is about to be modified, given its
+ * epoch and allocator.
+ */
+void bert_cache_invalidate(struct bert_cache **cache,struct bert_cache_epoch *epoch,const bert_allocator_t *allocator);
+
+/*
+ * Drops the cache of the given data, if it is a container.
+ */
+void bert_cache_invalidate_data(bert_data_t *data);
+
+/*
+ * Frees the cache and releases the epoch of a container being destroyed.
+ */
+void bert_cache_destroy(struct bert_cache *cache,struct bert_cache_epoch *epoch,const bert_allocator_t *allocator);
+
+#endif
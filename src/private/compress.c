@@ -0,0 +1,310 @@
+#include <bert/config.h>
+#include "compress.h"
+#include "decoder.h"
+#include "alloc.h"
+
+#include <bert/util.h>
+#include <bert/errno.h>
+
+#include <string.h>
+
+#if defined(BERT_ZLIB)
+#include <zlib.h>
+
+/*
+ * State kept by a decoder while it inflates a compressed term. The
+ * compressed bytes are read into the input buffer, and inflated into the
+ * short buffer as it is consumed.
+ */
+struct bert_inflate
+{
+	z_stream stream;
+	int active;
+	size_t remaining;
+
+	unsigned char input[BERT_SHORT_BUFFER];
+};
+
+static voidpf bert_zlib_alloc(voidpf opaque,uInt items,uInt size)
+{
+	return bert_malloc(opaque,(size_t)items * size);
+}
+
+static void bert_zlib_free(voidpf opaque,voidpf ptr)
+{
+	bert_free(opaque,ptr);
+}
+
+int bert_inflate_begin(bert_decoder_t *decoder,size_t size)
+{
+	struct bert_inflate *state = decoder->inflate;
+
+	if (state && state->active)
+	{
+		// compressed terms cannot be nested
+		return BERT_ERRNO_INVALID;
+	}
+
+	if (!state)
+	{
+		if (!(state = bert_malloc(decoder->allocator,sizeof(struct bert_inflate))))
+		{
+			// malloc failed
+			return BERT_ERRNO_MALLOC;
+		}
+
+		memset(&(state->stream),0,sizeof(z_stream));
+		state->stream.zalloc = bert_zlib_alloc;
+		state->stream.zfree = bert_zlib_free;
+		state->stream.opaque = (voidpf)(decoder->allocator);
+
+		if (inflateInit(&(state->stream)) != Z_OK)
+		{
+			bert_free(decoder->allocator,state);
+			return BERT_ERRNO_MALLOC;
+		}
+
+		decoder->inflate = state;
+	}
+
+	size_t unread = (decoder->short_length - decoder->short_index);
+
+	// the rest of the short buffer is compressed
+	memcpy(state->input,decoder->short_buffer+decoder->short_index,sizeof(unsigned char)*unread);
+
+	state->stream.next_in = state->input;
+	state->stream.avail_in = unread;
+
+	decoder->short_length = 0;
+	decoder->short_index = 0;
+
+	state->active = 1;
+	state->remaining = size;
+	return BERT_SUCCESS;
+}
+
+static ssize_t bert_inflate_input(bert_decoder_t *decoder,struct bert_inflate *state)
+{
+	ssize_t length;
+
+	if ((length = bert_decoder_source(decoder,state->input,BERT_SHORT_BUFFER)) <= 0)
+	{
+		return length;
+	}
+
+	decoder->total += length;
+
+	state->stream.next_in = state->input;
+	state->stream.avail_in = length;
+	return length;
+}
+
+ssize_t bert_inflate_fill(bert_decoder_t *decoder,unsigned char *ptr,size_t space)
+{
+	struct bert_inflate *state = decoder->inflate;
+	size_t length = MIN(space,state->remaining);
+	ssize_t input;
+	int status;
+
+	state->stream.next_out = ptr;
+	state->stream.avail_out = length;
+
+	while (state->stream.avail_out)
+	{
+		if (!state->stream.avail_in)
+		{
+			if ((input = bert_inflate_input(decoder,state)) < 0)
+			{
+				return input;
+			}
+
+			if (!input)
+			{
+				// the compressed data was cut short
+				break;
+			}
+		}
+
+		status = inflate(&(state->stream),Z_NO_FLUSH);
+
+		if (status == Z_STREAM_END)
+		{
+			break;
+		}
+
+		if (status != Z_OK && status != Z_BUF_ERROR)
+		{
+			return BERT_ERRNO_INVALID;
+		}
+	}
+
+	length -= state->stream.avail_out;
+	state->remaining -= length;
+	return length;
+}
+
+int bert_inflate_end(bert_decoder_t *decoder)
+{
+	struct bert_inflate *state = decoder->inflate;
+	unsigned char extra;
+	ssize_t input;
+	int status = Z_OK;
+
+	state->active = 0;
+
+	if (state->remaining || decoder->short_index != decoder->short_length)
+	{
+		// the term did not take up the uncompressed size
+		bert_inflate_abort(decoder);
+		return BERT_ERRNO_INVALID;
+	}
+
+	// read up to the end of the zlib stream, and its checksum
+	while (status != Z_STREAM_END)
+	{
+		if (!state->stream.avail_in)
+		{
+			if ((input = bert_inflate_input(decoder,state)) <= 0)
+			{
+				bert_inflate_abort(decoder);
+				return (input ? input : BERT_ERRNO_SHORT_READ);
+			}
+		}
+
+		state->stream.next_out = &extra;
+		state->stream.avail_out = 1;
+
+		status = inflate(&(state->stream),Z_NO_FLUSH);
+
+		if ((status != Z_OK && status != Z_STREAM_END) || !state->stream.avail_out)
+		{
+			bert_inflate_abort(decoder);
+			return BERT_ERRNO_INVALID;
+		}
+	}
+
+	// bytes following the compressed term belong to the next term
+	memcpy(decoder->short_buffer,state->stream.next_in,sizeof(unsigned char)*state->stream.avail_in);
+
+	decoder->short_length = state->stream.avail_in;
+	decoder->short_index = 0;
+
+	inflateReset(&(state->stream));
+	return BERT_SUCCESS;
+}
+
+void bert_inflate_abort(bert_decoder_t *decoder)
+{
+	struct bert_inflate *state = decoder->inflate;
+
+	if (!state)
+	{
+		return;
+	}
+
+	state->active = 0;
+	state->stream.avail_in = 0;
+	inflateReset(&(state->stream));
+
+	decoder->short_length = 0;
+	decoder->short_index = 0;
+}
+
+void bert_inflate_free(bert_decoder_t *decoder)
+{
+	if (!decoder->inflate)
+	{
+		return;
+	}
+
+	inflateEnd(&(decoder->inflate->stream));
+	bert_free(decoder->allocator,decoder->inflate);
+	decoder->inflate = NULL;
+}
+
+int bert_inflate_active(const bert_decoder_t *decoder)
+{
+	return (decoder->inflate && decoder->inflate->active);
+}
+
+int bert_deflate(const bert_allocator_t *allocator,const unsigned char *data,size_t length,int level,unsigned char **buffer,size_t *buffer_length)
+{
+	z_stream stream;
+	unsigned char *new_buffer;
+	size_t size;
+	int result;
+
+	memset(&stream,0,sizeof(z_stream));
+	stream.zalloc = bert_zlib_alloc;
+	stream.zfree = bert_zlib_free;
+	stream.opaque = (voidpf)allocator;
+
+	if (deflateInit(&stream,level) != Z_OK)
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	size = deflateBound(&stream,length);
+
+	if (!(new_buffer = bert_malloc(allocator,size)))
+	{
+		// malloc failed
+		result = BERT_ERRNO_MALLOC;
+		goto cleanup;
+	}
+
+	stream.next_in = (unsigned char *)data;
+	stream.avail_in = length;
+	stream.next_out = new_buffer;
+	stream.avail_out = size;
+
+	if (deflate(&stream,Z_FINISH) != Z_STREAM_END)
+	{
+		bert_free(allocator,new_buffer);
+		result = BERT_ERRNO_INVALID;
+		goto cleanup;
+	}
+
+	*buffer = new_buffer;
+	*buffer_length = stream.total_out;
+	result = BERT_SUCCESS;
+
+cleanup:
+	deflateEnd(&stream);
+	return result;
+}
+#else
+int bert_inflate_begin(bert_decoder_t *decoder,size_t size)
+{
+	// compressed terms are not supported without zlib
+	return BERT_ERRNO_INVALID;
+}
+
+ssize_t bert_inflate_fill(bert_decoder_t *decoder,unsigned char *ptr,size_t space)
+{
+	return BERT_ERRNO_INVALID;
+}
+
+int bert_inflate_end(bert_decoder_t *decoder)
+{
+	return BERT_ERRNO_INVALID;
+}
+
+void bert_inflate_abort(bert_decoder_t *decoder)
+{
+}
+
+void bert_inflate_free(bert_decoder_t *decoder)
+{
+}
+
+int bert_inflate_active(const bert_decoder_t *decoder)
+{
+	return 0;
+}
+
+int bert_deflate(const bert_allocator_t *allocator,const unsigned char *data,size_t length,int level,unsigned char **buffer,size_t *buffer_length)
+{
+	return BERT_ERRNO_INVALID;
+}
+#endif
@@ -0,0 +1,41 @@
+#ifndef _BERT_PRIVATE_COMPRESS_H_
+#define _BERT_PRIVATE_COMPRESS_H_
+
+#include <bert/decoder.h>
+#include <bert/alloc.h>
+
+#include <sys/types.h>
+
+/*
+ * Starts inflating a compressed term of the given uncompressed size. The
+ * unread bytes of the short buffer are taken as the first compressed
+ * bytes, and the short buffer is refilled with inflated bytes from then
+ * on.
+ */
+int bert_inflate_begin(bert_decoder_t *decoder,size_t size);
+
+/*
+ * Inflates up to the given number of bytes into the short buffer.
+ * Returns the number of inflated bytes, or a BERT_ERRNO_* value.
+ */
+ssize_t bert_inflate_fill(bert_decoder_t *decoder,unsigned char *ptr,size_t space);
+
+/*
+ * Finishes inflating a compressed term, checking that it was fully
+ * decoded, and hands any bytes read past it back to the short buffer.
+ */
+int bert_inflate_end(bert_decoder_t *decoder);
+void bert_inflate_abort(bert_decoder_t *decoder);
+void bert_inflate_free(bert_decoder_t *decoder);
+
+/*
+ * Returns whether the decoder is currently inflating a compressed term.
+ */
+int bert_inflate_active(const bert_decoder_t *decoder);
+
+/*
+ * Deflates the given bytes into a newly allocated buffer.
+ */
+int bert_deflate(const bert_allocator_t *allocator,const unsigned char *data,size_t length,int level,unsigned char **buffer,size_t *buffer_length);
+
+#endif
@@ -1,11 +1,25 @@
 #include <bert/util.h>
 #include "data.h"
 
+size_t bert_data_bignum_bytes(uint64_t magnitude)
+{
+	size_t bytes = 0;
+
+	while (magnitude)
+	{
+		magnitude >>= 8;
+		++bytes;
+	}
+
+	return bytes;
+}
+
 size_t bert_data_sizeof_int(int64_t i)
 {
 	if (i <= BERT_MAX_INT && i >= BERT_MIN_INT)
 	{
-		if (i <= 0xff)
+		// negative integers never fit in a small int
+		if (i >= 0 && i <= 0xff)
 		{
 			return 1;
 		}
@@ -15,19 +29,7 @@ size_t bert_data_sizeof_int(int64_t i)
 		}
 	}
 
-	uint64_t unsigned_integer = BERT_STRIP_SIGN(i);
-	size_t byte_count = 0;
-	unsigned int j;
-
-	for (j=sizeof(int64_t)-1;j>=0;j--)
-	{
-		if (unsigned_integer & (0xff << (j * 8)))
-		{
-			byte_count = (j + 1);
-			break;
-		}
-	}
-
+	size_t byte_count = bert_data_bignum_bytes(BERT_MAGNITUDE(i));
 	size_t count = 0;
 
 	if (byte_count > 0xff)
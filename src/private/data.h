@@ -1,9 +1,41 @@
 #ifndef _BERT_PRIVATE_DATA_H_
 #define _BERT_PRIVATE_DATA_H_
 
+#include <bert/data.h>
+
 #include <sys/types.h>
 #include <stdint.h>
 
+/*
+ * Returns the number of bytes following the magic byte when the given
+ * integer is encoded. Must agree with bert_encode_int and
+ * bert_encode_bignum.
+ */
 size_t bert_data_sizeof_int(int64_t i);
 
+/*
+ * Returns the number of bytes an encoder with the given small atoms and
+ * maps settings writes for the given data, not including the leading
+ * magic byte. Returns 0 for data which cannot be encoded.
+ */
+size_t bert_data_sizeof_encoded(const bert_data_t *data,unsigned int small_atoms,unsigned int maps);
+
+/*
+ * Returns the number of significant bytes in the given magnitude.
+ */
+size_t bert_data_bignum_bytes(uint64_t magnitude);
+
+/*
+ * Frees the payload of the given bert_data_t, leaving it with the type of
+ * bert_data_none.
+ */
+void bert_data_release(bert_data_t *data);
+
+/*
+ * Tears down the containers on the given stack, without recursing, until
+ * the stack is empty or the given budget of steps has been used up. A
+ * budget of 0 is unlimited. Returns the number of steps taken.
+ */
+size_t bert_data_teardown(bert_data_t **stack,size_t budget);
+
 #endif
@@ -1,6 +1,12 @@
 #include "decode.h"
 #include "decoder.h"
 #include "regex.h"
+#include "data.h"
+#include "alloc.h"
+#include "cache.h"
+#include "compress.h"
+#include "atoms.h"
+#include "raw.h"
 
 #include <bert/magic.h>
 #include <bert/util.h>
@@ -9,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 
 int bert_decode_uint8(bert_decoder_t *decoder,uint8_t *i)
 {
@@ -70,32 +77,79 @@ int bert_decode_bytes(unsigned char *dest,bert_decoder_t *decoder,size_t length)
 	return BERT_SUCCESS;
 }
 
-int bert_decode_nil(bert_decoder_t *decoder,bert_data_t **data)
+/*
+ * Prepares the given bert_data_t for reuse as the given type, releasing
+ * its payload when the type differs. Returns NULL, after releasing the
+ * given bert_data_t, when it is shared with others or frozen.
+ */
+static bert_data_t * bert_decode_reuse(bert_data_t *reuse,bert_data_type type)
 {
-	bert_data_t *new_data;
+	if (!reuse)
+	{
+		return NULL;
+	}
 
-	if (!(new_data = bert_data_create_nil()))
+	if (reuse->refs != 1 || (reuse->flags & (BERT_DATA_FROZEN | BERT_DATA_PACKED)))
 	{
-		return BERT_ERRNO_MALLOC;
+		bert_data_destroy(reuse);
+		return NULL;
 	}
 
-	*data = new_data;
-	return BERT_SUCCESS;
+	if (reuse->type != type)
+	{
+		bert_data_release(reuse);
+		reuse->type = type;
+	}
+	else
+	{
+		// the container is about to be decoded over
+		bert_cache_invalidate_data(reuse);
+	}
+
+	return reuse;
 }
 
-int bert_decode_small_int(bert_decoder_t *decoder,bert_data_t **data)
+/*
+ * Resizes the payload of reused data to hold the given number of bytes
+ * plus a NULL byte, only reallocating when the payload outgrows the space
+ * allocated for it.
+ */
+static void * bert_decode_payload(bert_data_t *data,void *payload,size_t length,size_t size)
 {
-	int result;
-	uint8_t i;
+	void *new_payload;
 
-	if ((result = bert_decode_uint8(decoder,&i)) != BERT_SUCCESS)
+	if (payload)
 	{
-		return result;
+		if (length > data->capacity)
+		{
+			// remember the space of a payload about to be decoded over
+			data->capacity = length;
+		}
+
+		if (size <= data->capacity)
+		{
+			return payload;
+		}
+	}
+
+	if (!(new_payload = bert_realloc(data->allocator,payload,size + 1)))
+	{
+		return NULL;
 	}
 
+	data->capacity = size;
+	return new_payload;
+}
+
+static int bert_decode_integer(bert_data_t **data,int64_t i,bert_data_t *reuse)
+{
 	bert_data_t *new_data;
 
-	if (!(new_data = bert_data_create_int(i)))
+	if ((new_data = bert_decode_reuse(reuse,bert_data_int)))
+	{
+		new_data->integer = i;
+	}
+	else if (!(new_data = bert_data_create_int(i)))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
@@ -104,28 +158,48 @@ int bert_decode_small_int(bert_decoder_t *decoder,bert_data_t **data)
 	return BERT_SUCCESS;
 }
 
-int bert_decode_big_int(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_nil(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	bert_data_t *new_data;
+
+	if (!(new_data = bert_decode_reuse(reuse,bert_data_nil)) && !(new_data = bert_data_create_nil()))
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	*data = new_data;
+	return BERT_SUCCESS;
+}
+
+int bert_decode_small_int(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
-	uint32_t i;
+	uint8_t i;
 
-	if ((result = bert_decode_uint32(decoder,&i)) != BERT_SUCCESS)
+	if ((result = bert_decode_uint8(decoder,&i)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
-	bert_data_t *new_data;
+	return bert_decode_integer(data,i,reuse);
+}
 
-	if (!(new_data = bert_data_create_int(i)))
+int bert_decode_big_int(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	int result;
+	uint32_t i;
+
+	if ((result = bert_decode_uint32(decoder,&i)) != BERT_SUCCESS)
 	{
-		return BERT_ERRNO_MALLOC;
+		bert_data_destroy(reuse);
+		return result;
 	}
 
-	*data = new_data;
-	return BERT_SUCCESS;
+	return bert_decode_integer(data,i,reuse);
 }
 
-int bert_decode_float(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_float(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	char float_buffer[32];
 	int result;
@@ -134,6 +208,7 @@ int bert_decode_float(bert_decoder_t *decoder,bert_data_t **data)
 
 	if ((result = bert_decode_bytes((unsigned char *)float_buffer,decoder,31)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
@@ -141,12 +216,17 @@ int bert_decode_float(bert_decoder_t *decoder,bert_data_t **data)
 
 	if (sscanf(float_buffer,"%lf",&floating_point) != 1)
 	{
+		bert_data_destroy(reuse);
 		return BERT_ERRNO_INVALID;
 	}
 
 	bert_data_t *new_data;
 
-	if (!(new_data = bert_data_create_float(floating_point)))
+	if ((new_data = bert_decode_reuse(reuse,bert_data_float)))
+	{
+		new_data->floating_point = floating_point;
+	}
+	else if (!(new_data = bert_data_create_float(floating_point)))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
@@ -155,10 +235,11 @@ int bert_decode_float(bert_decoder_t *decoder,bert_data_t **data)
 	return BERT_SUCCESS;
 }
 
-int bert_decode_bignum(bert_decoder_t *decoder,bert_data_t **data,size_t size)
+int bert_decode_bignum(bert_decoder_t *decoder,bert_data_t **data,size_t size,bert_data_t *reuse)
 {
 	if (size > sizeof(uint64_t))
 	{
+		bert_data_destroy(reuse);
 		return BERT_ERRNO_BIGNUM;
 	}
 
@@ -167,6 +248,7 @@ int bert_decode_bignum(bert_decoder_t *decoder,bert_data_t **data,size_t size)
 
 	if ((result = bert_decode_uint8(decoder,&sign)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
@@ -174,6 +256,7 @@ int bert_decode_bignum(bert_decoder_t *decoder,bert_data_t **data,size_t size)
 
 	if ((result = bert_decode_bytes(bytes,decoder,size)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
@@ -192,56 +275,65 @@ int bert_decode_bignum(bert_decoder_t *decoder,bert_data_t **data,size_t size)
 		signed_integer = -(signed_integer);
 	}
 
-	bert_data_t *new_data;
-
-	if (!(new_data = bert_data_create_int(signed_integer)))
-	{
-		return BERT_ERRNO_MALLOC;
-	}
-
-	*data = new_data;
-	return BERT_SUCCESS;
+	return bert_decode_integer(data,signed_integer,reuse);
 }
 
-int bert_decode_small_bignum(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_small_bignum(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	uint8_t i;
 
 	if ((result = bert_decode_uint8(decoder,&i)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
-	return bert_decode_bignum(decoder,data,i);
+	return bert_decode_bignum(decoder,data,i,reuse);
 }
 
-int bert_decode_big_bignum(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_big_bignum(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	uint32_t i;
 
 	if ((result = bert_decode_uint32(decoder,&i)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
-	return bert_decode_bignum(decoder,data,i);
+	return bert_decode_bignum(decoder,data,i,reuse);
 }
 
-int bert_decode_string(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_string(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	bert_string_size_t size;
 
 	if ((result = bert_decode_uint16(decoder,&size)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
 	bert_data_t *new_data;
+	char *new_text;
 
-	if (!(new_data = bert_data_create_empty_string(size)))
+	if ((new_data = bert_decode_reuse(reuse,bert_data_string)))
+	{
+		if (!(new_text = bert_decode_payload(new_data,new_data->string.text,new_data->string.length,size)))
+		{
+			bert_data_destroy(new_data);
+			return BERT_ERRNO_MALLOC;
+		}
+
+		new_text[size] = '\0';
+
+		new_data->string.length = size;
+		new_data->string.text = new_text;
+	}
+	else if (!(new_data = bert_data_create_empty_string(size)))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
@@ -266,7 +358,7 @@ int bert_decode_time(bert_decoder_t *decoder,bert_data_t **data)
 	bert_data_t *megaseconds;
 	int result;
 	
-	if ((result = bert_decoder_pull(decoder,&megaseconds)) != 1)
+	if ((result = bert_decoder_pull_element(decoder,&megaseconds,NULL)) != 1)
 	{
 		bert_data_destroy(megaseconds);
 		return result;
@@ -279,7 +371,7 @@ int bert_decode_time(bert_decoder_t *decoder,bert_data_t **data)
 
 	bert_data_t *seconds;
 
-	if ((result = bert_decoder_pull(decoder,&seconds)) != 1)
+	if ((result = bert_decoder_pull_element(decoder,&seconds,NULL)) != 1)
 	{
 		bert_data_destroy(seconds);
 		bert_data_destroy(megaseconds);
@@ -293,7 +385,7 @@ int bert_decode_time(bert_decoder_t *decoder,bert_data_t **data)
 
 	bert_data_t *microseconds;
 
-	if ((result = bert_decoder_pull(decoder,&microseconds)) != 1)
+	if ((result = bert_decoder_pull_element(decoder,&microseconds,NULL)) != 1)
 	{
 		bert_data_destroy(microseconds);
 		bert_data_destroy(seconds);
@@ -335,7 +427,7 @@ int bert_decode_dict(bert_decoder_t *decoder,bert_data_t **data)
 	bert_data_t *list_data;
 	int result;
 
-	if ((result = bert_decoder_pull(decoder,&list_data)) != 1)
+	if ((result = bert_decoder_pull_element(decoder,&list_data,NULL)) != 1)
 	{
 		return result;
 	}
@@ -409,12 +501,64 @@ int bert_decode_dict(bert_decoder_t *decoder,bert_data_t **data)
 	return BERT_SUCCESS;
 }
 
+int bert_decode_map(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	uint32_t arity;
+	int result;
+
+	// dicts are always decoded as new data
+	bert_data_destroy(reuse);
+
+	if ((result = bert_decode_uint32(decoder,&arity)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	bert_data_t *new_data;
+
+	if (!(new_data = bert_data_create_dict()))
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	bert_data_t *key_data;
+	bert_data_t *value_data;
+	uint32_t i;
+
+	for (i=0;i<arity;i++)
+	{
+		if ((result = bert_decoder_pull_element(decoder,&key_data,NULL)) != 1)
+		{
+			bert_data_destroy(new_data);
+			return result;
+		}
+
+		if ((result = bert_decoder_pull_element(decoder,&value_data,NULL)) != 1)
+		{
+			bert_data_destroy(key_data);
+			bert_data_destroy(new_data);
+			return result;
+		}
+
+		if (bert_dict_append(new_data->dict,key_data,value_data) != BERT_SUCCESS)
+		{
+			bert_data_destroy(value_data);
+			bert_data_destroy(key_data);
+			bert_data_destroy(new_data);
+			return BERT_ERRNO_MALLOC;
+		}
+	}
+
+	*data = new_data;
+	return BERT_SUCCESS;
+}
+
 int bert_decode_regex(bert_decoder_t *decoder,bert_data_t **data)
 {
 	bert_data_t *source;
 	int result;
 
-	if ((result = bert_decoder_pull(decoder,&source)) != 1)
+	if ((result = bert_decoder_pull_element(decoder,&source,NULL)) != 1)
 	{
 		return result;
 	}
@@ -427,7 +571,7 @@ int bert_decode_regex(bert_decoder_t *decoder,bert_data_t **data)
 
 	bert_data_t *opt_list;
 
-	if ((result = bert_decoder_pull(decoder,&opt_list)) != 1)
+	if ((result = bert_decoder_pull_element(decoder,&opt_list,NULL)) != 1)
 	{
 		bert_data_destroy(source);
 		return result;
@@ -533,7 +677,7 @@ int bert_decode_complex(bert_decoder_t *decoder,bert_data_t **data)
 	bert_data_t *keyword;
 	int result;
 
-	if ((result = bert_decoder_pull(decoder,&keyword)) != 1)
+	if ((result = bert_decoder_pull_element(decoder,&keyword,NULL)) != 1)
 	{
 		return result;
 	}
@@ -589,19 +733,38 @@ int bert_decode_complex(bert_decoder_t *decoder,bert_data_t **data)
 	return BERT_SUCCESS;
 }
 
-int bert_decode_atom(bert_decoder_t *decoder,bert_data_t **data)
+/*
+ * Returns an atom with room for a name of the given size, reusing the
+ * given bert_data_t if possible, or NULL if malloc failed.
+ */
+static bert_data_t * bert_decode_empty_atom(bert_data_t *reuse,size_t size)
 {
-	int result;
-	bert_atom_size_t size;
+	bert_data_t *new_data;
+	char *new_name;
 
-	if ((result = bert_decode_uint16(decoder,&size)) != BERT_SUCCESS)
+	if (!(new_data = bert_decode_reuse(reuse,bert_data_atom)))
 	{
-		return result;
+		return bert_data_create_empty_atom(size);
 	}
 
+	if (!(new_name = bert_decode_payload(new_data,new_data->atom.name,new_data->atom.length,size)))
+	{
+		bert_data_destroy(new_data);
+		return NULL;
+	}
+
+	new_name[size] = '\0';
+
+	new_data->atom.length = size;
+	new_data->atom.name = new_name;
+	return new_data;
+}
+
+static int bert_decode_atom_name(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse,bert_atom_size_t size)
+{
 	bert_data_t *new_data;
 
-	if (!(new_data = bert_data_create_empty_atom(size)))
+	if (!(new_data = bert_decode_empty_atom(reuse,size)))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
@@ -621,19 +784,232 @@ int bert_decode_atom(bert_decoder_t *decoder,bert_data_t **data)
 	return BERT_SUCCESS;
 }
 
-int bert_decode_bin(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_atom(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	int result;
+	bert_atom_size_t size;
+
+	if ((result = bert_decode_uint16(decoder,&size)) != BERT_SUCCESS)
+	{
+		bert_data_destroy(reuse);
+		return result;
+	}
+
+	return bert_decode_atom_name(decoder,data,reuse,size);
+}
+
+int bert_decode_small_atom(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	int result;
+	uint8_t size;
+
+	if ((result = bert_decode_uint8(decoder,&size)) != BERT_SUCCESS)
+	{
+		bert_data_destroy(reuse);
+		return result;
+	}
+
+	return bert_decode_atom_name(decoder,data,reuse,size);
+}
+
+int bert_decode_atom_cache_ref(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	struct bert_atom_cache *cache = decoder->atom_cache;
+	const struct bert_atom_entry *entry;
+	bert_data_t *new_data;
+	uint8_t ref;
+	int result;
+
+	if ((result = bert_decode_uint8(decoder,&ref)) != BERT_SUCCESS)
+	{
+		bert_data_destroy(reuse);
+		return result;
+	}
+
+	if (!cache || ref >= cache->message.length)
+	{
+		// the reference was not defined by the header of the message
+		bert_data_destroy(reuse);
+		return BERT_ERRNO_INVALID;
+	}
+
+	entry = cache->entries + cache->message.index[ref];
+
+	if (!(new_data = bert_decode_empty_atom(reuse,entry->length)))
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	memcpy(new_data->atom.name,entry->name,sizeof(char)*entry->length);
+
+	*data = new_data;
+	return BERT_SUCCESS;
+}
+
+int bert_decode_dist_header(bert_decoder_t *decoder)
+{
+	struct bert_atom_cache *cache = decoder->atom_cache;
+	unsigned char flags[(BERT_ATOM_CACHE_REFS / 2) + 1];
+	unsigned int long_atoms;
+	unsigned int index;
+	unsigned int i;
+	unsigned char flag;
+	uint8_t count;
+	uint8_t internal;
+	int result;
+
+	if (!cache)
+	{
+		// the decoder does not keep an atom cache
+		return BERT_ERRNO_INVALID;
+	}
+
+	cache->message.length = 0;
+
+	if ((result = bert_decode_uint8(decoder,&count)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (!count)
+	{
+		return BERT_SUCCESS;
+	}
+
+	if ((result = bert_decode_bytes(flags,decoder,(count / 2) + 1)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	// a half byte of flags per reference, followed by the long atoms flag
+	long_atoms = ((count & 0x01) ? (flags[count / 2] >> 4) : flags[count / 2]) & 0x01;
+
+	for (i=0;i<count;i++)
+	{
+		flag = ((i & 0x01) ? (flags[i / 2] >> 4) : flags[i / 2]) & 0x0f;
+
+		if ((result = bert_decode_uint8(decoder,&internal)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		index = ((flag & 0x07) << 8) | internal;
+
+		if (flag & 0x08)
+		{
+			size_t length;
+			char *name;
+
+			if (long_atoms)
+			{
+				uint16_t long_length;
+
+				if ((result = bert_decode_uint16(decoder,&long_length)) != BERT_SUCCESS)
+				{
+					return result;
+				}
+
+				length = long_length;
+			}
+			else
+			{
+				uint8_t short_length;
+
+				if ((result = bert_decode_uint8(decoder,&short_length)) != BERT_SUCCESS)
+				{
+					return result;
+				}
+
+				length = short_length;
+			}
+
+			if (!(name = bert_atom_cache_store(cache,index,length)))
+			{
+				return BERT_ERRNO_MALLOC;
+			}
+
+			if (length && (result = bert_decode_bytes((unsigned char *)name,decoder,length)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+		}
+		else if (!cache->entries[index].name)
+		{
+			// the entry was never defined
+			return BERT_ERRNO_INVALID;
+		}
+
+		cache->message.index[i] = index;
+	}
+
+	cache->message.length = count;
+	return BERT_SUCCESS;
+}
+
+int bert_decode_bin(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	bert_bin_size_t size;
 
 	if ((result = bert_decode_uint32(decoder,&size)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
 	bert_data_t *new_data;
 
-	if (!(new_data = bert_data_create_empty_bin(size)))
+	if ((new_data = bert_decode_reuse(reuse,bert_data_bin)) && new_data->bin.buffer)
+	{
+		// stop referencing the previously shared buffer
+		bert_bin_buffer_unref(new_data->bin.buffer);
+
+		new_data->bin.buffer = NULL;
+		new_data->bin.data = NULL;
+		new_data->bin.length = 0;
+		new_data->capacity = 0;
+	}
+
+	unsigned char *shared_bytes;
+
+	if (size >= BERT_SHARED_BIN_MIN && (shared_bytes = bert_decoder_shared_bytes(decoder,size)))
+	{
+		// reference the binary data within the shared buffer
+		if (new_data)
+		{
+			bert_free(new_data->allocator,new_data->bin.data);
+			new_data->capacity = 0;
+		}
+		else if (!(new_data = bert_data_create()))
+		{
+			return BERT_ERRNO_MALLOC;
+		}
+
+		new_data->type = bert_data_bin;
+		new_data->bin.length = size;
+		new_data->bin.data = shared_bytes;
+		new_data->bin.buffer = bert_bin_buffer_ref(decoder->shared);
+
+		*data = new_data;
+		return BERT_SUCCESS;
+	}
+
+	if (new_data)
+	{
+		unsigned char *new_bin;
+
+		if (!(new_bin = bert_decode_payload(new_data,new_data->bin.data,new_data->bin.length,size)))
+		{
+			bert_data_destroy(new_data);
+			return BERT_ERRNO_MALLOC;
+		}
+
+		new_bin[size] = '\0';
+
+		new_data->bin.length = size;
+		new_data->bin.data = new_bin;
+	}
+	else if (!(new_data = bert_data_create_empty_bin(size)))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
@@ -653,40 +1029,351 @@ int bert_decode_bin(bert_decoder_t *decoder,bert_data_t **data)
 	return BERT_SUCCESS;
 }
 
-int bert_decode_tuple(bert_decoder_t *decoder,bert_data_t **data,size_t size)
+/*
+ * Resizes the tuple of reused data, destroying any elements beyond the
+ * new size and only reallocating the elements when the tuple grows.
+ * Returns NULL, after destroying the tuple, when the elements could not
+ * be reallocated.
+ */
+static bert_tuple_t * bert_decode_reuse_tuple(bert_tuple_t *tuple,size_t size)
+{
+	if (!tuple)
+	{
+		return bert_tuple_create(size);
+	}
+
+	unsigned int i;
+
+	for (i=size;i<tuple->length;i++)
+	{
+		bert_data_destroy(tuple->elements[i]);
+		tuple->elements[i] = NULL;
+	}
+
+	if (size > tuple->length)
+	{
+		bert_data_t **new_elements;
+
+		if (!(new_elements = bert_realloc(tuple->allocator,tuple->elements,sizeof(bert_data_t *) * size)))
+		{
+			bert_tuple_destroy(tuple);
+			return NULL;
+		}
+
+		memset(new_elements + tuple->length,0,sizeof(bert_data_t *) * (size - tuple->length));
+		tuple->elements = new_elements;
+	}
+
+	tuple->length = size;
+	return tuple;
+}
+
+/*
+ * Destroys the nodes of a reused list beyond the given length.
+ */
+static void bert_decode_truncate_list(bert_list_t *list,size_t length)
+{
+	bert_list_node_t *last_node = NULL;
+	bert_list_node_t *next_node = list->head;
+	unsigned int i;
+
+	for (i=0;i<length && next_node;i++)
+	{
+		last_node = next_node;
+		next_node = next_node->next;
+	}
+
+	if (last_node)
+	{
+		last_node->next = NULL;
+	}
+	else
+	{
+		list->head = NULL;
+	}
+
+	list->tail = last_node;
+
+	while (next_node)
+	{
+		last_node = next_node;
+		next_node = next_node->next;
+
+		bert_data_destroy(last_node->data);
+		bert_object_free(list->allocator,last_node,sizeof(bert_list_node_t));
+	}
+}
+/*
+ * Reserves space for the given number of bytes at the end of a raw term
+ * being read.
+ */
+static unsigned char * bert_decode_raw_space(bert_data_t *data,size_t *capacity,size_t size)
+{
+	size_t length = data->raw.length;
+
+	if (size > (*capacity - length))
+	{
+		size_t new_capacity = (*capacity * 2);
+
+		if (new_capacity < (length + size))
+		{
+			new_capacity = (length + size);
+		}
+		unsigned char *new_raw;
+
+		if (!(new_raw = bert_realloc(data->allocator,data->raw.data,new_capacity)))
+		{
+			return NULL;
+		}
+
+		data->raw.data = new_raw;
+		*capacity = new_capacity;
+	}
+
+	data->raw.length += size;
+	return data->raw.data + length;
+}
+
+/*
+ * Copies an atom cache reference into a raw term as the atom it refers to,
+ * since the reference means nothing outside of its message.
+ */
+static int bert_decode_raw_atom(bert_decoder_t *decoder,bert_data_t *data,size_t *capacity)
+{
+	struct bert_atom_cache *cache = decoder->atom_cache;
+	const struct bert_atom_entry *entry;
+	unsigned char *ptr;
+	uint8_t ref;
+	int result;
+
+	if ((result = bert_decode_uint8(decoder,&ref)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (!cache || ref >= cache->message.length)
+	{
+		// the reference was not defined by the header of the message
+		return BERT_ERRNO_INVALID;
+	}
+
+	entry = cache->entries + cache->message.index[ref];
+
+	if (!(ptr = bert_decode_raw_space(data,capacity,1 + 2 + entry->length)))
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	bert_write_magic(ptr,BERT_ATOM);
+	bert_write_uint16(ptr+1,entry->length);
+	memcpy(ptr+1+2,entry->name,sizeof(char)*entry->length);
+	return BERT_SUCCESS;
+}
+
+/*
+ * Reads a term into a raw term one tag at a time, for when the term
+ * cannot be measured within the buffer being decoded.
+ */
+static int bert_decode_raw_read(bert_decoder_t *decoder,bert_magic_t magic,bert_data_t *data,size_t *capacity)
+{
+	size_t pending = 1;
+	size_t header;
+	size_t bytes;
+	size_t terms;
+	unsigned char *ptr;
+	int result;
+
+	for (;;)
+	{
+		if (magic == BERT_ATOM_CACHE_REF)
+		{
+			if ((result = bert_decode_raw_atom(decoder,data,capacity)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+		}
+		else
+		{
+			if ((result = bert_raw_header(magic,&header)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+
+			if (!(ptr = bert_decode_raw_space(data,capacity,1 + header)))
+			{
+				return BERT_ERRNO_MALLOC;
+			}
+
+			bert_write_magic(ptr,magic);
+
+			if ((result = bert_decode_bytes(ptr+1,decoder,header)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+
+			bert_raw_contents(magic,ptr+1,&bytes,&terms);
+
+			if (bytes)
+			{
+				if (!(ptr = bert_decode_raw_space(data,capacity,bytes)))
+				{
+					return BERT_ERRNO_MALLOC;
+				}
+
+				if ((result = bert_decode_bytes(ptr,decoder,bytes)) != BERT_SUCCESS)
+				{
+					return result;
+				}
+			}
+
+			pending += terms;
+		}
+
+		if (!(--pending))
+		{
+			return BERT_SUCCESS;
+		}
+
+		if ((result = bert_decode_magic(decoder,&magic)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+	}
+}
+
+int bert_decode_raw(bert_decoder_t *decoder,bert_magic_t magic,bert_data_t **data,bert_data_t *reuse)
+{
+	bert_data_t *new_data;
+
+	if ((new_data = bert_decode_reuse(reuse,bert_data_raw)) && new_data->raw.buffer)
+	{
+		// stop referencing the previously shared buffer
+		bert_bin_buffer_unref(new_data->raw.buffer);
+
+		new_data->raw.buffer = NULL;
+		new_data->raw.data = NULL;
+		new_data->raw.length = 0;
+		new_data->capacity = 0;
+	}
+
+	if (!new_data)
+	{
+		if (!(new_data = bert_data_create()))
+		{
+			return BERT_ERRNO_MALLOC;
+		}
+
+		new_data->type = bert_data_raw;
+	}
+
+	// the payload of reused data is grown over from the start
+	size_t capacity = (new_data->raw.length > new_data->capacity ? new_data->raw.length : new_data->capacity);
+	const unsigned char *input;
+	size_t length;
+	size_t size;
+	int result;
+
+	new_data->raw.length = 0;
+
+	if ((input = bert_decoder_input(decoder,&length)) && !(decoder->atom_cache && decoder->atom_cache->message.length))
+	{
+		// the tag has just been read from the buffer
+		if ((result = bert_raw_length(input - 1,length + 1,&size)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+
+		if (decoder->shared && size >= BERT_SHARED_BIN_MIN)
+		{
+			// reference the term within the shared buffer
+			if (new_data->raw.data)
+			{
+				bert_free(new_data->allocator,new_data->raw.data);
+			}
+
+			capacity = 0;
+
+			new_data->raw.length = size;
+			new_data->raw.data = decoder->shared->data + (input - 1 - decoder->buffer.ptr);
+			new_data->raw.buffer = bert_bin_buffer_ref(decoder->shared);
+		}
+		else
+		{
+			unsigned char *ptr;
+
+			if (!(ptr = bert_decode_raw_space(new_data,&capacity,size)))
+			{
+				result = BERT_ERRNO_MALLOC;
+				goto cleanup;
+			}
+
+			memcpy(ptr,input - 1,sizeof(unsigned char)*size);
+		}
+
+		bert_decoder_skip(decoder,size - 1);
+	}
+	else if ((result = bert_decode_raw_read(decoder,magic,new_data,&capacity)) != BERT_SUCCESS)
+	{
+		goto cleanup;
+	}
+
+	// larger allocations are only known to fit the current term
+	new_data->capacity = (capacity <= UINT_MAX ? capacity : 0);
+
+	*data = new_data;
+	return BERT_SUCCESS;
+
+cleanup:
+	bert_data_destroy(new_data);
+	return result;
+}
+
+int bert_decode_tuple(bert_decoder_t *decoder,bert_data_t **data,size_t size,bert_data_t *reuse)
 {
 	bert_data_t *new_data;
 
-	if (!(new_data = bert_data_create_tuple(size)))
+	if ((new_data = bert_decode_reuse(reuse,bert_data_tuple)))
+	{
+		if (!(new_data->tuple = bert_decode_reuse_tuple(new_data->tuple,size)))
+		{
+			bert_data_destroy(new_data);
+			return BERT_ERRNO_MALLOC;
+		}
+	}
+	else if (!(new_data = bert_data_create_tuple(size)))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
 
 	if (size)
 	{
-		bert_data_t *first;
+		bert_data_t **elements = new_data->tuple->elements;
+		bert_data_t *element;
 		int result;
 
-		if ((result = bert_decoder_pull(decoder,&first)) != 1)
+		element = elements[0];
+		elements[0] = NULL;
+
+		if ((result = bert_decoder_pull_element(decoder,elements,element)) != 1)
 		{
 			bert_data_destroy(new_data);
 			return result;
 		}
 
-		if ((first->type == bert_data_atom) && bert_data_strequal(first,"bert"))
+		if ((elements[0]->type == bert_data_atom) && bert_data_strequal(elements[0],"bert"))
 		{
-			bert_data_destroy(first);
 			bert_data_destroy(new_data);
 			return bert_decode_complex(decoder,data);
 		}
 
-		new_data->tuple->elements[0] = first;
-
 		unsigned int i;
 
 		for (i=1;i<size;i++)
 		{
-			if ((result = bert_decoder_pull(decoder,new_data->tuple->elements+i)) != 1)
+			element = elements[i];
+			elements[i] = NULL;
+
+			if ((result = bert_decoder_pull_element(decoder,elements+i,element)) != 1)
 			{
 				bert_data_destroy(new_data);
 				return result;
@@ -698,71 +1385,163 @@ int bert_decode_tuple(bert_decoder_t *decoder,bert_data_t **data,size_t size)
 	return BERT_SUCCESS;
 }
 
-int bert_decode_small_tuple(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_small_tuple(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	uint8_t size;
 
 	if ((result = bert_decode_uint8(decoder,&size)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
-	return bert_decode_tuple(decoder,data,size);
+	return bert_decode_tuple(decoder,data,size,reuse);
 }
 
-int bert_decode_large_tuple(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_large_tuple(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	uint32_t size;
 
 	if ((result = bert_decode_uint32(decoder,&size)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
-	return bert_decode_tuple(decoder,data,size);
+	return bert_decode_tuple(decoder,data,size,reuse);
 }
 
-int bert_decode_list(bert_decoder_t *decoder,bert_data_t **data)
+int bert_decode_list(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
 {
 	int result;
 	bert_list_size_t size;
 
 	if ((result = bert_decode_uint32(decoder,&size)) != BERT_SUCCESS)
 	{
+		bert_data_destroy(reuse);
 		return result;
 	}
 
 	bert_data_t *new_data;
+	bert_list_node_t *next_node = NULL;
 
-	if (!(new_data = bert_data_create_list()))
+	if ((new_data = bert_decode_reuse(reuse,bert_data_list)) && new_data->list)
+	{
+		bert_decode_truncate_list(new_data->list,size);
+		next_node = new_data->list->head;
+	}
+	else if (new_data)
+	{
+		if (!(new_data->list = bert_list_create()))
+		{
+			bert_data_destroy(new_data);
+			return BERT_ERRNO_MALLOC;
+		}
+	}
+	else if (!(new_data = bert_data_create_list()))
 	{
 		return BERT_ERRNO_MALLOC;
 	}
 
 	bert_data_t *element;
+	bert_magic_t tail;
 	unsigned int i;
 
-	for (i=0;i<size;i++)
+	while (1)
 	{
-		if ((result = bert_decoder_pull(decoder,&element)) != 1)
+		for (i=0;i<size;i++)
+		{
+			if (next_node)
+			{
+				// decode over the existing element
+				element = next_node->data;
+				next_node->data = NULL;
+
+				if ((result = bert_decoder_pull_element(decoder,&(next_node->data),element)) != 1)
+				{
+					bert_data_destroy(new_data);
+					return result;
+				}
+
+				next_node = next_node->next;
+				continue;
+			}
+
+			if ((result = bert_decoder_pull_element(decoder,&element,NULL)) != 1)
+			{
+				bert_data_destroy(new_data);
+				return result;
+			}
+
+			if (bert_list_append(new_data->list,element) == BERT_ERRNO_MALLOC)
+			{
+				bert_data_destroy(element);
+				bert_data_destroy(new_data);
+				return BERT_ERRNO_MALLOC;
+			}
+		}
+
+		if ((result = bert_decode_magic(decoder,&tail)) != BERT_SUCCESS)
 		{
 			bert_data_destroy(new_data);
 			return result;
 		}
 
-		if (bert_list_append(new_data->list,element) == BERT_ERRNO_MALLOC)
+		if (tail == BERT_NIL)
 		{
-			bert_data_destroy(element);
+			break;
+		}
+
+		if (tail != BERT_LIST)
+		{
+			// only improper lists whose tail is another list can be decoded
 			bert_data_destroy(new_data);
-			return BERT_ERRNO_MALLOC;
+			return BERT_ERRNO_INVALID;
 		}
-	}
 
-	BERT_DECODER_READ(decoder,1);
-	BERT_DECODER_STEP(decoder,1);
+		// the list continues in another segment
+		if ((result = bert_decode_uint32(decoder,&size)) != BERT_SUCCESS)
+		{
+			bert_data_destroy(new_data);
+			return result;
+		}
+	}
 
 	*data = new_data;
 	return BERT_SUCCESS;
 }
+
+int bert_decode_compressed(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse)
+{
+	int result;
+	uint32_t size;
+
+	if ((result = bert_decode_uint32(decoder,&size)) != BERT_SUCCESS)
+	{
+		bert_data_destroy(reuse);
+		return result;
+	}
+
+	if ((result = bert_inflate_begin(decoder,size)) != BERT_SUCCESS)
+	{
+		bert_data_destroy(reuse);
+		return result;
+	}
+
+	// the compressed term is not nested within another term
+	if ((result = bert_decoder_pull_term(decoder,data,reuse)) != 1)
+	{
+		bert_inflate_abort(decoder);
+		return (result ? result : BERT_ERRNO_SHORT_READ);
+	}
+
+	if ((result = bert_inflate_end(decoder)) != BERT_SUCCESS)
+	{
+		bert_data_destroy(*data);
+		return result;
+	}
+
+	return BERT_SUCCESS;
+}
@@ -9,23 +9,29 @@ int bert_decode_uint32(bert_decoder_t *decoder,uint32_t *i);
 int bert_decode_magic(bert_decoder_t *decoder,bert_magic_t *magic);
 int bert_decode_bytes(unsigned char *dest,bert_decoder_t *decoder,size_t length);
 
-int bert_decode_nil(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_small_int(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_big_int(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_float(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_bignum(bert_decoder_t *decoder,bert_data_t **data,size_t size);
-int bert_decode_small_bignum(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_big_bignum(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_string(bert_decoder_t *decoder,bert_data_t **data);
+int bert_decode_nil(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_small_int(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_big_int(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_float(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_bignum(bert_decoder_t *decoder,bert_data_t **data,size_t size,bert_data_t *reuse);
+int bert_decode_small_bignum(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_big_bignum(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_string(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
 int bert_decode_time(bert_decoder_t *decoder,bert_data_t **data);
 int bert_decode_dict(bert_decoder_t *decoder,bert_data_t **data);
+int bert_decode_map(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
 int bert_decode_complex(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_atom(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_bin(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_tuple(bert_decoder_t *decoder,bert_data_t **data,size_t size);
-int bert_decode_small_tuple(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_large_tuple(bert_decoder_t *decoder,bert_data_t **data);
-int bert_decode_list(bert_decoder_t *decoder,bert_data_t **data);
+int bert_decode_atom(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_small_atom(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_atom_cache_ref(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_dist_header(bert_decoder_t *decoder);
+int bert_decode_bin(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_raw(bert_decoder_t *decoder,bert_magic_t magic,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_tuple(bert_decoder_t *decoder,bert_data_t **data,size_t size,bert_data_t *reuse);
+int bert_decode_small_tuple(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_large_tuple(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_compressed(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decode_list(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
 int bert_decode_regex(bert_decoder_t *decoder,bert_data_t **data);
 
 #endif
@@ -1,4 +1,5 @@
 #include "decoder.h"
+#include "compress.h"
 #include "regex.h"
 
 #include <bert/magic.h>
@@ -8,6 +9,37 @@
 #include <unistd.h>
 #include <string.h>
 
+ssize_t bert_decoder_source(bert_decoder_t *decoder,unsigned char *ptr,size_t space)
+{
+	ssize_t length;
+
+	switch (decoder->mode)
+	{
+		case bert_mode_stream:
+			if ((length = read(decoder->stream,ptr,sizeof(unsigned char)*space)) < 0)
+			{
+				return BERT_ERRNO_READ;
+			}
+			break;
+		case bert_mode_buffer:
+			length = MIN((decoder->buffer.length - decoder->buffer.index),space);
+
+			memcpy(ptr,decoder->buffer.ptr+decoder->buffer.index,length);
+			decoder->buffer.index += length;
+			break;
+		case bert_mode_callback:
+			if ((length = decoder->callback.ptr(ptr,space,decoder->callback.data)) < 0)
+			{
+				return BERT_ERRNO_INVALID;
+			}
+			break;
+		default:
+			return BERT_ERRNO_INVALID;
+	}
+
+	return length;
+}
+
 int bert_decoder_read(bert_decoder_t *decoder,size_t size)
 {
 	size_t remaining_space = (decoder->short_length - decoder->short_index);
@@ -44,32 +76,22 @@ int bert_decoder_read(bert_decoder_t *decoder,size_t size)
 fill_short_buffer:
 	short_ptr = (decoder->short_buffer + decoder->short_length);
 
-	switch (decoder->mode)
+	if (bert_inflate_active(decoder))
 	{
-		case bert_mode_stream:
-			length = read(decoder->stream,short_ptr,sizeof(unsigned char)*empty_space);
-
-			if (length < 0)
-			{
-				return BERT_ERRNO_READ;
-			}
-			break;
-		case bert_mode_buffer:
-			length = MIN((decoder->buffer.length - decoder->buffer.index),empty_space);
-
-			memcpy(short_ptr,decoder->buffer.ptr,length);
-			decoder->buffer.index += length;
-			break;
-		case bert_mode_callback:
-			length = decoder->callback.ptr(short_ptr,empty_space,decoder->callback.data);
+		// the compressed bytes are counted as they are read
+		if ((length = bert_inflate_fill(decoder,short_ptr,empty_space)) < 0)
+		{
+			return length;
+		}
+	}
+	else
+	{
+		if ((length = bert_decoder_source(decoder,short_ptr,empty_space)) < 0)
+		{
+			return length;
+		}
 
-			if (length < 0)
-			{
-				return BERT_ERRNO_INVALID;
-			}
-			break;
-		default:
-			return BERT_ERRNO_INVALID;
+		decoder->total += length;
 	}
 
 	if (!(length || remaining_space))
@@ -79,7 +101,6 @@ fill_short_buffer:
 	}
 
 	decoder->short_length += length;
-	decoder->total += length;
 
 	if ((decoder->short_length - decoder->short_index) < size)
 	{
@@ -87,3 +108,56 @@ fill_short_buffer:
 	}
 	return BERT_SUCCESS;
 }
+
+const unsigned char * bert_decoder_input(const bert_decoder_t *decoder,size_t *length)
+{
+	if (decoder->mode != bert_mode_buffer || bert_inflate_active(decoder))
+	{
+		return NULL;
+	}
+
+	size_t unread_space = (decoder->short_length - decoder->short_index);
+	size_t position = (decoder->buffer.index - unread_space);
+
+	*length = (decoder->buffer.length - position);
+	return decoder->buffer.ptr + position;
+}
+
+void bert_decoder_skip(bert_decoder_t *decoder,size_t size)
+{
+	size_t unread_space = (decoder->short_length - decoder->short_index);
+	size_t position = (decoder->buffer.index - unread_space);
+
+	if (size <= unread_space)
+	{
+		BERT_DECODER_STEP(decoder,size);
+		return;
+	}
+
+	// skip the bytes without copying them into the short buffer
+	decoder->total += (position + size - decoder->buffer.index);
+	decoder->buffer.index = (position + size);
+
+	decoder->short_length = 0;
+	decoder->short_index = 0;
+}
+
+unsigned char * bert_decoder_shared_bytes(bert_decoder_t *decoder,size_t size)
+{
+	const unsigned char *input;
+	size_t length;
+
+	if (!(decoder->shared) || !(input = bert_decoder_input(decoder,&length)))
+	{
+		return NULL;
+	}
+
+	if (size > length)
+	{
+		// not enough data left in the shared buffer
+		return NULL;
+	}
+
+	bert_decoder_skip(decoder,size);
+	return decoder->shared->data + (input - decoder->buffer.ptr);
+}
@@ -2,6 +2,7 @@
 #define _BERT_PRIVATE_DECODER_H_
 
 #include <bert/decoder.h>
+#include <bert/alloc.h>
 
 #define BERT_DECODER_EMPTY(decoder)	(BERT_SHORT_BUFFER - decoder->short_length)
 #define BERT_DECODER_STEP(decoder,i)	(decoder->short_index += i)
@@ -40,12 +41,43 @@ struct bert_decoder
 		} buffer;
 	};
 
+	bert_bin_buffer_t *shared;
+
+	// allocated once a compressed term is decoded
+	struct bert_inflate *inflate;
+
+	// allocated once the atom cache is enabled
+	struct bert_atom_cache *atom_cache;
+
+	// terms nested this deep are kept encoded
+	unsigned int depth;
+	unsigned int raw_depth;
+
+	const bert_allocator_t *allocator;
+	const bert_allocator_t *data_allocator;
+
 	size_t short_length;
 	unsigned int short_index;
 
 	unsigned char short_buffer[BERT_SHORT_BUFFER];
 };
 
+ssize_t bert_decoder_source(bert_decoder_t *decoder,unsigned char *ptr,size_t space);
 int bert_decoder_read(bert_decoder_t *decoder,size_t size);
+int bert_decoder_pull_term(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+int bert_decoder_pull_element(bert_decoder_t *decoder,bert_data_t **data,bert_data_t *reuse);
+unsigned char * bert_decoder_shared_bytes(bert_decoder_t *decoder,size_t size);
+
+/*
+ * Returns the unread bytes of a decoder in bert_mode_buffer, or NULL when
+ * the bytes are not read straight from the buffer.
+ */
+const unsigned char * bert_decoder_input(const bert_decoder_t *decoder,size_t *length);
+
+/*
+ * Steps over the given number of unread bytes returned by
+ * bert_decoder_input().
+ */
+void bert_decoder_skip(bert_decoder_t *decoder,size_t size);
 
 #endif
@@ -1,6 +1,8 @@
 #include "encode.h"
 #include "encoder.h"
 #include "regex.h"
+#include "data.h"
+#include "atoms.h"
 #include <bert/magic.h>
 #include <bert/util.h>
 #include <bert/errno.h>
@@ -50,6 +52,16 @@ int bert_encode_int(bert_encoder_t *encoder,unsigned int i)
 	return BERT_ERRNO_INVALID;
 }
 
+int bert_encode_integer(bert_encoder_t *encoder,int64_t integer)
+{
+	if (integer <= BERT_MAX_INT && integer >= BERT_MIN_INT)
+	{
+		return bert_encode_int(encoder,integer);
+	}
+
+	return bert_encode_bignum(encoder,integer);
+}
+
 int bert_encode_float(bert_encoder_t *encoder,double d)
 {
 	size_t buffer_length = 1 + 31;
@@ -66,41 +78,13 @@ int bert_encode_float(bert_encoder_t *encoder,double d)
 int bert_encode_bignum(bert_encoder_t *encoder,int64_t integer)
 {
 	uint8_t sign = (integer < 0);
-	size_t bytes = 0;
-
-	uint64_t unsigned_integer = BERT_STRIP_SIGN(integer);
+	uint64_t unsigned_integer = BERT_MAGNITUDE(integer);
+	size_t bytes = bert_data_bignum_bytes(unsigned_integer);
 	unsigned int i;
 
-	for (i=7;i>=0;i--)
-	{
-		if (unsigned_integer & (((uint64_t)0xff) << (i * 8)))
-		{
-			bytes = (i + 1);
-			break;
-		}
-	}
-
-	// magic byte
-	size_t buffer_length = 1;
-
-	if (bytes > 0xff)
-	{
-		// 4 byte length field
-		buffer_length += 4;
-	}
-	else
-	{
-		// single byte length field
-		++buffer_length;
-	}
-
-	// signed byte
-	++buffer_length;
-
-	// additional bytes
-	buffer_length += bytes;
-
-	unsigned char buffer[buffer_length];
+	// magic byte + length field + signed byte + additional bytes
+	size_t buffer_length = 1 + (bytes > 0xff ? 4 : 1) + 1 + bytes;
+	unsigned char buffer[1 + 4 + 1 + sizeof(uint64_t)];
 	unsigned char *buffer_ptr = buffer;
 
 	if (bytes > 0xff)
@@ -134,41 +118,178 @@ int bert_encode_bignum(bert_encoder_t *encoder,int64_t integer)
 
 int bert_encode_atom(bert_encoder_t *encoder,const char *atom,size_t length)
 {
-	size_t buffer_length = 1 + 2 + length;
-	unsigned char buffer[buffer_length];
+	unsigned char buffer[1 + 2];
+	size_t buffer_length;
+	int result;
+	int ref;
 
-	bert_write_magic(buffer,BERT_ATOM);
-	bert_write_uint16(buffer+1,length);
+	if (encoder->atom_refs && (ref = bert_atom_refs_lookup(encoder->atom_refs,atom,length)) >= 0)
+	{
+		bert_write_magic(buffer,BERT_ATOM_CACHE_REF);
+		bert_write_uint8(buffer+1,ref);
 
-	memcpy(buffer+1+2,atom,sizeof(unsigned char)*length);
+		return bert_encoder_write(encoder,buffer,1 + 1);
+	}
 
-	return bert_encoder_write(encoder,buffer,buffer_length);
+	if (encoder->small_atoms && length <= 0xff)
+	{
+		buffer_length = 1 + 1;
+
+		// atom names are kept as they were decoded, so keep the Latin-1
+		// meaning of ATOM_EXT
+		bert_write_magic(buffer,BERT_SMALL_ATOM);
+		bert_write_uint8(buffer+1,length);
+	}
+	else
+	{
+		buffer_length = 1 + 2;
+
+		bert_write_magic(buffer,BERT_ATOM);
+		bert_write_uint16(buffer+1,length);
+	}
+
+	if ((result = bert_encoder_write(encoder,buffer,buffer_length)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_encoder_write_ref(encoder,(const unsigned char *)atom,length);
+}
+
+int bert_encode_dist_header(bert_encoder_t *encoder,const struct bert_atom_refs *refs)
+{
+	unsigned char buffer[1 + 1 + (BERT_ATOM_CACHE_REFS / 2) + 1];
+	size_t buffer_length = 1 + 1;
+	const struct bert_atom_ref *ref;
+	unsigned int long_atoms = 0;
+	unsigned int i;
+	int result;
+
+	for (i=0;i<refs->length;i++)
+	{
+		if (refs->refs[i].new_entry && refs->refs[i].length > 0xff)
+		{
+			long_atoms = 1;
+		}
+	}
+
+	bert_write_magic(buffer,BERT_DIST_HEADER);
+	bert_write_uint8(buffer+1,refs->length);
+
+	if (refs->length)
+	{
+		unsigned char *flags = buffer + buffer_length;
+		unsigned char flag;
+
+		buffer_length += (refs->length / 2) + 1;
+		memset(flags,0,sizeof(unsigned char)*((refs->length / 2) + 1));
+
+		// a half byte of flags per reference, followed by the long atoms flag
+		for (i=0;i<=refs->length;i++)
+		{
+			if (i < refs->length)
+			{
+				ref = refs->refs + i;
+				flag = (ref->new_entry ? 0x08 : 0x00) | ((ref->index >> 8) & 0x07);
+			}
+			else
+			{
+				flag = long_atoms;
+			}
+
+			flags[i / 2] |= ((i & 0x01) ? (flag << 4) : flag);
+		}
+	}
+
+	if ((result = bert_encoder_write(encoder,buffer,buffer_length)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	for (i=0;i<refs->length;i++)
+	{
+		ref = refs->refs + i;
+
+		bert_write_uint8(buffer,ref->index & 0xff);
+		buffer_length = 1;
+
+		if (ref->new_entry)
+		{
+			if (long_atoms)
+			{
+				bert_write_uint16(buffer+1,ref->length);
+				buffer_length += 2;
+			}
+			else
+			{
+				bert_write_uint8(buffer+1,ref->length);
+				buffer_length += 1;
+			}
+		}
+
+		if ((result = bert_encoder_write(encoder,buffer,buffer_length)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		if (ref->new_entry)
+		{
+			if ((result = bert_encoder_write_ref(encoder,(const unsigned char *)(ref->name),ref->length)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+		}
+	}
+
+	return BERT_SUCCESS;
 }
 
 int bert_encode_string(bert_encoder_t *encoder,const char *string,size_t length)
 {
-	size_t buffer_length = 1 + 4 + length;
-	unsigned char buffer[buffer_length];
+	unsigned char buffer[1 + 4];
+	int result;
 
 	bert_write_magic(buffer,BERT_STRING);
 	bert_write_uint32(buffer+1,length);
 
-	memcpy(buffer+1+4,string,sizeof(unsigned char)*length);
+	if ((result = bert_encoder_write(encoder,buffer,1 + 4)) != BERT_SUCCESS)
+	{
+		return result;
+	}
 
-	return bert_encoder_write(encoder,buffer,buffer_length);
+	return bert_encoder_write_ref(encoder,(const unsigned char *)string,length);
 }
 
 int bert_encode_bin(bert_encoder_t *encoder,const unsigned char *bin,size_t length)
 {
-	size_t buffer_length = 1 + 4 + length;
-	unsigned char buffer[buffer_length];
+	unsigned char buffer[1 + 4];
+	int result;
 
 	bert_write_magic(buffer,BERT_BIN);
 	bert_write_uint32(buffer+1,length);
 
-	memcpy(buffer+1+4,bin,sizeof(unsigned char)*length);
+	if ((result = bert_encoder_write(encoder,buffer,1 + 4)) != BERT_SUCCESS)
+	{
+		return result;
+	}
 
-	return bert_encoder_write(encoder,buffer,buffer_length);
+	return bert_encoder_write_ref(encoder,bin,length);
+}
+
+int bert_encode_file(bert_encoder_t *encoder,int fd,off_t offset,size_t length)
+{
+	unsigned char buffer[1 + 4];
+	int result;
+
+	bert_write_magic(buffer,BERT_BIN);
+	bert_write_uint32(buffer+1,length);
+
+	if ((result = bert_encoder_write(encoder,buffer,1 + 4)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	return bert_encoder_write_file(encoder,fd,offset,length);
 }
 
 int bert_encode_tuple_header(bert_encoder_t *encoder,size_t elements)
@@ -198,28 +319,6 @@ int bert_encode_tuple_header(bert_encoder_t *encoder,size_t elements)
 	return bert_encoder_write(encoder,buffer,buffer_length);
 }
 
-int bert_encode_tuple(bert_encoder_t *encoder,const bert_data_t **elements,size_t length)
-{
-	int result;
-
-	if ((result = bert_encode_tuple_header(encoder,length)) != BERT_SUCCESS)
-	{
-		return result;
-	}
-
-	unsigned int i;
-
-	for (i=0;i<length;i++)
-	{
-		if ((result = bert_encoder_push(encoder,elements[i])) != BERT_SUCCESS)
-		{
-			return result;
-		}
-	}
-
-	return BERT_SUCCESS;
-}
-
 int bert_encode_list_header(bert_encoder_t *encoder,size_t length)
 {
 	size_t buffer_length = 1 + 4;
@@ -231,37 +330,13 @@ int bert_encode_list_header(bert_encoder_t *encoder,size_t length)
 	return bert_encoder_write(encoder,buffer,buffer_length);
 }
 
-int bert_encode_list(bert_encoder_t *encoder,const bert_list_t *list)
+int bert_encode_list_tail(bert_encoder_t *encoder)
 {
-	bert_list_node_t *next_node = list->head;
-	size_t length = 0;
-
-	while (next_node)
-	{
-		++length;
-		next_node = next_node->next;
-	}
-
-	int result;
-
-	if ((result = bert_encode_list_header(encoder,length)) != BERT_SUCCESS)
-	{
-		return result;
-	}
-
-	next_node = list->head;
-
-	while (next_node)
-	{
-		if ((result = bert_encoder_push(encoder,next_node->data)) != BERT_SUCCESS)
-		{
-			return result;
-		}
+	unsigned char buffer[1];
 
-		next_node = next_node->next;
-	}
+	bert_write_magic(buffer,BERT_NIL);
 
-	return BERT_SUCCESS;
+	return bert_encoder_write(encoder,buffer,1);
 }
 
 int bert_encode_complex_header(bert_encoder_t *encoder,const char *name,size_t elements)
@@ -315,17 +390,8 @@ int bert_encode_false(bert_encoder_t *encoder)
 	return bert_encode_complex_header(encoder,"false",0);
 }
 
-int bert_encode_dict(bert_encoder_t *encoder,const bert_dict_t *dict)
+int bert_encode_dict_header(bert_encoder_t *encoder,size_t length)
 {
-	bert_dict_node_t *next_node = dict->head;
-	size_t length = 0;
-
-	while (next_node)
-	{
-		++length;
-		next_node = next_node->next;
-	}
-
 	int result;
 
 	if ((result = bert_encode_complex_header(encoder,"dict",1)) != BERT_SUCCESS)
@@ -333,34 +399,22 @@ int bert_encode_dict(bert_encoder_t *encoder,const bert_dict_t *dict)
 		return result;
 	}
 
-	if ((result = bert_encode_list_header(encoder,length)) != BERT_SUCCESS)
-	{
-		return result;
-	}
+	return bert_encode_list_header(encoder,length);
+}
 
-	next_node = dict->head;
+int bert_encode_map_header(bert_encoder_t *encoder,size_t length)
+{
+	unsigned char buffer[1 + 4];
 
-	while (next_node)
+	if (length > 0xffffffff)
 	{
-		if ((result = bert_encode_tuple_header(encoder,2)) != BERT_SUCCESS)
-		{
-			return result;
-		}
-
-		if ((result = bert_encoder_push(encoder,next_node->key)) != BERT_SUCCESS)
-		{
-			return result;
-		}
-
-		if ((result = bert_encoder_push(encoder,next_node->value)) != BERT_SUCCESS)
-		{
-			return result;
-		}
-
-		next_node = next_node->next;
+		return BERT_ERRNO_INVALID;
 	}
 
-	return BERT_SUCCESS;
+	bert_write_magic(buffer,BERT_MAP);
+	bert_write_uint32(buffer+1,length);
+
+	return bert_encoder_write(encoder,buffer,1 + 4);
 }
 
 int bert_encode_time(bert_encoder_t *encoder,time_t timestamp)
@@ -436,5 +490,5 @@ int bert_encode_regex(bert_encoder_t *encoder,const char *source,size_t length,u
 		}
 	}
 
-	return BERT_SUCCESS;
+	return bert_encode_list_tail(encoder);
 }
@@ -1,17 +1,703 @@
+#include <bert/config.h>
 #include "encoder.h"
+#include "alloc.h"
+#include <bert/util.h>
 #include <bert/errno.h>
 
+#if defined(BERT_SENDFILE)
+#include <sys/sendfile.h>
+#endif
+
+#include <sys/mman.h>
 #include <unistd.h>
+#include <limits.h>
 #include <string.h>
+#include <errno.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX	1024
+#endif
+
+static int bert_encoder_write_stream(int stream,const unsigned char *data,size_t length)
+{
+	ssize_t result;
+
+	while (length)
+	{
+		if ((result = write(stream,data,length)) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return BERT_ERRNO_WRITE;
+		}
+
+		data += result;
+		length -= result;
+	}
+
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_writev_stream(int stream,struct iovec *iov,unsigned int count)
+{
+	ssize_t result;
+
+	while (count)
+	{
+		if ((result = writev(stream,iov,(count < IOV_MAX ? count : IOV_MAX))) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return BERT_ERRNO_WRITE;
+		}
+
+		// skip the fully written iovecs, and trim a partially written one
+		while (count && (size_t)result >= iov->iov_len)
+		{
+			result -= iov->iov_len;
+
+			++iov;
+			--count;
+		}
+
+		if (count)
+		{
+			iov->iov_base = (unsigned char *)iov->iov_base + result;
+			iov->iov_len -= result;
+		}
+	}
+
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_write_callback(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	size_t chunk;
+	ssize_t result;
+
+	while (length)
+	{
+		chunk = (length < BERT_ENCODER_CHUNK ? length : BERT_ENCODER_CHUNK);
+
+		if ((result = encoder->callback.ptr(data,chunk,encoder->callback.data)) < 0 || (size_t)result > chunk)
+		{
+			return BERT_ERRNO_INVALID;
+		}
+
+		if (!encoder->partial_writes)
+		{
+			// callbacks are not required to report how much they wrote
+			result = chunk;
+		}
+		else if (!result)
+		{
+			return BERT_ERRNO_SHORT_WRITE;
+		}
+
+		data += result;
+		length -= result;
+	}
+
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_write_sink(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	size_t chunk;
+
+	while (length)
+	{
+		if (encoder->sink.used == encoder->sink.available)
+		{
+			// the reservation is full, or wrapped around before its end
+			bert_encoder_commit(encoder);
+
+			// reserve the rest of the term at once, rather than each
+			// fragment of it
+			chunk = (encoder->sink.expected > length ? encoder->sink.expected : length);
+
+			if (!(encoder->sink.ptr = encoder->sink.reserve(chunk,&(encoder->sink.available),encoder->sink.data)) || !encoder->sink.available)
+			{
+				encoder->sink.ptr = NULL;
+				encoder->sink.available = 0;
+				return BERT_ERRNO_SHORT_WRITE;
+			}
+		}
+
+		chunk = MIN(encoder->sink.available - encoder->sink.used,length);
+		memcpy(encoder->sink.ptr+encoder->sink.used,data,sizeof(unsigned char)*chunk);
+
+		encoder->sink.used += chunk;
+		encoder->sink.expected -= MIN(encoder->sink.expected,chunk);
+		data += chunk;
+		length -= chunk;
+	}
+
+	return BERT_SUCCESS;
+}
+
+void bert_encoder_commit(bert_encoder_t *encoder)
+{
+	if (encoder->sink.used)
+	{
+		encoder->sink.commit(encoder->sink.used,encoder->sink.data);
+	}
+
+	encoder->sink.ptr = NULL;
+	encoder->sink.available = 0;
+	encoder->sink.used = 0;
+}
+
+/*
+ * Moves the mapped window to the end of what has been written, extending
+ * the file by another extent.
+ */
+static int bert_encoder_map_extent(bert_encoder_t *encoder)
+{
+	off_t offset = encoder->mapped.length;
+	void *ptr;
+
+	if (encoder->mapped.ptr)
+	{
+		munmap(encoder->mapped.ptr,encoder->mapped.size);
+
+		encoder->mapped.ptr = NULL;
+		encoder->mapped.size = 0;
+	}
+
+	if (ftruncate(encoder->mapped.fd,offset + BERT_ENCODER_EXTENT) < 0)
+	{
+		return BERT_ERRNO_WRITE;
+	}
+
+	if ((ptr = mmap(NULL,BERT_ENCODER_EXTENT,PROT_READ | PROT_WRITE,MAP_SHARED,encoder->mapped.fd,offset)) == MAP_FAILED)
+	{
+		return BERT_ERRNO_WRITE;
+	}
+
+	encoder->mapped.ptr = ptr;
+	encoder->mapped.offset = offset;
+	encoder->mapped.size = BERT_ENCODER_EXTENT;
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_write_mapped(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	size_t index;
+	size_t chunk;
+	int result;
+
+	while (length)
+	{
+		index = encoder->mapped.length - encoder->mapped.offset;
+
+		if (!encoder->mapped.ptr || index >= encoder->mapped.size)
+		{
+			if ((result = bert_encoder_map_extent(encoder)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+
+			index = 0;
+		}
+
+		chunk = MIN(encoder->mapped.size - index,length);
+		memcpy(encoder->mapped.ptr+index,data,sizeof(unsigned char)*chunk);
+
+		encoder->mapped.length += chunk;
+		data += chunk;
+		length -= chunk;
+	}
+
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_unmap(bert_encoder_t *encoder)
+{
+	int result = BERT_SUCCESS;
+
+	if (encoder->mapped.ptr)
+	{
+		munmap(encoder->mapped.ptr,encoder->mapped.size);
+	}
+
+	// drop the unused end of the last extent
+	if (ftruncate(encoder->mapped.fd,encoder->mapped.length) < 0)
+	{
+		result = BERT_ERRNO_WRITE;
+	}
+
+	close(encoder->mapped.fd);
+
+	encoder->mode = bert_mode_none;
+	encoder->mapped.fd = -1;
+	encoder->mapped.ptr = NULL;
+	encoder->mapped.size = 0;
+	return result;
+}
+
+static const bert_allocator_t * bert_encoder_output_allocator(bert_encoder_t *encoder)
+{
+	if (!encoder->output.block && !encoder->output.retired && !encoder->vector.ptr && !encoder->segments.head)
+	{
+		encoder->output.allocator = (encoder->data_allocator ? encoder->data_allocator : bert_allocator_current());
+	}
+
+	return encoder->output.allocator;
+}
+
+static int bert_encoder_append_iov(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	if (encoder->vector.length >= encoder->vector.size)
+	{
+		const bert_allocator_t *allocator = bert_encoder_output_allocator(encoder);
+		unsigned int size = (encoder->vector.size ? encoder->vector.size * 2 : BERT_ENCODER_IOVECS);
+		struct iovec *new_ptr;
+
+		if (!(new_ptr = bert_realloc(allocator,encoder->vector.ptr,sizeof(struct iovec) * size)))
+		{
+			// malloc failed
+			return BERT_ERRNO_MALLOC;
+		}
+
+		encoder->vector.ptr = new_ptr;
+		encoder->vector.size = size;
+	}
+
+	struct iovec *iov = encoder->vector.ptr + encoder->vector.length;
+
+	iov->iov_base = (void *)data;
+	iov->iov_len = length;
+
+	++encoder->vector.length;
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_seal_output(bert_encoder_t *encoder)
+{
+	size_t pending = encoder->output.length - encoder->output.mark;
+	int result;
+
+	if (!pending)
+	{
+		return BERT_SUCCESS;
+	}
+
+	if ((result = bert_encoder_append_iov(encoder,encoder->output.block->data + encoder->output.mark,pending)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	encoder->output.mark = encoder->output.length;
+	return BERT_SUCCESS;
+}
+
+int bert_encoder_flush_output(bert_encoder_t *encoder)
+{
+	int result;
+
+	if ((result = bert_encoder_seal_output(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (encoder->mode != bert_mode_stream)
+	{
+		// the iovecs are kept until they are cleared by the caller
+		return BERT_SUCCESS;
+	}
+
+	result = bert_encoder_writev_stream(encoder->stream,encoder->vector.ptr,encoder->vector.length);
+
+	encoder->output.length = 0;
+	encoder->output.mark = 0;
+	encoder->vector.length = 0;
+	return result;
+}
+
+static void bert_encoder_free_blocks(const bert_allocator_t *allocator,struct bert_encoder_block *block)
+{
+	struct bert_encoder_block *next;
+
+	while (block)
+	{
+		next = block->next;
+
+		bert_free(allocator,block);
+		block = next;
+	}
+}
+
+void bert_encoder_reset_output(bert_encoder_t *encoder)
+{
+	bert_encoder_free_blocks(encoder->output.allocator,encoder->output.retired);
+
+	encoder->output.retired = NULL;
+	encoder->output.length = 0;
+	encoder->output.mark = 0;
+	encoder->vector.length = 0;
+}
+
+void bert_encoder_free_output(bert_encoder_t *encoder)
+{
+	bert_encoder_reset_output(encoder);
+	bert_encoder_free_blocks(encoder->output.allocator,encoder->output.block);
+	bert_free(encoder->output.allocator,encoder->vector.ptr);
+
+	encoder->output.block = NULL;
+	encoder->vector.ptr = NULL;
+	encoder->vector.size = 0;
+}
+
+static struct bert_encoder_block * bert_encoder_block_create(bert_encoder_t *encoder,size_t size)
+{
+	const bert_allocator_t *allocator = bert_encoder_output_allocator(encoder);
+	struct bert_encoder_block *new_block;
+
+	if (!(new_block = bert_malloc(allocator,sizeof(struct bert_encoder_block) + size)))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	new_block->next = NULL;
+	new_block->size = size;
+	return new_block;
+}
+
+static int bert_encoder_retire_output(bert_encoder_t *encoder,size_t length)
+{
+	size_t size = (length > encoder->output.size ? length : encoder->output.size);
+	struct bert_encoder_block *new_block;
+	int result;
+
+	if ((result = bert_encoder_seal_output(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if (!(new_block = bert_encoder_block_create(encoder,size)))
+	{
+		return BERT_ERRNO_MALLOC;
+	}
+
+	// the old block is still referenced by the iovecs
+	if (encoder->output.block)
+	{
+		encoder->output.block->next = encoder->output.retired;
+		encoder->output.retired = encoder->output.block;
+	}
+
+	encoder->output.block = new_block;
+	encoder->output.length = 0;
+	encoder->output.mark = 0;
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_write_output(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	int result;
+
+	if (!encoder->output.block && encoder->output.size)
+	{
+		// an unbuffered stream is used if malloc fails
+		encoder->output.block = bert_encoder_block_create(encoder,encoder->output.size);
+	}
+
+	if (!encoder->output.block || (encoder->output.length + length) > encoder->output.block->size)
+	{
+		if ((result = bert_encoder_flush_output(encoder)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		if (!encoder->output.block || length >= encoder->output.block->size)
+		{
+			// too large to buffer
+			return bert_encoder_write_stream(encoder->stream,data,length);
+		}
+	}
+
+	memcpy(encoder->output.block->data+encoder->output.length,data,sizeof(unsigned char)*length);
+	encoder->output.length += length;
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_write_iovec(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	int result;
+
+	if (!encoder->output.block || (encoder->output.length + length) > encoder->output.block->size)
+	{
+		if ((result = bert_encoder_retire_output(encoder,length)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+	}
+
+	memcpy(encoder->output.block->data+encoder->output.length,data,sizeof(unsigned char)*length);
+	encoder->output.length += length;
+	return BERT_SUCCESS;
+}
+
+static struct bert_encoder_segment * bert_encoder_segment_next(bert_encoder_t *encoder,size_t length)
+{
+	struct bert_encoder_segment *tail = encoder->segments.tail;
+	struct bert_encoder_segment *next = (tail ? tail->next : encoder->segments.head);
+
+	if (next)
+	{
+		// reuse the capacity kept from a previous message
+		encoder->segments.tail = next;
+		return next;
+	}
+
+	const bert_allocator_t *allocator = bert_encoder_output_allocator(encoder);
+	size_t size = (tail ? tail->size * 2 : (encoder->output.size ? encoder->output.size : BERT_ENCODER_OUTPUT));
+	struct bert_encoder_segment *new_segment;
+
+	if (size < length)
+	{
+		size = length;
+	}
+
+	if (!(new_segment = bert_malloc(allocator,sizeof(struct bert_encoder_segment))))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	if (!(new_segment->data = bert_malloc(allocator,size)))
+	{
+		// malloc failed
+		bert_free(allocator,new_segment);
+		return NULL;
+	}
+
+	new_segment->next = NULL;
+	new_segment->size = size;
+	new_segment->length = 0;
+
+	if (tail)
+	{
+		tail->next = new_segment;
+	}
+	else
+	{
+		encoder->segments.head = new_segment;
+	}
+
+	encoder->segments.tail = new_segment;
+	return new_segment;
+}
+
+static int bert_encoder_write_dynamic(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	struct bert_encoder_segment *segment = encoder->segments.tail;
+	size_t chunk;
+
+	while (length)
+	{
+		if (!segment || segment->length >= segment->size)
+		{
+			if (!(segment = bert_encoder_segment_next(encoder,length)))
+			{
+				return BERT_ERRNO_MALLOC;
+			}
+		}
+
+		chunk = segment->size - segment->length;
+
+		if (chunk > length)
+		{
+			chunk = length;
+		}
+
+		memcpy(segment->data+segment->length,data,sizeof(unsigned char)*chunk);
+		segment->length += chunk;
+		encoder->segments.length += chunk;
+
+		data += chunk;
+		length -= chunk;
+	}
+
+	return BERT_SUCCESS;
+}
+
+void bert_encoder_reset_segments(bert_encoder_t *encoder)
+{
+	struct bert_encoder_segment *segment;
+
+	for (segment=encoder->segments.head;segment;segment=segment->next)
+	{
+		segment->length = 0;
+	}
+
+	encoder->segments.tail = NULL;
+	encoder->segments.length = 0;
+}
+
+int bert_encoder_take_segments(bert_encoder_t *encoder,unsigned char **buffer,size_t *length)
+{
+	struct bert_encoder_segment *head = encoder->segments.head;
+	const bert_allocator_t *allocator = encoder->output.allocator;
+
+	*length = encoder->segments.length;
+
+	if (!(*length))
+	{
+		*buffer = NULL;
+		return BERT_SUCCESS;
+	}
+
+	if (head == encoder->segments.tail)
+	{
+		// hand off the only segment written to, without copying it
+		*buffer = head->data;
+
+		encoder->segments.head = head->next;
+		bert_free(allocator,head);
+
+		encoder->segments.tail = NULL;
+		encoder->segments.length = 0;
+		return BERT_SUCCESS;
+	}
+
+	unsigned char *flat;
+	struct bert_encoder_segment *segment;
+	size_t index = 0;
+
+	if (!(flat = bert_malloc(allocator,*length)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	for (segment=head;segment && index < *length;segment=segment->next)
+	{
+		memcpy(flat+index,segment->data,sizeof(unsigned char)*segment->length);
+		index += segment->length;
+	}
+
+	*buffer = flat;
+
+	bert_encoder_reset_segments(encoder);
+	return BERT_SUCCESS;
+}
+
+void bert_encoder_free_segments(bert_encoder_t *encoder)
+{
+	struct bert_encoder_segment *segment = encoder->segments.head;
+	struct bert_encoder_segment *next;
+
+	while (segment)
+	{
+		next = segment->next;
+
+		bert_free(encoder->output.allocator,segment->data);
+		bert_free(encoder->output.allocator,segment);
+		segment = next;
+	}
+
+	encoder->segments.head = NULL;
+	encoder->segments.tail = NULL;
+	encoder->segments.length = 0;
+}
+
+size_t bert_encoder_offset(const bert_encoder_t *encoder)
+{
+	switch (encoder->mode)
+	{
+		case bert_mode_buffer:
+			return encoder->buffer.index;
+		case bert_mode_dynamic:
+			return encoder->segments.length;
+		case bert_mode_mmap:
+			return encoder->mapped.length;
+		default:
+			return encoder->total;
+	}
+}
+
+int bert_encoder_patch(bert_encoder_t *encoder,size_t offset,const unsigned char *data,size_t length)
+{
+	struct bert_encoder_segment *segment;
+	size_t chunk;
+
+	switch (encoder->mode)
+	{
+		case bert_mode_buffer:
+			if ((offset + length) > encoder->buffer.index)
+			{
+				return BERT_ERRNO_INVALID;
+			}
+
+			memcpy(encoder->buffer.ptr+offset,data,sizeof(unsigned char)*length);
+			return BERT_SUCCESS;
+		case bert_mode_dynamic:
+			if ((offset + length) > encoder->segments.length)
+			{
+				return BERT_ERRNO_INVALID;
+			}
+
+			// the patched bytes may span more than one segment
+			for (segment=encoder->segments.head;segment && length;segment=segment->next)
+			{
+				if (offset >= segment->length)
+				{
+					offset -= segment->length;
+					continue;
+				}
+
+				chunk = MIN(segment->length - offset,length);
+				memcpy(segment->data+offset,data,sizeof(unsigned char)*chunk);
+
+				data += chunk;
+				length -= chunk;
+				offset = 0;
+			}
+
+			return BERT_SUCCESS;
+		case bert_mode_mmap:
+			if ((offset + length) > encoder->mapped.length)
+			{
+				return BERT_ERRNO_INVALID;
+			}
+
+			if (offset >= encoder->mapped.offset)
+			{
+				memcpy(encoder->mapped.ptr+(offset - encoder->mapped.offset),data,sizeof(unsigned char)*length);
+				return BERT_SUCCESS;
+			}
+
+			// the bytes are no longer mapped
+			if (pwrite(encoder->mapped.fd,data,length,offset) != (ssize_t)length)
+			{
+				return BERT_ERRNO_WRITE;
+			}
+
+			return BERT_SUCCESS;
+		default:
+			return BERT_ERRNO_INVALID;
+	}
+}
 
 int bert_encoder_write(bert_encoder_t *encoder,const unsigned char *data,size_t length)
 {
+	int result;
+
 	switch (encoder->mode)
 	{
 		case bert_mode_stream:
-			if (write(encoder->stream,data,length) < 0)
+			if ((result = bert_encoder_write_output(encoder,data,length)) != BERT_SUCCESS)
 			{
-				return BERT_ERRNO_WRITE;
+				return result;
 			}
 			break;
 		case bert_mode_buffer:
@@ -24,9 +710,39 @@ int bert_encoder_write(bert_encoder_t *encoder,const unsigned char *data,size_t
 			encoder->buffer.index += length;
 			break;
 		case bert_mode_callback:
-			if (encoder->callback.ptr(data,length,encoder->callback.data) < 0)
+			if ((result = bert_encoder_write_callback(encoder,data,length)) != BERT_SUCCESS)
 			{
-				return BERT_ERRNO_INVALID;
+				return result;
+			}
+			break;
+		case bert_mode_mmap:
+			if ((result = bert_encoder_write_mapped(encoder,data,length)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+			break;
+		case bert_mode_reserve:
+			if ((encoder->sink.available - encoder->sink.used) >= length)
+			{
+				// the fragment fits in the current reservation
+				memcpy(encoder->sink.ptr+encoder->sink.used,data,sizeof(unsigned char)*length);
+				encoder->sink.used += length;
+			}
+			else if ((result = bert_encoder_write_sink(encoder,data,length)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+			break;
+		case bert_mode_iovec:
+			if ((result = bert_encoder_write_iovec(encoder,data,length)) != BERT_SUCCESS)
+			{
+				return result;
+			}
+			break;
+		case bert_mode_dynamic:
+			if ((result = bert_encoder_write_dynamic(encoder,data,length)) != BERT_SUCCESS)
+			{
+				return result;
 			}
 			break;
 		default:
@@ -36,3 +752,202 @@ int bert_encoder_write(bert_encoder_t *encoder,const unsigned char *data,size_t
 	encoder->total += length;
 	return BERT_SUCCESS;
 }
+
+int bert_encoder_write_ref(bert_encoder_t *encoder,const unsigned char *data,size_t length)
+{
+	int result;
+
+	if (length < BERT_ENCODER_REFERENCE || encoder->frames.length)
+	{
+		// terms left open by the builder are only flushed once complete,
+		// after the caller may have reused its buffers
+		return bert_encoder_write(encoder,data,length);
+	}
+
+	switch (encoder->mode)
+	{
+		case bert_mode_stream:
+			if (!encoder->output.size)
+			{
+				return bert_encoder_write(encoder,data,length);
+			}
+
+			if (encoder->vector.length >= (BERT_ENCODER_IOVECS - 2))
+			{
+				if ((result = bert_encoder_flush_output(encoder)) != BERT_SUCCESS)
+				{
+					return result;
+				}
+			}
+			break;
+		case bert_mode_iovec:
+			break;
+		default:
+			return bert_encoder_write(encoder,data,length);
+	}
+
+	// reference the payload in place, after anything already staged
+	if ((result = bert_encoder_seal_output(encoder)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	if ((result = bert_encoder_append_iov(encoder,data,length)) != BERT_SUCCESS)
+	{
+		return result;
+	}
+
+	encoder->total += length;
+	return BERT_SUCCESS;
+}
+
+static int bert_encoder_read_file(int fd,off_t offset,unsigned char *buffer,size_t length)
+{
+	ssize_t result;
+
+	while (length)
+	{
+		if ((result = pread(fd,buffer,length,offset)) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return BERT_ERRNO_READ;
+		}
+		else if (!result)
+		{
+			// the file is shorter than expected
+			return BERT_ERRNO_READ;
+		}
+
+		buffer += result;
+		offset += result;
+		length -= result;
+	}
+
+	return BERT_SUCCESS;
+}
+
+#if defined(BERT_SENDFILE)
+static int bert_encoder_sendfile(bert_encoder_t *encoder,int fd,off_t offset,size_t length)
+{
+	size_t remaining = length;
+	ssize_t result;
+	int flushed;
+
+	if ((flushed = bert_encoder_flush_output(encoder)) != BERT_SUCCESS)
+	{
+		return flushed;
+	}
+
+	while (remaining)
+	{
+		if ((result = sendfile(encoder->stream,fd,&offset,remaining)) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			if ((errno == EINVAL || errno == ENOSYS) && remaining == length)
+			{
+				// the descriptors do not support sendfile
+				return BERT_ERRNO_INVALID;
+			}
+
+			return BERT_ERRNO_WRITE;
+		}
+		else if (!result)
+		{
+			// the file is shorter than expected
+			return BERT_ERRNO_READ;
+		}
+
+		remaining -= result;
+	}
+
+	return BERT_SUCCESS;
+}
+#endif
+
+int bert_encoder_write_file(bert_encoder_t *encoder,int fd,off_t offset,size_t length)
+{
+	int result;
+
+#if defined(BERT_SENDFILE)
+	if (encoder->mode == bert_mode_stream && length >= BERT_ENCODER_REFERENCE)
+	{
+		if ((result = bert_encoder_sendfile(encoder,fd,offset,length)) != BERT_ERRNO_INVALID)
+		{
+			if (result == BERT_SUCCESS)
+			{
+				encoder->total += length;
+			}
+
+			return result;
+		}
+	}
+#endif
+
+	if (encoder->mode == bert_mode_buffer)
+	{
+		// read straight into the output buffer
+		if ((encoder->buffer.index + length) > encoder->buffer.length)
+		{
+			return BERT_ERRNO_SHORT_WRITE;
+		}
+
+		if ((result = bert_encoder_read_file(fd,offset,encoder->buffer.ptr+encoder->buffer.index,length)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		encoder->buffer.index += length;
+		encoder->total += length;
+		return BERT_SUCCESS;
+	}
+
+	const bert_allocator_t *allocator = (encoder->data_allocator ? encoder->data_allocator : bert_allocator_current());
+	size_t chunk = (length < BERT_ENCODER_CHUNK ? length : BERT_ENCODER_CHUNK);
+	unsigned char *buffer;
+
+	if (!length)
+	{
+		return BERT_SUCCESS;
+	}
+
+	if (!(buffer = bert_malloc(allocator,chunk)))
+	{
+		// malloc failed
+		return BERT_ERRNO_MALLOC;
+	}
+
+	while (length)
+	{
+		if (chunk > length)
+		{
+			chunk = length;
+		}
+
+		if ((result = bert_encoder_read_file(fd,offset,buffer,chunk)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+
+		if ((result = bert_encoder_write(encoder,buffer,chunk)) != BERT_SUCCESS)
+		{
+			goto cleanup;
+		}
+
+		offset += chunk;
+		length -= chunk;
+	}
+
+	result = BERT_SUCCESS;
+
+cleanup:
+	bert_free(allocator,buffer);
+	return result;
+}
@@ -2,13 +2,88 @@
 #define _BERT_PRIVATE_ENCODER_H_
 
 #include <bert/encoder.h>
+#include <bert/alloc.h>
+
+#include <sys/uio.h>
+
+#define BERT_ENCODER_IOVECS	64
+
+/*
+ * Largest number of bytes passed to a bert_write_func at once.
+ */
+#define BERT_ENCODER_CHUNK	(1024 * 64)
+
+#define BERT_ENCODER_FRAMES	8
+
+/*
+ * Staging area for encoded headers and small terms. Blocks which are still
+ * referenced from the iovec list are retired rather than reused.
+ */
+struct bert_encoder_block
+{
+	struct bert_encoder_block *next;
+	size_t size;
+
+	unsigned char data[];
+};
+
+/*
+ * Segment of the output in bert_mode_dynamic. Segments are kept in the
+ * order they were written, and are reused after the encoder is reset.
+ */
+struct bert_encoder_segment
+{
+	struct bert_encoder_segment *next;
+	size_t size;
+	size_t length;
+
+	unsigned char *data;
+};
+
+/*
+ * Tuple or list opened by the term builder functions.
+ */
+struct bert_encoder_frame
+{
+	bert_data_type type;
+
+	// elements still to be written to a tuple
+	size_t remaining;
+
+	// elements written to the current segment of a list
+	size_t count;
+
+	// offset of the list header which is patched when the list ends
+	size_t offset;
+
+	// whether the list is staged, and how many segments were written
+	int staged;
+	unsigned int written;
+};
 
 struct bert_encoder
 {
 	bert_mode mode;
 	unsigned int wrote_magic;
+	unsigned int small_atoms;
+	unsigned int maps;
+	unsigned int partial_writes;
+
+	struct
+	{
+		size_t threshold;
+		int level;
+	} compress;
+
+	// atom cache of the connection, and the references of the message
+	// being encoded
+	struct bert_atom_cache *atom_cache;
+	struct bert_atom_refs *atom_refs;
 	size_t total;
 
+	const bert_allocator_t *allocator;
+	const bert_allocator_t *data_allocator;
+
 	union
 	{
 		int stream;
@@ -18,7 +93,7 @@ struct bert_encoder
 			unsigned char *ptr;
 			size_t length;
 
-			unsigned int index;
+			size_t index;
 		} buffer;
 
 		struct
@@ -26,9 +101,108 @@ struct bert_encoder
 			bert_write_func ptr;
 			void *data;
 		} callback;
+
+		struct
+		{
+			bert_reserve_func reserve;
+			bert_commit_func commit;
+			void *data;
+
+			// the current reservation, and how much of it was written
+			unsigned char *ptr;
+			size_t available;
+			size_t used;
+
+			// bytes the current push is still expected to write
+			size_t expected;
+		} sink;
+
+		struct
+		{
+			int fd;
+
+			// window of the file which is currently mapped
+			unsigned char *ptr;
+			off_t offset;
+			size_t size;
+
+			// bytes written to the file
+			size_t length;
+		} mapped;
 	};
+
+	struct
+	{
+		struct bert_encoder_block *block;
+		struct bert_encoder_block *retired;
+
+		size_t size;
+		size_t length;
+		size_t mark;
+
+		const bert_allocator_t *allocator;
+	} output;
+
+	struct
+	{
+		struct iovec *ptr;
+		unsigned int length;
+		unsigned int size;
+	} vector;
+
+	struct
+	{
+		struct bert_encoder_segment *head;
+		struct bert_encoder_segment *tail;
+
+		size_t length;
+	} segments;
+
+	struct
+	{
+		struct bert_encoder_frame *ptr;
+		unsigned int length;
+		unsigned int size;
+
+		// mode to restore once a staged list has been written out
+		bert_mode mode;
+	} frames;
 };
 
+/*
+ * Writes the magic byte, unless the encoder already has.
+ */
+int bert_encoder_push_magic(bert_encoder_t *encoder);
+
+/*
+ * Encodes the given data without writing the magic byte or flushing.
+ */
+int bert_encoder_push_term(bert_encoder_t *encoder,const bert_data_t *data);
+
+/*
+ * Encodes the given data with the given small atoms and maps settings into
+ * a buffer of exactly the size bert_data_sizeof_encoded() returns for
+ * them, plus one when the magic byte is written.
+ */
+int bert_encoder_push_exact(const bert_data_t *data,unsigned char *buffer,size_t length,int magic,unsigned int small_atoms,unsigned int maps);
+
 int bert_encoder_write(bert_encoder_t *encoder,const unsigned char *data,size_t length);
+int bert_encoder_write_ref(bert_encoder_t *encoder,const unsigned char *data,size_t length);
+int bert_encoder_write_file(bert_encoder_t *encoder,int fd,off_t offset,size_t length);
+int bert_encoder_flush_output(bert_encoder_t *encoder);
+void bert_encoder_commit(bert_encoder_t *encoder);
+int bert_encoder_unmap(bert_encoder_t *encoder);
+void bert_encoder_reset_output(bert_encoder_t *encoder);
+void bert_encoder_free_output(bert_encoder_t *encoder);
+
+size_t bert_encoder_offset(const bert_encoder_t *encoder);
+int bert_encoder_patch(bert_encoder_t *encoder,size_t offset,const unsigned char *data,size_t length);
+
+void bert_encoder_reset_frames(bert_encoder_t *encoder);
+void bert_encoder_free_frames(bert_encoder_t *encoder);
+
+void bert_encoder_reset_segments(bert_encoder_t *encoder);
+int bert_encoder_take_segments(bert_encoder_t *encoder,unsigned char **buffer,size_t *length);
+void bert_encoder_free_segments(bert_encoder_t *encoder);
 
 #endif
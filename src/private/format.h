@@ -0,0 +1,42 @@
+#ifndef _BERT_PRIVATE_FORMAT_H_
+#define _BERT_PRIVATE_FORMAT_H_
+
+#include <bert/format.h>
+#include <bert/alloc.h>
+
+typedef enum
+{
+	bert_format_bytes = 0,
+	bert_format_int,
+	bert_format_float,
+	bert_format_atom,
+	bert_format_string,
+	bert_format_bin,
+	bert_format_term
+} bert_format_op_type;
+
+/*
+ * A single step of a compiled format, either writing a range of the
+ * pre-encoded bytes or filling in a hole.
+ */
+struct bert_format_op
+{
+	bert_format_op_type type;
+
+	size_t offset;
+	size_t length;
+};
+
+struct bert_format
+{
+	unsigned char *bytes;
+	size_t length;
+
+	struct bert_format_op *ops;
+	unsigned int count;
+	unsigned int holes;
+
+	const bert_allocator_t *allocator;
+};
+
+#endif
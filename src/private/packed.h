@@ -0,0 +1,40 @@
+#ifndef _BERT_PRIVATE_PACKED_H_
+#define _BERT_PRIVATE_PACKED_H_
+
+#include <bert/packed.h>
+
+#include <stdint.h>
+
+#define BERT_PACKED_MAGIC	0x42455254
+#define BERT_PACKED_VERSION	1
+
+#define BERT_PACKED_ALIGN(n)	(((n) + 7) & ~((size_t)7))
+
+/*
+ * Header at the start of every packed block. Every pointer within the
+ * block is stored as base plus the offset of its target, and the offsets
+ * of the pointers themselves are listed in the relocation table.
+ */
+struct bert_packed
+{
+	uint32_t magic;
+	uint32_t version;
+
+	uint64_t length;
+	uint64_t base;
+	uint64_t root;
+
+	uint64_t reloc_offset;
+	uint64_t reloc_count;
+};
+
+struct bert_packer
+{
+	unsigned char *buffer;
+	size_t index;
+
+	uint64_t *relocs;
+	size_t reloc_count;
+};
+
+#endif
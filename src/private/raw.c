@@ -0,0 +1,133 @@
+#include "raw.h"
+
+#include <bert/magic.h>
+#include <bert/util.h>
+#include <bert/errno.h>
+
+int bert_raw_header(bert_magic_t tag,size_t *size)
+{
+	switch (tag)
+	{
+		case BERT_NIL:
+			*size = 0;
+			break;
+		case BERT_SMALL_INT:
+		case BERT_SMALL_ATOM:
+		case BERT_SMALL_ATOM_UTF8:
+		case BERT_SMALL_TUPLE:
+			*size = 1;
+			break;
+		case BERT_ATOM:
+		case BERT_ATOM_UTF8:
+		case BERT_STRING:
+		case BERT_SMALL_BIGNUM:
+			*size = 2;
+			break;
+		case BERT_INT:
+		case BERT_BIN:
+		case BERT_LARGE_TUPLE:
+		case BERT_LIST:
+		case BERT_MAP:
+			*size = 4;
+			break;
+		case BERT_LARGE_BIGNUM:
+			*size = 5;
+			break;
+		case BERT_FLOAT:
+			*size = 31;
+			break;
+		default:
+			// atom cache references only mean something within their message
+			return BERT_ERRNO_INVALID;
+	}
+
+	return BERT_SUCCESS;
+}
+
+void bert_raw_contents(bert_magic_t tag,const unsigned char *header,size_t *bytes,size_t *terms)
+{
+	*bytes = 0;
+	*terms = 0;
+
+	switch (tag)
+	{
+		case BERT_SMALL_ATOM:
+		case BERT_SMALL_ATOM_UTF8:
+			*bytes = bert_read_uint8(header);
+			break;
+		case BERT_ATOM:
+		case BERT_ATOM_UTF8:
+		case BERT_STRING:
+			*bytes = bert_read_uint16(header);
+			break;
+		case BERT_SMALL_BIGNUM:
+			// the digits follow the sign byte
+			*bytes = bert_read_uint8(header);
+			break;
+		case BERT_LARGE_BIGNUM:
+		case BERT_BIN:
+			*bytes = bert_read_uint32(header);
+			break;
+		case BERT_SMALL_TUPLE:
+			*terms = bert_read_uint8(header);
+			break;
+		case BERT_LARGE_TUPLE:
+			*terms = bert_read_uint32(header);
+			break;
+		case BERT_LIST:
+			// the elements, followed by the tail
+			*terms = (size_t)bert_read_uint32(header) + 1;
+			break;
+		case BERT_MAP:
+			*terms = (size_t)bert_read_uint32(header) * 2;
+			break;
+		default:
+			break;
+	}
+}
+
+int bert_raw_length(const unsigned char *buffer,size_t length,size_t *size)
+{
+	size_t index = 0;
+	size_t pending = 1;
+	size_t header;
+	size_t bytes;
+	size_t terms;
+	bert_magic_t tag;
+	int result;
+
+	// nested terms are counted rather than recursed into
+	while (pending)
+	{
+		if (index >= length)
+		{
+			return BERT_ERRNO_SHORT_READ;
+		}
+
+		tag = bert_read_magic(buffer + index);
+
+		if ((result = bert_raw_header(tag,&header)) != BERT_SUCCESS)
+		{
+			return result;
+		}
+
+		if (header > (length - index - 1))
+		{
+			return BERT_ERRNO_SHORT_READ;
+		}
+
+		bert_raw_contents(tag,buffer + index + 1,&bytes,&terms);
+		index += (1 + header);
+
+		if (bytes > (length - index))
+		{
+			return BERT_ERRNO_SHORT_READ;
+		}
+
+		index += bytes;
+		pending = (pending - 1) + terms;
+	}
+
+	*size = index;
+	return BERT_SUCCESS;
+}
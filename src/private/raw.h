@@ -0,0 +1,29 @@
+#ifndef _BERT_PRIVATE_RAW_H_
+#define _BERT_PRIVATE_RAW_H_
+
+#include <bert/types.h>
+
+#include <sys/types.h>
+
+/*
+ * Looks up the number of header bytes which follow the tag of a term.
+ * Returns BERT_ERRNO_INVALID for tags which cannot be kept encoded.
+ */
+int bert_raw_header(bert_magic_t tag,size_t *size);
+
+/*
+ * Reads the number of bytes and the number of nested terms which follow
+ * the header of a term.
+ */
+void bert_raw_contents(bert_magic_t tag,const unsigned char *header,size_t *bytes,size_t *terms);
+
+/*
+ * Measures the encoded term at the start of the given buffer, which
+ * starts with the tag of the term rather than the magic byte.
+ * Returns BERT_SUCCESS on success.
+ * Returns BERT_ERRNO_SHORT_READ if the term does not fit in the buffer.
+ * Returns BERT_ERRNO_INVALID if the term cannot be measured.
+ */
+int bert_raw_length(const unsigned char *buffer,size_t length,size_t *size);
+
+#endif
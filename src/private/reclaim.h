@@ -0,0 +1,14 @@
+#ifndef _BERT_PRIVATE_RECLAIM_H_
+#define _BERT_PRIVATE_RECLAIM_H_
+
+#include <bert/reclaim.h>
+#include <bert/data.h>
+
+/*
+ * Nanoseconds the reclaimer thread sleeps for when nothing is pending.
+ */
+#define BERT_RECLAIM_INTERVAL	1000000
+
+void bert_reclaim_push(bert_data_t *data);
+
+#endif
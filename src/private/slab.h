@@ -0,0 +1,28 @@
+#ifndef _BERT_PRIVATE_SLAB_H_
+#define _BERT_PRIVATE_SLAB_H_
+
+#include <bert/slab.h>
+#include <bert/alloc.h>
+
+#define BERT_SLAB_ALIGN		16
+#define BERT_SLAB_CLASSES	8
+#define BERT_SLAB_BATCH		64
+
+/*
+ * Index of the size class for objects of the given size.
+ */
+#define BERT_SLAB_CLASS(size)	(((size) + BERT_SLAB_ALIGN - 1) / BERT_SLAB_ALIGN - 1)
+
+/*
+ * Allocator recorded by objects allocated while the slab pools are
+ * enabled. Variable sized allocations made through it use malloc, while
+ * fixed sized objects are taken from the pools by bert_slab_alloc().
+ */
+extern const bert_allocator_t bert_slab_allocator;
+
+int bert_slab_enabled();
+
+void * bert_slab_alloc(size_t size);
+void bert_slab_free(void *ptr,size_t size);
+
+#endif
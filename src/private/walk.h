@@ -0,0 +1,28 @@
+#ifndef _BERT_PRIVATE_WALK_H_
+#define _BERT_PRIVATE_WALK_H_
+
+#include <bert/walk.h>
+
+/*
+ * Number of frames bert_data_walk keeps on the call stack, before moving
+ * its stack onto the heap.
+ */
+#define BERT_WALK_FRAMES	32
+
+#define BERT_PREFETCH(ptr)	__builtin_prefetch((ptr))
+
+#define BERT_WALK_CONTAINER(data)	((data)->type == bert_data_tuple || (data)->type == bert_data_list || (data)->type == bert_data_dict)
+
+struct bert_walk_frame
+{
+	const bert_data_t *data;
+
+	// index of the data within its parent
+	unsigned int position;
+
+	// index of the next element and the list or dict node holding it
+	unsigned int index;
+	const void *node;
+};
+
+#endif
@@ -11,8 +11,6 @@
 #include <stdio.h>
 #include <errno.h>
 
-int bert_print(const bert_data_t *data);
-
 void bert_print_string(const bert_data_t *data)
 {
 	size_t length = data->string.length;
@@ -63,97 +61,6 @@ void bert_print_binary(const bert_data_t *data)
 	printf(">>");
 }
 
-int bert_print_tuple(const bert_data_t *data)
-{
-	size_t length = data->tuple->length;
-	struct bert_data **elements = data->tuple->elements;
-
-	putchar('{');
-
-	if (length > 1)
-	{
-		unsigned int i;
-
-		for (i=0;i<length-1;i++)
-		{
-			if (bert_print(elements[i]) == -1)
-			{
-				return -1;
-			}
-
-			printf(", ");
-		}
-	}
-
-	if (length)
-	{
-		if (bert_print(elements[length - 1]) == -1)
-		{
-			return -1;
-		}
-	}
-
-	putchar('}');
-	return 0;
-}
-
-int bert_print_list(const bert_data_t *data)
-{
-	bert_list_node_t *list_node = data->list->head;
-
-	putchar('[');
-
-	while (list_node)
-	{
-		if (bert_print(list_node->data) == -1)
-		{
-			return -1;
-		}
-
-		if ((list_node = list_node->next))
-		{
-			printf(", ");
-		}
-	}
-
-	putchar(']');
-	return 0;
-}
-
-int bert_print_dict(const bert_data_t *data)
-{
-	bert_dict_node_t *dict_node = data->dict->head;
-
-	printf("{bert, dict, [");
-
-	while (dict_node)
-	{
-		putchar('{');
-
-		if (bert_print(dict_node->key) == -1)
-		{
-			return -1;
-		}
-
-		printf(", ");
-
-		if (bert_print(dict_node->value) == -1)
-		{
-			return -1;
-		}
-
-		putchar('}');
-
-		if ((dict_node = dict_node->next))
-		{
-			printf(", ");
-		}
-	}
-
-	printf("]}");
-	return 0;
-}
-
 void bert_print_time(const bert_data_t *data)
 {
 	printf("{bert, time, %u, %u, %u}",((unsigned int)data->time / 1000000),(unsigned int)data->time,0);
@@ -192,8 +99,21 @@ void bert_print_regex(const bert_data_t *data)
 	printf("]}");
 }
 
-int bert_print(const bert_data_t *data)
+int bert_print_pre(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
 {
+	if (parent)
+	{
+		if (parent->type == bert_data_dict && !(index & 0x01))
+		{
+			// each key and value pair is printed as a tuple
+			printf((index ? ", {" : "{"));
+		}
+		else if (index)
+		{
+			printf(", ");
+		}
+	}
+
 	switch (data->type)
 	{
 		case bert_data_nil:
@@ -226,14 +146,23 @@ int bert_print(const bert_data_t *data)
 			bert_print_string(data);
 			break;
 		case bert_data_tuple:
-			return bert_print_tuple(data);
+			putchar('{');
+			break;
 		case bert_data_list:
-			return bert_print_list(data);
+			putchar('[');
+			break;
 		case bert_data_bin:
 			bert_print_binary(data);
 			break;
+		case bert_data_file:
+			printf("<<%u bytes of fd %d>>",data->file.length,data->file.fd);
+			break;
+		case bert_data_raw:
+			printf("<<%u encoded bytes>>",(unsigned int)data->raw.length);
+			break;
 		case bert_data_dict:
-			return bert_print_dict(data);
+			printf("{bert, dict, [");
+			break;
 		case bert_data_time:
 			bert_print_time(data);
 			break;
@@ -245,6 +174,41 @@ int bert_print(const bert_data_t *data)
 			return -1;
 	}
 
+	return BERT_WALK_CONTINUE;
+}
+
+int bert_print_post(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	switch (data->type)
+	{
+		case bert_data_tuple:
+			putchar('}');
+			break;
+		case bert_data_list:
+			putchar(']');
+			break;
+		case bert_data_dict:
+			printf("]}");
+			break;
+		default:
+			break;
+	}
+
+	if (parent && parent->type == bert_data_dict && (index & 0x01))
+	{
+		putchar('}');
+	}
+
+	return BERT_WALK_CONTINUE;
+}
+
+int bert_print(const bert_data_t *data)
+{
+	if (bert_data_walk(data,bert_print_pre,bert_print_post,NULL) != BERT_SUCCESS)
+	{
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,117 @@
+#include <bert/reclaim.h>
+#include <bert/errno.h>
+#include "private/reclaim.h"
+#include "private/data.h"
+#include "private/atomic.h"
+
+#include <pthread.h>
+#include <time.h>
+
+/*
+ * Data released by bert_data_destroy_async, pushed without locking.
+ */
+static bert_data_t *bert_reclaim_queue = NULL;
+
+/*
+ * Data currently being torn down, protected by bert_reclaim_lock.
+ */
+static bert_data_t *bert_reclaim_stack = NULL;
+static pthread_mutex_t bert_reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The reclaimer thread, started and stopped under bert_reclaimer_lock.
+ */
+static pthread_t bert_reclaimer;
+static volatile int bert_reclaimer_running = 0;
+static pthread_mutex_t bert_reclaimer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void bert_reclaim_push(bert_data_t *data)
+{
+	bert_data_t *head;
+
+	do
+	{
+		head = bert_reclaim_queue;
+		data->pending.next = head;
+	} while (!BERT_ATOMIC_CAS(&bert_reclaim_queue,head,data));
+}
+
+size_t bert_reclaim(size_t budget)
+{
+	bert_data_t *queued;
+	bert_data_t *next;
+	size_t count;
+
+	pthread_mutex_lock(&bert_reclaim_lock);
+
+	// move everything queued so far onto the stack being torn down
+	queued = BERT_ATOMIC_SWAP(&bert_reclaim_queue,NULL);
+
+	while (queued)
+	{
+		next = queued->pending.next;
+
+		queued->pending.next = bert_reclaim_stack;
+		bert_reclaim_stack = queued;
+
+		queued = next;
+	}
+
+	count = bert_data_teardown(&bert_reclaim_stack,budget);
+
+	pthread_mutex_unlock(&bert_reclaim_lock);
+	return count;
+}
+
+static void * bert_reclaimer_main(void *arg)
+{
+	struct timespec interval = {0, BERT_RECLAIM_INTERVAL};
+
+	while (bert_reclaimer_running)
+	{
+		if (!bert_reclaim(BERT_RECLAIM_SLICE))
+		{
+			// nothing left to free
+			nanosleep(&interval,NULL);
+		}
+	}
+
+	return NULL;
+}
+
+int bert_reclaimer_start()
+{
+	int result = BERT_SUCCESS;
+
+	pthread_mutex_lock(&bert_reclaimer_lock);
+
+	if (!bert_reclaimer_running)
+	{
+		bert_reclaimer_running = 1;
+
+		if (pthread_create(&bert_reclaimer,NULL,bert_reclaimer_main,NULL))
+		{
+			bert_reclaimer_running = 0;
+			result = BERT_ERRNO_THREAD;
+		}
+	}
+
+	pthread_mutex_unlock(&bert_reclaimer_lock);
+	return result;
+}
+
+void bert_reclaimer_stop()
+{
+	// not bert_reclaim_lock, which the reclaimer takes while being joined
+	pthread_mutex_lock(&bert_reclaimer_lock);
+
+	if (bert_reclaimer_running)
+	{
+		bert_reclaimer_running = 0;
+		pthread_join(bert_reclaimer,NULL);
+	}
+
+	pthread_mutex_unlock(&bert_reclaimer_lock);
+
+	bert_reclaim(0);
+}
@@ -0,0 +1,262 @@
+#include <bert/config.h>
+#include <bert/slab.h>
+#include "private/slab.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+struct bert_slab_object
+{
+	struct bert_slab_object *next;
+};
+
+struct bert_slab_list
+{
+	struct bert_slab_object *head;
+	unsigned int count;
+};
+
+/*
+ * Objects cached by a single thread, which are allocated and freed
+ * without taking any locks.
+ */
+struct bert_slab_cache
+{
+	int registered;
+
+	struct bert_slab_list classes[BERT_SLAB_CLASSES];
+};
+
+/*
+ * Chunks are never returned to malloc, but are kept linked together so
+ * that they remain reachable.
+ */
+struct bert_slab_chunk
+{
+	struct bert_slab_chunk *next;
+} __attribute__((aligned(BERT_SLAB_ALIGN)));
+
+#if defined(BERT_SLAB)
+static int bert_slab_active = 1;
+#else
+static int bert_slab_active = 0;
+#endif
+
+static pthread_mutex_t bert_slab_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct bert_slab_list bert_slab_pool[BERT_SLAB_CLASSES];
+static struct bert_slab_chunk *bert_slab_chunks = NULL;
+
+static pthread_once_t bert_slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t bert_slab_key;
+
+static __thread struct bert_slab_cache bert_slab_cache;
+
+static void * bert_slab_malloc(size_t size,void *data)
+{
+	return malloc(size);
+}
+
+static void * bert_slab_realloc(void *ptr,size_t size,void *data)
+{
+	return realloc(ptr,size);
+}
+
+static void bert_slab_free_func(void *ptr,void *data)
+{
+	free(ptr);
+}
+
+const bert_allocator_t bert_slab_allocator = {
+	bert_slab_malloc,
+	bert_slab_realloc,
+	bert_slab_free_func,
+	NULL
+};
+
+void bert_slab_enable(int enabled)
+{
+	bert_slab_active = enabled;
+}
+
+int bert_slab_enabled()
+{
+	return bert_slab_active;
+}
+
+static struct bert_slab_object * bert_slab_split(struct bert_slab_list *list,unsigned int count)
+{
+	struct bert_slab_object *head = list->head;
+	struct bert_slab_object *tail = head;
+	unsigned int i;
+
+	for (i=1;i<count;i++)
+	{
+		tail = tail->next;
+	}
+
+	list->head = tail->next;
+	list->count -= count;
+
+	tail->next = NULL;
+	return head;
+}
+
+static void bert_slab_splice(struct bert_slab_list *list,struct bert_slab_object *head,unsigned int count)
+{
+	struct bert_slab_object *tail = head;
+
+	while (tail->next)
+	{
+		tail = tail->next;
+	}
+
+	tail->next = list->head;
+	list->head = head;
+	list->count += count;
+}
+
+static void bert_slab_release(void *ptr)
+{
+	struct bert_slab_cache *cache = ptr;
+	unsigned int i;
+
+	pthread_mutex_lock(&bert_slab_lock);
+
+	// hand the objects cached by the exiting thread back to the pool
+	for (i=0;i<BERT_SLAB_CLASSES;i++)
+	{
+		if (cache->classes[i].head)
+		{
+			bert_slab_splice(bert_slab_pool + i,cache->classes[i].head,cache->classes[i].count);
+
+			cache->classes[i].head = NULL;
+			cache->classes[i].count = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&bert_slab_lock);
+	cache->registered = 0;
+}
+
+static void bert_slab_init()
+{
+	pthread_key_create(&bert_slab_key,bert_slab_release);
+}
+
+static struct bert_slab_cache * bert_slab_thread_cache()
+{
+	struct bert_slab_cache *cache = &bert_slab_cache;
+
+	if (!cache->registered)
+	{
+		// release the cached objects when the thread exits
+		pthread_once(&bert_slab_once,bert_slab_init);
+		pthread_setspecific(bert_slab_key,cache);
+
+		cache->registered = 1;
+	}
+
+	return cache;
+}
+
+static int bert_slab_refill(struct bert_slab_list *list,unsigned int index)
+{
+	struct bert_slab_list *pool = bert_slab_pool + index;
+	size_t size = (index + 1) * BERT_SLAB_ALIGN;
+
+	pthread_mutex_lock(&bert_slab_lock);
+
+	if (pool->count)
+	{
+		unsigned int count = (pool->count < BERT_SLAB_BATCH ? pool->count : BERT_SLAB_BATCH);
+
+		bert_slab_splice(list,bert_slab_split(pool,count),count);
+		pthread_mutex_unlock(&bert_slab_lock);
+		return 1;
+	}
+
+	struct bert_slab_chunk *chunk;
+
+	if (!(chunk = malloc(sizeof(struct bert_slab_chunk) + (size * BERT_SLAB_BATCH))))
+	{
+		// malloc failed
+		pthread_mutex_unlock(&bert_slab_lock);
+		return 0;
+	}
+
+	chunk->next = bert_slab_chunks;
+	bert_slab_chunks = chunk;
+
+	pthread_mutex_unlock(&bert_slab_lock);
+
+	// carve the new chunk into objects
+	unsigned char *ptr = (unsigned char *)(chunk + 1);
+	unsigned int i;
+
+	for (i=0;i<BERT_SLAB_BATCH;i++)
+	{
+		struct bert_slab_object *object = (struct bert_slab_object *)(ptr + (i * size));
+
+		object->next = list->head;
+		list->head = object;
+	}
+
+	list->count += BERT_SLAB_BATCH;
+	return 1;
+}
+
+void * bert_slab_alloc(size_t size)
+{
+	unsigned int index = BERT_SLAB_CLASS(size);
+
+	if (index >= BERT_SLAB_CLASSES)
+	{
+		return malloc(size);
+	}
+
+	struct bert_slab_list *list = bert_slab_thread_cache()->classes + index;
+
+	if (!list->head && !bert_slab_refill(list,index))
+	{
+		// malloc failed
+		return NULL;
+	}
+
+	struct bert_slab_object *object = list->head;
+
+	list->head = object->next;
+	--list->count;
+	return object;
+}
+
+void bert_slab_free(void *ptr,size_t size)
+{
+	unsigned int index = BERT_SLAB_CLASS(size);
+
+	if (!ptr)
+	{
+		return;
+	}
+
+	if (index >= BERT_SLAB_CLASSES)
+	{
+		free(ptr);
+		return;
+	}
+
+	struct bert_slab_list *list = bert_slab_thread_cache()->classes + index;
+	struct bert_slab_object *object = ptr;
+
+	object->next = list->head;
+	list->head = object;
+
+	if (++list->count >= (BERT_SLAB_BATCH * 2))
+	{
+		// return a batch of objects to the pool for other threads
+		struct bert_slab_object *batch = bert_slab_split(list,BERT_SLAB_BATCH);
+
+		pthread_mutex_lock(&bert_slab_lock);
+		bert_slab_splice(bert_slab_pool + index,batch,BERT_SLAB_BATCH);
+		pthread_mutex_unlock(&bert_slab_lock);
+	}
+}
@@ -1,13 +1,14 @@
 #include <bert/tuple.h>
 #include <bert/data.h>
-
-#include <stdlib.h>
+#include "private/alloc.h"
+#include "private/cache.h"
 
 bert_tuple_t * bert_tuple_create(bert_tuple_size_t length)
 {
+	const bert_allocator_t *allocator = bert_allocator_current();
 	struct bert_data **new_elements;
 
-	if (!(new_elements = calloc(length,sizeof(struct bert_data_t *))))
+	if (!(new_elements = bert_calloc(allocator,length,sizeof(struct bert_data *))))
 	{
 		// malloc failed
 		goto cleanup;
@@ -15,7 +16,7 @@ bert_tuple_t * bert_tuple_create(bert_tuple_size_t length)
 
 	bert_tuple_t *new_tuple;
 
-	if (!(new_tuple = malloc(sizeof(bert_tuple_t))))
+	if (!(new_tuple = bert_object_alloc(allocator,sizeof(bert_tuple_t))))
 	{
 		// malloc failed
 		goto cleanup_elements;
@@ -23,10 +24,14 @@ bert_tuple_t * bert_tuple_create(bert_tuple_size_t length)
 
 	new_tuple->length = length;
 	new_tuple->elements = new_elements;
+	new_tuple->flags = 0;
+	new_tuple->allocator = allocator;
+	new_tuple->cache = NULL;
+	new_tuple->epoch = NULL;
 	return new_tuple;
 
 cleanup_elements:
-	free(new_elements);
+	bert_free(allocator,new_elements);
 cleanup:
 	// error
 	return NULL;
@@ -50,6 +55,13 @@ int bert_tuple_set(bert_tuple_t *tuple,unsigned int index,struct bert_data *data
 		return 0;
 	}
 
+	if (tuple->flags & BERT_DATA_FROZEN)
+	{
+		return 0;
+	}
+
+	bert_cache_invalidate(&(tuple->cache),tuple->epoch,tuple->allocator);
+
 	if (tuple->elements[index])
 	{
 		bert_data_destroy(tuple->elements[index]);
@@ -61,6 +73,11 @@ int bert_tuple_set(bert_tuple_t *tuple,unsigned int index,struct bert_data *data
 
 void bert_tuple_destroy(bert_tuple_t *tuple)
 {
+	if (!tuple)
+	{
+		return;
+	}
+
 	bert_tuple_size_t length = tuple->length;
 	unsigned int i;
 
@@ -69,6 +86,7 @@ void bert_tuple_destroy(bert_tuple_t *tuple)
 		bert_data_destroy(tuple->elements[i]);
 	}
 
-	free(tuple->elements);
-	free(tuple);
+	bert_cache_destroy(tuple->cache,tuple->epoch,tuple->allocator);
+	bert_free(tuple->allocator,tuple->elements);
+	bert_object_free(tuple->allocator,tuple,sizeof(bert_tuple_t));
 }
@@ -0,0 +1,196 @@
+#include <bert/walk.h>
+#include <bert/errno.h>
+#include "private/walk.h"
+#include "private/alloc.h"
+
+#include <string.h>
+
+static int bert_walk_next(struct bert_walk_frame *frame,const bert_data_t **child)
+{
+	const bert_data_t *data = frame->data;
+	const bert_list_node_t *list_node;
+	const bert_dict_node_t *dict_node;
+
+	switch (data->type)
+	{
+		case bert_data_tuple:
+			if (frame->index >= data->tuple->length)
+			{
+				return 0;
+			}
+
+			if ((frame->index + 1) < data->tuple->length)
+			{
+				BERT_PREFETCH(data->tuple->elements[frame->index + 1]);
+			}
+
+			*child = data->tuple->elements[frame->index];
+			break;
+		case bert_data_list:
+			if (!(list_node = frame->node))
+			{
+				return 0;
+			}
+
+			if (list_node->next)
+			{
+				BERT_PREFETCH(list_node->next);
+			}
+
+			*child = list_node->data;
+			frame->node = list_node->next;
+			break;
+		case bert_data_dict:
+			if (!(dict_node = frame->node))
+			{
+				return 0;
+			}
+
+			if (frame->index & 0x01)
+			{
+				*child = dict_node->value;
+				frame->node = dict_node->next;
+			}
+			else
+			{
+				if (dict_node->next)
+				{
+					BERT_PREFETCH(dict_node->next);
+				}
+
+				BERT_PREFETCH(dict_node->value);
+				*child = dict_node->key;
+			}
+			break;
+		default:
+			return 0;
+	}
+
+	++(frame->index);
+	return 1;
+}
+
+static struct bert_walk_frame * bert_walk_grow(const bert_allocator_t *allocator,struct bert_walk_frame *stack,struct bert_walk_frame *frames,size_t capacity)
+{
+	struct bert_walk_frame *new_stack;
+
+	if (stack == frames)
+	{
+		// move the stack onto the heap
+		if (!(new_stack = bert_malloc(allocator,sizeof(struct bert_walk_frame) * capacity * 2)))
+		{
+			return NULL;
+		}
+
+		memcpy(new_stack,frames,sizeof(struct bert_walk_frame) * capacity);
+		return new_stack;
+	}
+
+	return bert_realloc(allocator,stack,sizeof(struct bert_walk_frame) * capacity * 2);
+}
+
+int bert_data_walk(const bert_data_t *data,bert_walk_func pre,bert_walk_func post,void *user_data)
+{
+	const bert_allocator_t *allocator = bert_allocator_current();
+	struct bert_walk_frame frames[BERT_WALK_FRAMES];
+	struct bert_walk_frame *stack = frames;
+	struct bert_walk_frame *frame;
+	struct bert_walk_frame *new_stack;
+	size_t capacity = BERT_WALK_FRAMES;
+	size_t depth = 0;
+
+	const bert_data_t *parent = NULL;
+	unsigned int position = 0;
+	int result = BERT_SUCCESS;
+
+	while (1)
+	{
+		if (data)
+		{
+			if (pre && (result = pre(data,parent,position,user_data)) < 0)
+			{
+				goto cleanup;
+			}
+
+			if (result != BERT_WALK_SKIP)
+			{
+				if (BERT_WALK_CONTAINER(data))
+				{
+					if (depth == capacity)
+					{
+						if (!(new_stack = bert_walk_grow(allocator,stack,frames,capacity)))
+						{
+							// malloc failed
+							result = BERT_ERRNO_MALLOC;
+							goto cleanup;
+						}
+
+						stack = new_stack;
+						capacity *= 2;
+					}
+
+					frame = stack + depth++;
+					frame->data = data;
+					frame->position = position;
+					frame->index = 0;
+
+					switch (data->type)
+					{
+						case bert_data_list:
+							frame->node = data->list->head;
+							break;
+						case bert_data_dict:
+							frame->node = data->dict->head;
+							break;
+						default:
+							frame->node = NULL;
+							break;
+					}
+				}
+				else if (post && (result = post(data,parent,position,user_data)) < 0)
+				{
+					goto cleanup;
+				}
+			}
+		}
+
+		// find the next element, finishing off containers along the way
+		data = NULL;
+
+		while (depth)
+		{
+			frame = stack + (depth - 1);
+
+			if (bert_walk_next(frame,&data))
+			{
+				parent = frame->data;
+				position = frame->index - 1;
+				break;
+			}
+
+			--depth;
+
+			if (post && (result = post(frame->data,(depth ? stack[depth - 1].data : NULL),frame->position,user_data)) < 0)
+			{
+				goto cleanup;
+			}
+		}
+
+		if (!depth)
+		{
+			break;
+		}
+
+		result = BERT_WALK_CONTINUE;
+	}
+
+	result = BERT_SUCCESS;
+
+cleanup:
+	if (stack != frames)
+	{
+		bert_free(allocator,stack);
+	}
+
+	return result;
+}
@@ -19,6 +19,63 @@ void test_fail(const char *mesg,...)
 	exit(-1);
 }
 
+void test_check(int result)
+{
+	if (result != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+}
+
+static void * test_counting_malloc(size_t size,void *data)
+{
+	__sync_add_and_fetch(&(((struct test_counter *)data)->allocs),1);
+	return malloc(size);
+}
+
+static void * test_counting_realloc(void *ptr,size_t size,void *data)
+{
+	struct test_counter *counter = data;
+
+	if (ptr)
+	{
+		__sync_add_and_fetch(&(counter->reallocs),1);
+	}
+	else
+	{
+		__sync_add_and_fetch(&(counter->allocs),1);
+	}
+
+	return realloc(ptr,size);
+}
+
+static void test_counting_free(void *ptr,void *data)
+{
+	if (ptr)
+	{
+		__sync_add_and_fetch(&(((struct test_counter *)data)->frees),1);
+	}
+
+	free(ptr);
+}
+
+void test_counting_allocator(bert_allocator_t *allocator,struct test_counter *counter)
+{
+	counter->allocs = 0;
+	counter->reallocs = 0;
+	counter->frees = 0;
+
+	allocator->malloc = test_counting_malloc;
+	allocator->realloc = test_counting_realloc;
+	allocator->free = test_counting_free;
+	allocator->data = counter;
+}
+
+unsigned int test_outstanding(const struct test_counter *counter)
+{
+	return (*((volatile unsigned int *)&(counter->allocs)) - *((volatile unsigned int *)&(counter->frees)));
+}
+
 int test_open_file(const char *path)
 {
 	int fd;
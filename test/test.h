@@ -9,6 +9,7 @@
 #include <stdlib.h>
 
 void test_fail(const char *mesg,...);
+void test_check(int result);
 int test_open_file(const char *path);
 bert_decoder_t * test_decoder();
 
@@ -18,6 +19,21 @@ void test_encoder_push(bert_encoder_t *encoder,const bert_data_t *data);
 void test_bytes(const unsigned char *bytes,const unsigned char *expected,size_t expected_length);
 void test_strings(const char *string,const char *expected,size_t expected_length);
 
+/*
+ * Calls made to an allocator set up by test_counting_allocator(). New
+ * allocations, including realloc(NULL), are counted as allocs, and resizing
+ * an existing allocation as reallocs.
+ */
+struct test_counter
+{
+	unsigned int allocs;
+	unsigned int reallocs;
+	unsigned int frees;
+};
+
+void test_counting_allocator(bert_allocator_t *allocator,struct test_counter *counter);
+unsigned int test_outstanding(const struct test_counter *counter);
+
 #define TEST_COMPLEX_HEADER_SIZE	(1 + 1 + (1 + 2 + 4) + (1 + 2))
 
 const unsigned char * test_complex_header(const unsigned char *ptr,const char *name);
@@ -0,0 +1,113 @@
+#include <bert/alloc.h>
+#include <bert/data.h>
+#include <bert/decoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+
+#include <stdlib.h>
+
+#define EXPECTED_INT 42
+
+void test_global_allocator()
+{
+	struct test_counter counter;
+	bert_allocator_t allocator;
+	bert_data_t *list;
+	bert_data_t *data;
+
+	test_counting_allocator(&allocator,&counter);
+	bert_set_allocator(&allocator);
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (!(data = bert_data_create_string("hello")))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_set_allocator(NULL);
+
+	// appended nodes use the allocator the list was created with
+	if (bert_list_append(list->list,data) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+
+	if (counter.allocs != 5)
+	{
+		test_fail("the global allocator made %u allocations, expected %u",counter.allocs,5);
+	}
+
+	bert_data_destroy(list);
+
+	if (counter.frees != counter.allocs)
+	{
+		test_fail("the global allocator freed %u of %u allocations",counter.frees,counter.allocs);
+	}
+}
+
+void test_decoder_allocator()
+{
+	struct test_counter counter;
+	bert_allocator_t allocator;
+	const unsigned char buffer[] = {131, 97, EXPECTED_INT};
+	bert_decoder_t *decoder;
+	bert_data_t *data;
+
+	if (!(decoder = bert_decoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_counting_allocator(&allocator,&counter);
+	bert_decoder_allocator(decoder,&allocator);
+	bert_decoder_buffer(decoder,buffer,sizeof(buffer));
+
+	if (bert_decoder_pull(decoder,&data) != 1)
+	{
+		test_fail("bert_decoder_pull failed");
+	}
+
+	if (data->type != bert_data_int || data->integer != EXPECTED_INT)
+	{
+		test_fail("bert_decoder_pull did not decode %d",EXPECTED_INT);
+	}
+
+	if (counter.allocs != 1)
+	{
+		test_fail("the decoder allocator made %u allocations, expected %u",counter.allocs,1);
+	}
+
+	bert_decoder_destroy(decoder);
+	bert_data_destroy(data);
+
+	if (counter.frees != 1)
+	{
+		test_fail("the decoder allocator freed %u allocations, expected %u",counter.frees,1);
+	}
+
+	// allocations outside of the decoder use the global allocator
+	if (!(data = bert_data_create_int(EXPECTED_INT)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_data_destroy(data);
+
+	if (counter.allocs != 1)
+	{
+		test_fail("the decoder allocator leaked outside of bert_decoder_pull");
+	}
+}
+
+int main()
+{
+	test_global_allocator();
+	test_decoder_allocator();
+
+	return 0;
+}
@@ -0,0 +1,206 @@
+#include <bert/encoder.h>
+#include <bert/decoder.h>
+#include <bert/magic.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define ATOMS		300
+#define LONG_ATOM	300
+
+void test_append(bert_data_t *list,bert_data_t *data)
+{
+	if (!data || bert_list_append(list->list,data) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+}
+
+// {reply, [foo, bar, foo], true, aaa...}
+bert_data_t * test_message()
+{
+	bert_data_t *tuple;
+	bert_data_t *list;
+	char long_name[LONG_ATOM + 1];
+
+	memset(long_name,'a',LONG_ATOM);
+	long_name[LONG_ATOM] = '\0';
+
+	if (!(tuple = bert_data_create_tuple(4)) || !(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_append(list,bert_data_create_atom("foo"));
+	test_append(list,bert_data_create_atom("bar"));
+	test_append(list,bert_data_create_atom("foo"));
+
+	tuple->tuple->elements[0] = bert_data_create_atom("reply");
+	tuple->tuple->elements[1] = list;
+	tuple->tuple->elements[2] = bert_data_create_true();
+	tuple->tuple->elements[3] = bert_data_create_atom(long_name);
+	return tuple;
+}
+
+// [atom_0, atom_1, ..., atom_0, atom_1, ...]
+bert_data_t * test_atoms()
+{
+	bert_data_t *list;
+	char name[16];
+	unsigned int i;
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<(ATOMS * 2);i++)
+	{
+		snprintf(name,sizeof(name),"atom_%u",i % ATOMS);
+		test_append(list,bert_data_create_atom(name));
+	}
+
+	return list;
+}
+
+/*
+ * Decodes the next message and compares it against the plain encoding of
+ * the expected data.
+ */
+void test_decoded(bert_decoder_t *decoder,const bert_data_t *expected)
+{
+	bert_data_t *decoded;
+	unsigned char *decoded_bytes;
+	unsigned char *expected_bytes;
+	size_t decoded_length;
+	size_t expected_length;
+	int result;
+
+	if ((result = bert_decoder_pull(decoder,&decoded)) != 1)
+	{
+		test_fail("bert_decoder_pull failed: %s",bert_strerror(result));
+	}
+
+	test_check(bert_encode_alloc(decoded,&decoded_bytes,&decoded_length));
+	test_check(bert_encode_alloc(expected,&expected_bytes,&expected_length));
+
+	if (decoded_length != expected_length)
+	{
+		test_fail("the decoded message encoded to %u bytes, expected %u",(unsigned int)decoded_length,(unsigned int)expected_length);
+	}
+
+	test_bytes(decoded_bytes,expected_bytes,expected_length);
+
+	free(decoded_bytes);
+	free(expected_bytes);
+	bert_data_destroy(decoded);
+}
+
+void test_cached()
+{
+	bert_encoder_t *encoder;
+	bert_decoder_t *decoder;
+	bert_data_t *message = test_message();
+	bert_data_t *atoms = test_atoms();
+	unsigned char *output;
+	size_t output_length;
+	size_t first;
+	size_t second;
+	bert_data_t *data;
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_dynamic(encoder);
+	test_check(bert_encoder_atom_cache(encoder,1));
+
+	test_check(bert_encoder_push(encoder,message));
+	first = bert_encoder_total(encoder);
+
+	test_check(bert_encoder_push(encoder,message));
+	second = bert_encoder_total(encoder) - first;
+
+	if (second >= first)
+	{
+		test_fail("the second message took %u bytes, expected less than %u",(unsigned int)second,(unsigned int)first);
+	}
+
+	// more atoms than fit in a single header
+	test_check(bert_encoder_push(encoder,atoms));
+	test_check(bert_encoder_push(encoder,atoms));
+	test_check(bert_encoder_push(encoder,message));
+
+	test_check(bert_encoder_take_buffer(encoder,&output,&output_length));
+
+	if (output[0] != BERT_MAGIC || output[1] != BERT_DIST_HEADER)
+	{
+		test_fail("the message did not start with a distribution header");
+	}
+
+	if (output[first] != BERT_MAGIC || output[first + 1] != BERT_DIST_HEADER)
+	{
+		test_fail("the second message did not start with a distribution header");
+	}
+
+	if (!(decoder = bert_decoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_decoder_buffer(decoder,output,output_length);
+
+	if (bert_decoder_pull(decoder,&data) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_decoder_pull accepted a distribution header without an atom cache");
+	}
+
+	bert_decoder_destroy(decoder);
+
+	if (!(decoder = bert_decoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_decoder_buffer(decoder,output,output_length);
+	test_check(bert_decoder_atom_cache(decoder,1));
+
+	test_decoded(decoder,message);
+	test_decoded(decoder,message);
+	test_decoded(decoder,atoms);
+	test_decoded(decoder,atoms);
+	test_decoded(decoder,message);
+
+	free(output);
+	bert_data_destroy(message);
+	bert_data_destroy(atoms);
+	bert_decoder_destroy(decoder);
+	bert_encoder_destroy(encoder);
+}
+
+void test_undefined()
+{
+	const unsigned char output[] = {BERT_MAGIC, BERT_ATOM_CACHE_REF, 0};
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+
+	test_check(bert_decoder_atom_cache(decoder,1));
+	bert_decoder_buffer(decoder,output,sizeof(output));
+
+	if (bert_decoder_pull(decoder,&data) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_decoder_pull accepted an undefined atom cache reference");
+	}
+
+	bert_decoder_destroy(decoder);
+}
+
+int main()
+{
+	test_cached();
+	test_undefined();
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+#include <bert/decoder.h>
+#include <bert/magic.h>
+#include <bert/util.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define BIN_LENGTH	1000
+#define FRAME_LENGTH	(1 + 1 + 4 + BIN_LENGTH + 1 + 1)
+
+unsigned char frame[FRAME_LENGTH];
+unsigned int frees = 0;
+
+void test_free(unsigned char *data,void *user_data)
+{
+	if (data != frame)
+	{
+		test_fail("bert_bin_buffer_unref freed the wrong data");
+	}
+
+	++frees;
+}
+
+void test_sub_bin()
+{
+	unsigned char bytes[] = "hello world";
+	bert_data_t *parent;
+
+	if (!(parent = bert_data_create_bin(bytes,11)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_data_t *sub;
+
+	if (!(sub = bert_data_create_sub_bin(parent,6,5)))
+	{
+		test_fail("bert_data_create_sub_bin failed");
+	}
+
+	if (sub->bin.data != (parent->bin.data + 6))
+	{
+		test_fail("bert_data_create_sub_bin copied the binary data");
+	}
+
+	if (bert_data_create_sub_bin(parent,6,6))
+	{
+		test_fail("bert_data_create_sub_bin did not reject an out of bounds slice");
+	}
+
+	bert_data_destroy(parent);
+
+	if (!bert_data_strequal(sub,"world"))
+	{
+		test_fail("sub-binary did not outlive its parent");
+	}
+
+	bert_data_destroy(sub);
+}
+
+void test_decode()
+{
+	bert_bin_buffer_t *buffer;
+
+	frame[0] = BERT_MAGIC;
+	frame[1] = BERT_BIN;
+	bert_write_uint32(frame+2,BIN_LENGTH);
+	memset(frame+6,'A',BIN_LENGTH);
+	frame[6+BIN_LENGTH] = BERT_SMALL_INT;
+	frame[7+BIN_LENGTH] = 42;
+
+	if (!(buffer = bert_bin_buffer_create(frame,FRAME_LENGTH,test_free,NULL)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_decoder_t *decoder = test_decoder();
+
+	bert_decoder_shared_buffer(decoder,buffer);
+	bert_bin_buffer_unref(buffer);
+
+	bert_data_t *bin;
+	bert_data_t *integer;
+	int result;
+
+	if ((result = bert_decoder_pull(decoder,&bin)) != 1)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (bin->type != bert_data_bin || bin->bin.length != BIN_LENGTH)
+	{
+		test_fail("bert_decoder_pull did not decode the shared binary");
+	}
+
+	if (bin->bin.data != (frame + 6))
+	{
+		test_fail("bert_decoder_pull did not reference the shared buffer");
+	}
+
+	if ((result = bert_decoder_pull(decoder,&integer)) != 1)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (integer->type != bert_data_int || integer->integer != 42)
+	{
+		test_fail("bert_decoder_pull did not resume after the shared binary");
+	}
+
+	bert_data_destroy(integer);
+	bert_decoder_destroy(decoder);
+
+	if (frees)
+	{
+		test_fail("shared buffer was freed while still referenced");
+	}
+
+	bert_data_destroy(bin);
+
+	if (frees != 1)
+	{
+		test_fail("shared buffer was freed %u times, expected %u",frees,1);
+	}
+}
+
+int main()
+{
+	test_sub_bin();
+	test_decode();
+	return 0;
+}
@@ -0,0 +1,166 @@
+#include <bert/encoder.h>
+#include <bert/decoder.h>
+#include <bert/magic.h>
+#include <bert/util.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define ROWS		2000
+#define THRESHOLD	256
+#define OUTPUT_SIZE	(1024 * 64)
+
+unsigned char output[OUTPUT_SIZE];
+size_t output_index = 0;
+size_t output_length = 0;
+
+ssize_t test_callback(unsigned char *data,size_t length,void *user_data)
+{
+	// hand the compressed data over a few bytes at a time
+	length = MIN(length,MIN(7,output_length - output_index));
+
+	memcpy(data,output + output_index,length);
+	output_index += length;
+	return length;
+}
+
+bert_data_t * test_data(unsigned int rows)
+{
+	bert_data_t *list;
+	bert_data_t *tuple;
+	unsigned int i;
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<rows;i++)
+	{
+		if (!(tuple = bert_data_create_tuple(2)))
+		{
+			test_fail("malloc failed");
+		}
+
+		tuple->tuple->elements[0] = bert_data_create_atom("row");
+		tuple->tuple->elements[1] = bert_data_create_int(i % 100);
+
+		if (bert_list_append(list->list,tuple) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+	}
+
+	return list;
+}
+
+void test_pull(bert_decoder_t *decoder,const bert_data_t *expected)
+{
+	unsigned char *expected_bytes;
+	unsigned char *bytes;
+	size_t expected_length;
+	size_t length;
+	bert_data_t *data;
+	int result;
+
+	if ((result = bert_decoder_pull(decoder,&data)) != 1)
+	{
+		test_fail("bert_decoder_pull failed: %s",bert_strerror(result));
+	}
+
+	if (bert_encode_alloc(expected,&expected_bytes,&expected_length) != BERT_SUCCESS || bert_encode_alloc(data,&bytes,&length) != BERT_SUCCESS)
+	{
+		test_fail("bert_encode_alloc failed");
+	}
+
+	if (length != expected_length)
+	{
+		test_fail("bert_decoder_pull decoded a term of %u bytes, expected %u",(unsigned int)length,(unsigned int)expected_length);
+	}
+
+	test_bytes(bytes,expected_bytes,expected_length);
+
+	free(bytes);
+	free(expected_bytes);
+	bert_data_destroy(data);
+}
+
+int main()
+{
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+	bert_decoder_t *decoder;
+	bert_data_t *large = test_data(ROWS);
+	bert_data_t *small = test_data(2);
+
+	if (bert_encoder_compress(encoder,THRESHOLD,10) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_encoder_compress accepted an invalid level");
+	}
+
+	if (bert_encoder_compress(encoder,THRESHOLD,6) != BERT_SUCCESS)
+	{
+		test_fail("bert_encoder_compress failed");
+	}
+
+	// a compressed term, followed by one below the threshold
+	test_encoder_push(encoder,large);
+	test_encoder_push(encoder,small);
+
+	output_length = bert_encoder_total(encoder);
+
+	if (output[1] != BERT_COMPRESSED)
+	{
+		test_fail("bert_encoder_push did not add the COMPRESSED magic byte");
+	}
+
+	if (bert_read_uint32(output+2) != bert_data_sizeof(large))
+	{
+		test_fail("bert_encoder_push encoded %u as the uncompressed size, expected %u",bert_read_uint32(output+2),(unsigned int)bert_data_sizeof(large));
+	}
+
+	if (output_length >= (bert_data_sizeof(large) / 4))
+	{
+		test_fail("bert_encoder_push only compressed the term to %u bytes",(unsigned int)output_length);
+	}
+
+	if (output[output_length - bert_data_sizeof(small)] != BERT_LIST)
+	{
+		test_fail("bert_encoder_push compressed a term below the threshold");
+	}
+
+	if (!(decoder = bert_decoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_decoder_buffer(decoder,output,output_length);
+	test_pull(decoder,large);
+	test_pull(decoder,small);
+
+	if (bert_decoder_total(decoder) != output_length)
+	{
+		test_fail("bert_decoder_total returned %u, expected %u",(unsigned int)bert_decoder_total(decoder),(unsigned int)output_length);
+	}
+
+	// inflate while the compressed bytes trickle in
+	bert_decoder_callback(decoder,test_callback,NULL);
+	test_pull(decoder,large);
+	test_pull(decoder,small);
+
+	// cut the compressed term short
+	bert_data_t *data;
+
+	bert_decoder_buffer(decoder,output,output_length / 2);
+
+	if (bert_decoder_pull(decoder,&data) != BERT_ERRNO_SHORT_READ)
+	{
+		test_fail("bert_decoder_pull did not reject a truncated compressed term");
+	}
+
+	bert_decoder_destroy(decoder);
+	bert_encoder_destroy(encoder);
+	bert_data_destroy(small);
+	bert_data_destroy(large);
+	return 0;
+}
@@ -0,0 +1,186 @@
+#include <bert/cache.h>
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define LENGTH		100
+#define OUTPUT_SIZE	4096
+
+// magic byte + tuple header + atom + list header + small int magic byte
+#define FIRST_INT	(1 + 2 + (1 + 2 + 6) + (1 + 4) + 1)
+
+unsigned char expected[OUTPUT_SIZE];
+unsigned char output[OUTPUT_SIZE];
+
+size_t test_push(const bert_data_t *data,unsigned char *buffer)
+{
+	bert_encoder_t *encoder = test_encoder(buffer,OUTPUT_SIZE);
+
+	test_encoder_push(encoder,data);
+
+	size_t length = bert_encoder_total(encoder);
+
+	bert_encoder_destroy(encoder);
+	return length;
+}
+
+void test_cache(bert_data_t *data)
+{
+	int result;
+
+	if ((result = bert_data_cache(data)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+}
+
+bert_data_t * test_pair(bert_data_t *first,bert_data_t *second)
+{
+	bert_data_t *pair;
+
+	if (!first || !second || !(pair = bert_data_create_tuple(2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	pair->tuple->elements[0] = first;
+	pair->tuple->elements[1] = second;
+	return pair;
+}
+
+void test_isolated()
+{
+	bert_data_t *shared = test_pair(bert_data_create_int(1),bert_data_create_int(2));
+	bert_data_t *first = test_pair(bert_data_create_int(3),bert_data_ref(shared));
+	bert_data_t *second = test_pair(bert_data_create_int(4),bert_data_ref(shared));
+	bert_data_t *other = test_pair(bert_data_create_int(5),bert_data_create_int(6));
+	size_t length;
+
+	test_cache(first);
+	test_cache(second);
+	test_cache(other);
+
+	// modifying a container only invalidates the caches covering it
+	other->tuple->elements[0]->integer = 7;
+	test_check(bert_data_tuple_set(&first,0,bert_data_create_int(8)));
+
+	length = test_push(other,output);
+
+	if (output[length - 3] != 5)
+	{
+		test_fail("modifying unrelated data invalidated the cache");
+	}
+
+	first->tuple->elements[1]->tuple->elements[0]->integer = 9;
+
+	if (!bert_tuple_set(shared->tuple,1,bert_data_create_int(10)))
+	{
+		test_fail("bert_tuple_set failed");
+	}
+
+	length = test_push(first,output);
+
+	if (output[length - 3] != 9 || output[length - 1] != 10)
+	{
+		test_fail("modifying shared data did not invalidate the first cache");
+	}
+
+	length = test_push(second,output);
+
+	if (output[length - 3] != 9 || output[length - 1] != 10)
+	{
+		test_fail("modifying shared data did not invalidate the second cache");
+	}
+
+	bert_data_destroy(shared);
+	bert_data_destroy(first);
+	bert_data_destroy(second);
+	bert_data_destroy(other);
+}
+
+int main()
+{
+	bert_data_t *data;
+	bert_data_t *list;
+	bert_data_t *element;
+	unsigned int i;
+
+	if (!(data = bert_data_create_tuple(2)) || !(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	data->tuple->elements[0] = bert_data_create_atom("config");
+	data->tuple->elements[1] = list;
+
+	for (i=0;i<LENGTH;i++)
+	{
+		if (!(element = bert_data_create_int(i)) || bert_list_append(list->list,element) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+	}
+
+	size_t length = test_push(data,expected);
+
+	test_cache(data);
+
+	// changes made behind the back of the cache are not encoded
+	element = bert_list_get(list->list,0);
+	element->integer = 42;
+
+	if (test_push(data,output) != length)
+	{
+		test_fail("bert_encoder_push did not write the cached bytes");
+	}
+
+	test_bytes(output,expected,length);
+
+	// appending to the nested list invalidates the outer cache
+	if (!(element = bert_data_create_int(LENGTH)) || bert_list_append(list->list,element) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+
+	length = test_push(data,output);
+
+	if (length != (bert_data_sizeof(data) + 1))
+	{
+		test_fail("bert_encoder_push wrote %u bytes after bert_list_append, expected %u",(unsigned int)length,(unsigned int)(bert_data_sizeof(data) + 1));
+	}
+
+	if (output[FIRST_INT] != 42)
+	{
+		test_fail("bert_encoder_push wrote a stale cache");
+	}
+
+	// cached subterms are used when encoding their parent
+	memcpy(expected,output,length);
+	test_cache(list);
+
+	element = bert_list_get(list->list,1);
+	element->integer = 69;
+
+	test_push(data,output);
+	test_bytes(output,expected,length);
+
+	bert_data_uncache(list);
+	test_push(data,output);
+
+	if (output[FIRST_INT + 2] != 69)
+	{
+		test_fail("bert_data_uncache did not drop the cache");
+	}
+
+	if (bert_data_cache(element) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_data_cache cached an integer");
+	}
+
+	bert_data_destroy(data);
+
+	test_isolated();
+	return 0;
+}
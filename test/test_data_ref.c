@@ -0,0 +1,165 @@
+#include <bert/data.h>
+#include <bert/errno.h>
+
+#include "test.h"
+
+#define EXPECTED_BEFORE 42
+#define EXPECTED_AFTER 69
+
+bert_data_t *tuple;
+
+void test_ref()
+{
+	bert_data_t *element = tuple->tuple->elements[0];
+
+	if (bert_data_ref(element) != element)
+	{
+		test_fail("bert_data_ref did not return the given data");
+	}
+
+	if (element->refs != 2)
+	{
+		test_fail("bert_data_ref set the reference count to %u, expected %u",element->refs,2);
+	}
+
+	bert_data_unref(element);
+
+	if (element->refs != 1)
+	{
+		test_fail("bert_data_unref set the reference count to %u, expected %u",element->refs,1);
+	}
+}
+
+void test_freeze()
+{
+	bert_data_t *data;
+
+	if (!(data = bert_data_create_int(EXPECTED_AFTER)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_data_freeze(tuple);
+
+	if (!(tuple->tuple->elements[1]->list->flags & BERT_DATA_FROZEN))
+	{
+		test_fail("bert_data_freeze did not freeze the nested list");
+	}
+
+	if (bert_tuple_set(tuple->tuple,0,data))
+	{
+		test_fail("bert_tuple_set modified a frozen tuple");
+	}
+
+	if (bert_list_append(tuple->tuple->elements[1]->list,data) != BERT_ERRNO_FROZEN)
+	{
+		test_fail("bert_list_append did not return BERT_ERRNO_FROZEN for a frozen list");
+	}
+
+	bert_data_destroy(data);
+}
+
+void test_tuple_set()
+{
+	bert_data_t *copy = bert_data_ref(tuple);
+	bert_data_t *data;
+	int result;
+
+	if (!(data = bert_data_create_int(EXPECTED_AFTER)))
+	{
+		test_fail("malloc failed");
+	}
+
+	if ((result = bert_data_tuple_set(&copy,0,data)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (copy == tuple)
+	{
+		test_fail("bert_data_tuple_set did not copy the frozen tuple");
+	}
+
+	if (tuple->tuple->elements[0]->integer != EXPECTED_BEFORE)
+	{
+		test_fail("bert_data_tuple_set modified the original tuple");
+	}
+
+	if (copy->tuple->elements[0]->integer != EXPECTED_AFTER)
+	{
+		test_fail("bert_data_tuple_set set %d as the first element, expected %d",copy->tuple->elements[0]->integer,EXPECTED_AFTER);
+	}
+
+	if (copy->tuple->elements[1] != tuple->tuple->elements[1])
+	{
+		test_fail("bert_data_tuple_set did not share the remaining elements");
+	}
+
+	bert_data_t *list = bert_data_ref(copy->tuple->elements[1]);
+
+	if (!(data = bert_data_create_int(EXPECTED_AFTER)))
+	{
+		test_fail("malloc failed");
+	}
+
+	if ((result = bert_data_list_set(&list,0,data)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (bert_list_get(list->list,0)->integer != EXPECTED_AFTER)
+	{
+		test_fail("bert_data_list_set did not set the first element");
+	}
+
+	if (bert_list_get(tuple->tuple->elements[1]->list,0)->integer != EXPECTED_BEFORE)
+	{
+		test_fail("bert_data_list_set modified the original list");
+	}
+
+	bert_data_unref(list);
+	bert_data_unref(copy);
+
+	if (tuple->tuple->elements[1]->refs != 1)
+	{
+		test_fail("bert_data_unref did not release the shared list");
+	}
+}
+
+int main()
+{
+	bert_data_t *data;
+
+	if (!(tuple = bert_data_create_tuple(2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (!(data = bert_data_create_int(EXPECTED_BEFORE)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_tuple_set(tuple->tuple,0,data);
+
+	if (!(data = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_tuple_set(tuple->tuple,1,data);
+
+	if (!(data = bert_data_create_int(EXPECTED_BEFORE)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_list_append(tuple->tuple->elements[1]->list,data);
+
+	test_ref();
+	test_freeze();
+	test_tuple_set();
+
+	bert_data_destroy(tuple);
+	return 0;
+}
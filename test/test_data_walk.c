@@ -0,0 +1,175 @@
+#include <bert/data.h>
+#include <bert/walk.h>
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+
+#include <stdlib.h>
+
+#define DEPTH 100000
+
+unsigned int pre_calls = 0;
+unsigned int post_calls = 0;
+
+int test_pre(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	++pre_calls;
+
+	if (data == user_data)
+	{
+		return BERT_WALK_SKIP;
+	}
+
+	if (parent && parent->type == bert_data_dict && data->type != (index & 0x01 ? bert_data_int : bert_data_atom))
+	{
+		test_fail("bert_data_walk did not alternate between dict keys and values");
+	}
+
+	return BERT_WALK_CONTINUE;
+}
+
+int test_post(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	++post_calls;
+	return BERT_WALK_CONTINUE;
+}
+
+int test_abort(const bert_data_t *data,const bert_data_t *parent,unsigned int index,void *user_data)
+{
+	return (data->type == bert_data_int ? BERT_ERRNO_INVALID : BERT_WALK_CONTINUE);
+}
+
+void test_walk()
+{
+	bert_data_t *tuple;
+	bert_data_t *dict;
+	bert_data_t *list;
+
+	if (!(tuple = bert_data_create_tuple(3)) || !(dict = bert_data_create_dict()) || !(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	tuple->tuple->elements[0] = dict;
+	tuple->tuple->elements[1] = list;
+
+	if (bert_dict_append(dict->dict,bert_data_create_atom("one"),bert_data_create_int(1)) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+
+	if (bert_dict_append(dict->dict,bert_data_create_atom("two"),bert_data_create_int(2)) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+
+	if (bert_list_append(list->list,bert_data_create_int(3)) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+
+	// the NULL third element is not visited, and the list is skipped
+	if (bert_data_walk(tuple,test_pre,test_post,list) != BERT_SUCCESS)
+	{
+		test_fail("bert_data_walk failed");
+	}
+
+	if (pre_calls != 7)
+	{
+		test_fail("bert_data_walk called the pre callback %u times, expected %u",pre_calls,7);
+	}
+
+	if (post_calls != 6)
+	{
+		test_fail("bert_data_walk called the post callback %u times, expected %u",post_calls,6);
+	}
+
+	if (bert_data_walk(tuple,test_abort,NULL,NULL) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_data_walk did not stop when a callback failed");
+	}
+
+	bert_data_destroy(tuple);
+}
+
+void test_deep()
+{
+	bert_data_t *root = NULL;
+	bert_data_t *list;
+	bert_data_t *innermost;
+	unsigned int i;
+
+	for (i=0;i<DEPTH;i++)
+	{
+		if (!(list = bert_data_create_list()))
+		{
+			test_fail("malloc failed");
+		}
+
+		if (root && bert_list_append(list->list,root) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+
+		root = list;
+	}
+
+	innermost = root;
+
+	while (innermost->list->head)
+	{
+		innermost = innermost->list->head->data;
+	}
+
+	// magic byte + list length + NIL tail for every list
+	size_t expected = DEPTH * (1 + 4 + 1);
+	size_t size = bert_data_sizeof(root);
+
+	if (size != expected)
+	{
+		test_fail("bert_data_sizeof returned %u, expected %u",size,expected);
+	}
+
+	unsigned char *buffer;
+	bert_encoder_t *encoder;
+
+	if (!(buffer = malloc(expected + 1)) || !(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_buffer(encoder,buffer,expected + 1);
+
+	if (bert_encoder_push(encoder,root) != BERT_SUCCESS)
+	{
+		test_fail("bert_encoder_push failed on deeply nested data");
+	}
+
+	if (bert_encoder_total(encoder) != expected + 1)
+	{
+		test_fail("bert_encoder_push wrote %u bytes, expected %u",bert_encoder_total(encoder),expected + 1);
+	}
+
+	if (bert_data_freeze(root) != BERT_SUCCESS)
+	{
+		test_fail("bert_data_freeze failed on deeply nested data");
+	}
+
+	if (!(innermost->flags & BERT_DATA_FROZEN) || !(innermost->list->flags & BERT_DATA_FROZEN))
+	{
+		test_fail("bert_data_freeze did not freeze the innermost list");
+	}
+
+	bert_encoder_destroy(encoder);
+	free(buffer);
+	bert_data_destroy(root);
+}
+
+int main()
+{
+	test_walk();
+	test_deep();
+
+	return 0;
+}
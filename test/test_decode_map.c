@@ -0,0 +1,88 @@
+#include <bert/decoder.h>
+#include <bert/magic.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+// #{1 => 2, foo => [3]}
+const unsigned char map[] = {
+	BERT_MAGIC, BERT_MAP, 0, 0, 0, 2,
+	BERT_SMALL_INT, 1, BERT_SMALL_INT, 2,
+	BERT_SMALL_ATOM_UTF8, 3, 'f', 'o', 'o', BERT_LIST, 0, 0, 0, 1, BERT_SMALL_INT, 3, BERT_NIL
+};
+
+void test_read()
+{
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+	int result;
+
+	bert_decoder_buffer(decoder,map,sizeof(map));
+
+	if ((result = bert_decoder_pull(decoder,&data)) != 1)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (data->type != bert_data_dict)
+	{
+		test_fail("bert_decoder_pull did not decode a dict");
+	}
+
+	if (bert_dict_length(data->dict) != 2)
+	{
+		test_fail("bert_decoder_pull decoded %u key->value pairs, expected %u",(unsigned int)bert_dict_length(data->dict),2);
+	}
+
+	bert_dict_node_t *next_node = data->dict->head;
+
+	if (next_node->key->type != bert_data_int || next_node->key->integer != 1)
+	{
+		test_fail("bert_decoder_pull did not decode 1 as the first key");
+	}
+
+	if (next_node->value->type != bert_data_int || next_node->value->integer != 2)
+	{
+		test_fail("bert_decoder_pull did not decode 2 as the first value");
+	}
+
+	next_node = next_node->next;
+
+	if (next_node->key->type != bert_data_atom || !bert_data_strequal(next_node->key,"foo"))
+	{
+		test_fail("bert_decoder_pull did not decode foo as the second key");
+	}
+
+	if (next_node->value->type != bert_data_list || bert_list_length(next_node->value->list) != 1)
+	{
+		test_fail("bert_decoder_pull did not decode [3] as the second value");
+	}
+
+	bert_data_destroy(data);
+	bert_decoder_destroy(decoder);
+}
+
+void test_truncated()
+{
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+	int result;
+
+	bert_decoder_buffer(decoder,map,sizeof(map) - 1);
+
+	if ((result = bert_decoder_pull(decoder,&data)) != BERT_ERRNO_SHORT_READ)
+	{
+		test_fail("bert_decoder_pull returned %d for a truncated map, expected %d",result,BERT_ERRNO_SHORT_READ);
+	}
+
+	bert_decoder_destroy(decoder);
+}
+
+int main()
+{
+	test_read();
+	test_truncated();
+
+	return 0;
+}
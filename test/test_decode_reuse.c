@@ -0,0 +1,177 @@
+#include <bert/decoder.h>
+#include <bert/alloc.h>
+#include <bert/errno.h>
+
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// {telemetry, <<"host">>, 42, [1,2,3]}
+const unsigned char first[] = {
+	131, 104, 4,
+	100, 0, 9, 't', 'e', 'l', 'e', 'm', 'e', 't', 'r', 'y',
+	109, 0, 0, 0, 4, 'h', 'o', 's', 't',
+	97, 42,
+	108, 0, 0, 0, 3, 97, 1, 97, 2, 97, 3, 106
+};
+
+// {telemetry, <<"db">>, 69, [4,5,6]}
+const unsigned char second[] = {
+	131, 104, 4,
+	100, 0, 9, 't', 'e', 'l', 'e', 'm', 'e', 't', 'r', 'y',
+	109, 0, 0, 0, 2, 'd', 'b',
+	97, 69,
+	108, 0, 0, 0, 3, 97, 4, 97, 5, 97, 6, 106
+};
+
+// {telemetry, 7, [8]}
+const unsigned char third[] = {
+	131, 104, 3,
+	100, 0, 9, 't', 'e', 'l', 'e', 'm', 'e', 't', 'r', 'y',
+	97, 7,
+	108, 0, 0, 0, 1, 97, 8, 106
+};
+
+struct test_counter counter;
+bert_allocator_t allocator;
+
+bert_data_t * test_pull(bert_decoder_t *decoder,const unsigned char *buffer,size_t length,bert_data_t *data)
+{
+	int result;
+
+	bert_decoder_buffer(decoder,buffer,length);
+
+	if ((result = bert_decoder_pull_into(decoder,&data)) != 1)
+	{
+		test_fail("bert_decoder_pull_into failed: %s",bert_strerror(result));
+	}
+
+	if (data->type != bert_data_tuple)
+	{
+		test_fail("bert_decoder_pull_into did not decode a tuple");
+	}
+
+	return data;
+}
+
+void test_int(const bert_data_t *data,int64_t expected)
+{
+	if (data->type != bert_data_int)
+	{
+		test_fail("bert_decoder_pull_into did not decode an int");
+	}
+
+	if (data->integer != expected)
+	{
+		test_fail("bert_decoder_pull_into decoded %d, expected %d",(int)data->integer,(int)expected);
+	}
+}
+
+int main()
+{
+	bert_decoder_t *decoder;
+	bert_data_t *data = NULL;
+	bert_data_t *previous;
+	bert_data_t **elements;
+
+	if (!(decoder = bert_decoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_counting_allocator(&allocator,&counter);
+	bert_decoder_allocator(decoder,&allocator);
+
+	data = test_pull(decoder,first,sizeof(first),data);
+	previous = data;
+	memset(&counter,0,sizeof(struct test_counter));
+
+	data = test_pull(decoder,second,sizeof(second),data);
+
+	if (data != previous)
+	{
+		test_fail("bert_decoder_pull_into did not reuse the previous tuple");
+	}
+
+	if (counter.allocs || counter.reallocs)
+	{
+		test_fail("bert_decoder_pull_into made %u allocations decoding the same shape",counter.allocs + counter.reallocs);
+	}
+
+	elements = data->tuple->elements;
+
+	if (!bert_data_strequal(elements[0],"telemetry"))
+	{
+		test_fail("bert_decoder_pull_into did not decode the atom");
+	}
+
+	if (elements[1]->bin.length != 2 || memcmp(elements[1]->bin.data,"db",2))
+	{
+		test_fail("bert_decoder_pull_into did not decode the binary");
+	}
+
+	test_int(elements[2],69);
+	test_int(bert_list_get(elements[3]->list,2),6);
+
+	// the binary still fits the space allocated for the first one
+	memset(&counter,0,sizeof(struct test_counter));
+	data = test_pull(decoder,first,sizeof(first),data);
+
+	if (counter.allocs || counter.reallocs)
+	{
+		test_fail("bert_decoder_pull_into made %u allocations decoding a payload which fit the previous allocation",counter.allocs + counter.reallocs);
+	}
+
+	elements = data->tuple->elements;
+
+	if (elements[1]->bin.length != 4 || memcmp(elements[1]->bin.data,"host",4))
+	{
+		test_fail("bert_decoder_pull_into did not decode the binary");
+	}
+
+	data = test_pull(decoder,third,sizeof(third),data);
+
+	if (data->tuple->length != 3)
+	{
+		test_fail("bert_decoder_pull_into decoded %u elements, expected %u",data->tuple->length,3);
+	}
+
+	elements = data->tuple->elements;
+
+	test_int(elements[1],7);
+
+	if (elements[2]->type != bert_data_list || bert_list_length(elements[2]->list) != 1)
+	{
+		test_fail("bert_decoder_pull_into did not shrink the list");
+	}
+
+	test_int(bert_list_get(elements[2]->list,0),8);
+
+	// a shared tuple must not be modified
+	previous = bert_data_ref(data);
+	data = test_pull(decoder,first,sizeof(first),data);
+
+	if (data == previous)
+	{
+		test_fail("bert_decoder_pull_into decoded over a shared tuple");
+	}
+
+	test_int(previous->tuple->elements[1],7);
+
+	bert_data_destroy(previous);
+	bert_data_destroy(data);
+
+	// running out of data destroys the previous data
+	data = NULL;
+	bert_decoder_buffer(decoder,first,sizeof(first));
+	bert_decoder_pull_into(decoder,&data);
+
+	if (bert_decoder_pull_into(decoder,&data) != 0 || data)
+	{
+		test_fail("bert_decoder_pull_into did not release the previous data");
+	}
+
+	bert_decoder_destroy(decoder);
+	return 0;
+}
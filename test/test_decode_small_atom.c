@@ -0,0 +1,91 @@
+#include <bert/decoder.h>
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+// 'ok' as SMALL_ATOM_EXT
+const unsigned char small_atom[] = {131, 115, 2, 'o', 'k'};
+
+// 'ok' as ATOM_UTF8_EXT
+const unsigned char atom_utf8[] = {131, 118, 0, 2, 'o', 'k'};
+
+// 'ok' as SMALL_ATOM_UTF8_EXT
+const unsigned char small_atom_utf8[] = {131, 119, 2, 'o', 'k'};
+
+bert_data_t * test_pull(const unsigned char *buffer,size_t length)
+{
+	bert_decoder_t *decoder = bert_decoder_create();
+	bert_data_t *data;
+	int result;
+
+	if (!decoder)
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_decoder_buffer(decoder,buffer,length);
+
+	if ((result = bert_decoder_pull(decoder,&data)) != 1)
+	{
+		test_fail("bert_decoder_pull failed: %s",bert_strerror(result));
+	}
+
+	bert_decoder_destroy(decoder);
+	return data;
+}
+
+void test_atom(const unsigned char *buffer,size_t length)
+{
+	bert_data_t *data = test_pull(buffer,length);
+
+	if (data->type != bert_data_atom)
+	{
+		test_fail("bert_decoder_pull did not decode an atom from tag %u",buffer[1]);
+	}
+
+	if (data->atom.length != 2 || memcmp(data->atom.name,"ok",2))
+	{
+		test_fail("bert_decoder_pull decoded %s from tag %u, expected ok",data->atom.name,buffer[1]);
+	}
+
+	bert_data_destroy(data);
+}
+
+void test_complex()
+{
+	unsigned char output[64];
+	bert_encoder_t *encoder = test_encoder(output,sizeof(output));
+	bert_data_t *data;
+
+	if (!(data = bert_data_create_true()))
+	{
+		test_fail("malloc failed");
+	}
+
+	// {bert, true} with both atoms encoded as SMALL_ATOM_UTF8_EXT
+	bert_encoder_small_atoms(encoder,1);
+	test_encoder_push(encoder,data);
+	bert_data_destroy(data);
+
+	data = test_pull(output,bert_encoder_total(encoder));
+
+	if (data->type != bert_data_boolean || data->boolean != 1)
+	{
+		test_fail("bert_decoder_pull did not decode a complex term with small atoms");
+	}
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+int main()
+{
+	test_atom(small_atom,sizeof(small_atom));
+	test_atom(atom_utf8,sizeof(atom_utf8));
+	test_atom(small_atom_utf8,sizeof(small_atom_utf8));
+
+	test_complex();
+	return 0;
+}
@@ -0,0 +1,129 @@
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define LARGE_TUPLE	300
+
+unsigned char expected[1024 * 16];
+
+void test_append(bert_data_t *list,bert_data_t *data)
+{
+	if (!data || bert_list_append(list->list,data) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+}
+
+bert_data_t * test_data()
+{
+	const int64_t integers[] = {
+		0, 1, 255, 256, -1, -255, -256,
+		(1 << 27) - 1, -(1 << 27), (1 << 27), -(1 << 27) - 1,
+		INT64_MAX, INT64_MIN, 0x100000000LL
+	};
+	bert_data_t *list;
+	bert_data_t *dict;
+	bert_data_t *tuple;
+	unsigned int i;
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<(sizeof(integers) / sizeof(int64_t));i++)
+	{
+		test_append(list,bert_data_create_int(integers[i]));
+	}
+
+	test_append(list,bert_data_create_float(-1.5));
+	test_append(list,bert_data_create_atom("atom"));
+	test_append(list,bert_data_create_string("string"));
+	test_append(list,bert_data_create_bin((const unsigned char *)"bin",3));
+	test_append(list,bert_data_create_nil());
+	test_append(list,bert_data_create_true());
+	test_append(list,bert_data_create_false());
+	test_append(list,bert_data_create_time(1255384443));
+	test_append(list,bert_data_create_time(5));
+	test_append(list,bert_data_create_regex("^a+$",4,0xff));
+
+	if (!(dict = bert_data_create_dict()))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (bert_dict_append(dict->dict,bert_data_create_atom("key"),bert_data_create_int(-7)) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+
+	test_append(list,dict);
+
+	if (!(tuple = bert_data_create_tuple(LARGE_TUPLE)))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<LARGE_TUPLE;i++)
+	{
+		if (!(tuple->tuple->elements[i] = bert_data_create_int(i)))
+		{
+			test_fail("malloc failed");
+		}
+	}
+
+	test_append(list,tuple);
+	return list;
+}
+
+int main()
+{
+	bert_encoder_t *encoder = test_encoder(expected,sizeof(expected));
+	bert_data_t *data = test_data();
+
+	test_encoder_push(encoder,data);
+
+	size_t length = bert_encoder_total(encoder);
+	size_t size = bert_data_sizeof(data);
+
+	bert_encoder_destroy(encoder);
+
+	if ((size + 1) != length)
+	{
+		test_fail("bert_data_sizeof returned %u, but %u bytes were encoded",(unsigned int)size,(unsigned int)(length - 1));
+	}
+
+	unsigned char *buffer;
+	size_t buffer_length;
+	int result;
+
+	if ((result = bert_encode_alloc(data,&buffer,&buffer_length)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (buffer_length != length)
+	{
+		test_fail("bert_encode_alloc encoded %u bytes, expected %u",(unsigned int)buffer_length,(unsigned int)length);
+	}
+
+	test_bytes(buffer,expected,length);
+	free(buffer);
+	bert_data_destroy(data);
+
+	// data which cannot be encoded is rejected before writing
+	if (!(data = bert_data_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (bert_encode_alloc(data,&buffer,&buffer_length) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_encode_alloc did not reject bert_data_none");
+	}
+
+	bert_data_destroy(data);
+	return 0;
+}
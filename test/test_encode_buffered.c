@@ -0,0 +1,134 @@
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define LENGTH		1000
+#define BIN_LENGTH	(BERT_ENCODER_OUTPUT * 2)
+#define OUTPUT_SIZE	(BIN_LENGTH * 2)
+
+unsigned char expected[OUTPUT_SIZE];
+unsigned char output[OUTPUT_SIZE];
+
+size_t test_read(int fd,unsigned char *buffer,size_t length)
+{
+	size_t total = 0;
+	ssize_t result;
+
+	while (total < length && (result = read(fd,buffer + total,length - total)) > 0)
+	{
+		total += result;
+	}
+
+	return total;
+}
+
+void test_stream(int pipes[2],const bert_data_t *data,size_t output_size,const unsigned char *bytes,size_t length)
+{
+	bert_encoder_t *encoder;
+	int result;
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_stream(encoder,pipes[1]);
+
+	if ((result = bert_encoder_output_size(encoder,output_size)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	test_encoder_push(encoder,data);
+
+	if (bert_encoder_total(encoder) != length)
+	{
+		test_fail("bert_encoder_total returned %u, expected %u",(unsigned int)bert_encoder_total(encoder),(unsigned int)length);
+	}
+
+	// everything must have reached the stream once the push returns
+	bert_encoder_destroy(encoder);
+	close(pipes[1]);
+
+	if (test_read(pipes[0],output,sizeof(output)) != length)
+	{
+		test_fail("the stream did not receive %u bytes",(unsigned int)length);
+	}
+
+	test_bytes(output,bytes,length);
+	close(pipes[0]);
+}
+
+void test_open(int pipes[2])
+{
+	if (pipe(pipes) == -1)
+	{
+		test_fail("pipe failed");
+	}
+}
+
+int main()
+{
+	bert_encoder_t *encoder = test_encoder(expected,OUTPUT_SIZE);
+	bert_data_t *data;
+	bert_data_t *element;
+	int pipes[2];
+	unsigned int i;
+
+	if (!(data = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<LENGTH;i++)
+	{
+		if (!(element = bert_data_create_int(1000 + i)))
+		{
+			test_fail("malloc failed");
+		}
+
+		bert_list_append(data->list,element);
+	}
+
+	test_encoder_push(encoder,data);
+
+	size_t length = bert_encoder_total(encoder);
+
+	bert_encoder_destroy(encoder);
+
+	test_open(pipes);
+	test_stream(pipes,data,BERT_ENCODER_OUTPUT,expected,length);
+
+	// smaller than a single term
+	test_open(pipes);
+	test_stream(pipes,data,3,expected,length);
+
+	// unbuffered
+	test_open(pipes);
+	test_stream(pipes,data,0,expected,length);
+
+	bert_data_destroy(data);
+
+	// larger than the buffer
+	unsigned char bin[BIN_LENGTH];
+
+	memset(bin,'A',BIN_LENGTH);
+
+	if (!(data = bert_data_create_bin(bin,BIN_LENGTH)))
+	{
+		test_fail("malloc failed");
+	}
+
+	encoder = test_encoder(expected,OUTPUT_SIZE);
+	test_encoder_push(encoder,data);
+	length = bert_encoder_total(encoder);
+	bert_encoder_destroy(encoder);
+
+	test_open(pipes);
+	test_stream(pipes,data,BERT_ENCODER_OUTPUT,expected,length);
+
+	bert_data_destroy(data);
+	return 0;
+}
@@ -0,0 +1,298 @@
+#include <bert/builder.h>
+#include <bert/encoder.h>
+#include <bert/decoder.h>
+#include <bert/magic.h>
+#include <bert/util.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define ROWS		20000
+#define OUTPUT_SIZE	(1024 * 1024)
+
+unsigned char output[OUTPUT_SIZE];
+size_t output_length = 0;
+
+ssize_t test_callback(const unsigned char *data,size_t length,void *user_data)
+{
+	if ((output_length + length) > OUTPUT_SIZE)
+	{
+		test_fail("the callback received more than %u bytes",OUTPUT_SIZE);
+	}
+
+	memcpy(output + output_length,data,length);
+	output_length += length;
+	return length;
+}
+
+bert_data_t * test_tuple(bert_data_t *first,bert_data_t *second)
+{
+	bert_data_t *tuple;
+
+	if (!(tuple = bert_data_create_tuple(2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	tuple->tuple->elements[0] = first;
+	tuple->tuple->elements[1] = second;
+	return tuple;
+}
+
+// {rows, [{0, <<"row">>}, {1, <<"row">>}, ...]}
+bert_data_t * test_data(unsigned int rows)
+{
+	bert_data_t *list;
+	unsigned int i;
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<rows;i++)
+	{
+		if (bert_list_append(list->list,test_tuple(bert_data_create_int(i),bert_data_create_bin((const unsigned char *)"row",3))) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+	}
+
+	return test_tuple(bert_data_create_atom("rows"),list);
+}
+
+void test_build(bert_encoder_t *encoder,unsigned int rows)
+{
+	unsigned int i;
+
+	test_check(bert_encoder_begin_tuple(encoder,2));
+	test_check(bert_encoder_put_atom(encoder,"rows"));
+	test_check(bert_encoder_begin_list(encoder));
+
+	for (i=0;i<rows;i++)
+	{
+		test_check(bert_encoder_begin_tuple(encoder,2));
+		test_check(bert_encoder_put_int(encoder,i));
+		test_check(bert_encoder_put_bin(encoder,(const unsigned char *)"row",3));
+
+		if (bert_encoder_depth(encoder) != 2)
+		{
+			test_fail("bert_encoder_depth returned %u, expected %u",bert_encoder_depth(encoder),2);
+		}
+	}
+
+	test_check(bert_encoder_end_list(encoder));
+
+	if (bert_encoder_depth(encoder))
+	{
+		test_fail("bert_encoder_end_list did not complete the term");
+	}
+}
+
+void test_patched(unsigned int rows)
+{
+	bert_data_t *data = test_data(rows);
+	unsigned char *expected;
+	size_t expected_length;
+
+	test_check(bert_encode_alloc(data,&expected,&expected_length));
+
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	test_build(encoder,rows);
+
+	if (bert_encoder_total(encoder) != expected_length)
+	{
+		test_fail("the term builder encoded %u bytes, expected %u",(unsigned int)bert_encoder_total(encoder),(unsigned int)expected_length);
+	}
+
+	test_bytes(output,expected,expected_length);
+
+	bert_encoder_destroy(encoder);
+	bert_data_destroy(data);
+	free(expected);
+}
+
+void test_staged(unsigned int rows)
+{
+	bert_encoder_t *encoder;
+	bert_decoder_t *decoder;
+	bert_data_t *data = test_data(rows);
+	bert_data_t *decoded;
+	unsigned char *expected;
+	size_t expected_length;
+	int result;
+
+	test_check(bert_encode_alloc(data,&expected,&expected_length));
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	output_length = 0;
+	bert_encoder_callback(encoder,test_callback,NULL);
+	test_build(encoder,rows);
+
+	if (bert_encoder_total(encoder) != output_length)
+	{
+		test_fail("bert_encoder_total returned %u, but %u bytes were written",(unsigned int)bert_encoder_total(encoder),(unsigned int)output_length);
+	}
+
+	// skip the magic byte, tuple header and the rows atom
+	const unsigned char *header = output + 1 + 2 + (1 + 2 + 4);
+
+	if (header[0] != BERT_LIST)
+	{
+		test_fail("the term builder did not write the LIST magic byte");
+	}
+
+	if (expected_length >= BERT_ENCODER_STAGED && bert_read_uint32(header+1) >= rows)
+	{
+		test_fail("the term builder did not split the list into improper list segments");
+	}
+
+	if (!(decoder = bert_decoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_decoder_buffer(decoder,output,output_length);
+
+	if ((result = bert_decoder_pull(decoder,&decoded)) != 1)
+	{
+		test_fail("bert_decoder_pull failed: %s",bert_strerror(result));
+	}
+
+	bert_list_t *list = decoded->tuple->elements[1]->list;
+
+	if (bert_list_length(list) != rows)
+	{
+		test_fail("bert_decoder_pull decoded %u rows, expected %u",bert_list_length(list),rows);
+	}
+
+	unsigned char *encoded;
+	size_t encoded_length;
+
+	// the segments decode into a single proper list
+	test_check(bert_encode_alloc(decoded,&encoded,&encoded_length));
+
+	if (encoded_length != expected_length)
+	{
+		test_fail("the decoded list encoded to %u bytes, expected %u",(unsigned int)encoded_length,(unsigned int)expected_length);
+	}
+
+	test_bytes(encoded,expected,expected_length);
+
+	free(encoded);
+	free(expected);
+	bert_data_destroy(decoded);
+	bert_data_destroy(data);
+	bert_decoder_destroy(decoder);
+	bert_encoder_destroy(encoder);
+}
+
+/*
+ * A row buffer reused between elements must not change the elements
+ * already written.
+ */
+void test_reused()
+{
+	unsigned char row[BERT_ENCODER_REFERENCE * 2];
+	bert_encoder_t *encoder;
+	bert_data_t *expected;
+	unsigned char *expected_bytes;
+	size_t expected_length;
+	const struct iovec *iov;
+	unsigned int count;
+	unsigned int i;
+	size_t length = 0;
+
+	memset(row,'A',sizeof(row));
+
+	if (!(expected = bert_data_create_tuple(2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	expected->tuple->elements[0] = bert_data_create_bin(row,sizeof(row));
+	expected->tuple->elements[1] = bert_data_create_int(1);
+	test_check(bert_encode_alloc(expected,&expected_bytes,&expected_length));
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_iovec(encoder);
+	test_check(bert_encoder_begin_tuple(encoder,2));
+	test_check(bert_encoder_put_bin(encoder,row,sizeof(row)));
+
+	memset(row,'B',sizeof(row));
+	test_check(bert_encoder_put_int(encoder,1));
+
+	iov = bert_encoder_iovec_get(encoder,&count);
+
+	for (i=0;i<count;i++)
+	{
+		if ((length + iov[i].iov_len) > OUTPUT_SIZE)
+		{
+			test_fail("the term builder wrote more than %u bytes",OUTPUT_SIZE);
+		}
+
+		memcpy(output + length,iov[i].iov_base,iov[i].iov_len);
+		length += iov[i].iov_len;
+	}
+
+	if (length != expected_length)
+	{
+		test_fail("the term builder wrote %u bytes, expected %u",(unsigned int)length,(unsigned int)expected_length);
+	}
+
+	test_bytes(output,expected_bytes,expected_length);
+
+	free(expected_bytes);
+	bert_data_destroy(expected);
+	bert_encoder_destroy(encoder);
+}
+
+void test_invalid()
+{
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	if (bert_encoder_end_list(encoder) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_encoder_end_list did not reject ending a list that was never begun");
+	}
+
+	test_check(bert_encoder_begin_tuple(encoder,1));
+
+	if (bert_encoder_end_list(encoder) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_encoder_end_list did not reject ending a tuple");
+	}
+
+	bert_encoder_reset(encoder);
+
+	if (bert_encoder_depth(encoder))
+	{
+		test_fail("bert_encoder_reset did not abandon the open tuple");
+	}
+
+	bert_encoder_destroy(encoder);
+}
+
+int main()
+{
+	test_patched(0);
+	test_patched(ROWS);
+
+	test_staged(0);
+	test_staged(10);
+	test_staged(ROWS);
+
+	test_reused();
+	test_invalid();
+	return 0;
+}
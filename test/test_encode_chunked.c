@@ -0,0 +1,154 @@
+#include <bert/encoder.h>
+#include <bert/magic.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+#include <pthread.h>
+
+#define BIN_LENGTH	(1024 * 1024 * 4)
+#define OUTPUT_SIZE	(1 + 1 + 4 + BIN_LENGTH)
+#define STACK_SIZE	(1024 * 256)
+
+unsigned char *bin;
+unsigned char *output;
+size_t output_length = 0;
+size_t largest = 0;
+
+ssize_t test_callback(const unsigned char *data,size_t length,void *user_data)
+{
+	if (length > largest)
+	{
+		largest = length;
+	}
+
+	// only accept part of each large chunk
+	if (length > 1)
+	{
+		length = (length + 1) / 2;
+	}
+
+	memcpy(output + output_length,data,length);
+	output_length += length;
+	return length;
+}
+
+ssize_t test_silent(const unsigned char *data,size_t length,void *user_data)
+{
+	memcpy(output + output_length,data,length);
+	output_length += length;
+	return 0;
+}
+
+ssize_t test_oversized(const unsigned char *data,size_t length,void *user_data)
+{
+	return length + 1;
+}
+
+void test_output(size_t length)
+{
+	if (length != OUTPUT_SIZE)
+	{
+		test_fail("encoded %u bytes, expected %u",(unsigned int)length,OUTPUT_SIZE);
+	}
+
+	if (output[1] != BERT_BIN)
+	{
+		test_fail("bert_encoder_push did not add the BIN magic byte");
+	}
+
+	if (memcmp(output + 6,bin,BIN_LENGTH))
+	{
+		test_fail("bert_encoder_push did not encode the binary");
+	}
+}
+
+void * test_worker(void *arg)
+{
+	const bert_data_t *data = arg;
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	test_encoder_push(encoder,data);
+	test_output(bert_encoder_total(encoder));
+
+	bert_encoder_destroy(encoder);
+	return NULL;
+}
+
+int main()
+{
+	bert_encoder_t *encoder;
+	bert_data_t *data;
+
+	if (!(bin = malloc(BIN_LENGTH)) || !(output = malloc(OUTPUT_SIZE)))
+	{
+		test_fail("malloc failed");
+	}
+
+	memset(bin,'A',BIN_LENGTH);
+
+	if (!(data = bert_data_create_bin(bin,BIN_LENGTH)))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_callback(encoder,test_callback,NULL);
+	bert_encoder_partial_writes(encoder,1);
+	test_encoder_push(encoder,data);
+	test_output(output_length);
+
+	if (largest > (1024 * 64))
+	{
+		test_fail("the callback was given %u bytes at once",(unsigned int)largest);
+	}
+
+	bert_encoder_destroy(encoder);
+
+	// without partial writes, the return count is not taken as a length
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	memset(output,0,OUTPUT_SIZE);
+	output_length = 0;
+
+	bert_encoder_callback(encoder,test_silent,NULL);
+	test_encoder_push(encoder,data);
+	test_output(output_length);
+
+	bert_encoder_callback(encoder,test_oversized,NULL);
+
+	if (bert_encoder_push(encoder,data) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_encoder_push accepted a callback writing more than it was given");
+	}
+
+	bert_encoder_destroy(encoder);
+
+	// encoding must not depend on the size of the stack
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	memset(output,0,OUTPUT_SIZE);
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr,STACK_SIZE);
+
+	if (pthread_create(&thread,&attr,test_worker,data))
+	{
+		test_fail("pthread_create failed");
+	}
+
+	pthread_join(thread,NULL);
+	pthread_attr_destroy(&attr);
+
+	bert_data_destroy(data);
+	free(output);
+	free(bin);
+	return 0;
+}
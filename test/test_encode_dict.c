@@ -6,7 +6,7 @@
 #include <string.h>
 
 #define EXPECTED_LENGTH 2
-#define OUTPUT_SIZE	(1 + TEST_COMPLEX_HEADER_SIZE + 4 + 1 + 4 + ((1 + 1 + ((1 + 1) + (1 + 1))) * EXPECTED_LENGTH))
+#define OUTPUT_SIZE	(1 + TEST_COMPLEX_HEADER_SIZE + 4 + 1 + 4 + ((1 + 1 + ((1 + 1) + (1 + 1))) * EXPECTED_LENGTH) + 1)
 
 unsigned char output[OUTPUT_SIZE];
 
@@ -66,6 +66,11 @@ void test_output()
 			test_fail("bert_encoder_push encoded %u as the value at list index %u, expected %u",tuple_ptr[5],i,i+2);
 		}
 	}
+
+	if (data[5 + (((1 + 1) + (1 + 1) + (1 + 1)) * EXPECTED_LENGTH)] != BERT_NIL)
+	{
+		test_fail("bert_encoder_push did not terminate the key->value list with NIL");
+	}
 }
 
 int main()
@@ -0,0 +1,124 @@
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define LENGTH		4000
+#define OUTPUT_SIZE	(1 + 1 + 4 + ((1 + 4) * LENGTH) + 1)
+
+unsigned char expected[OUTPUT_SIZE];
+
+struct test_counter counter;
+bert_allocator_t allocator;
+
+unsigned char * test_take(bert_encoder_t *encoder,const unsigned char *bytes,size_t expected_length)
+{
+	unsigned char *buffer;
+	size_t length;
+	int result;
+
+	if ((result = bert_encoder_take_buffer(encoder,&buffer,&length)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (length != expected_length)
+	{
+		test_fail("bert_encoder_take_buffer returned %u bytes, expected %u",(unsigned int)length,(unsigned int)expected_length);
+	}
+
+	test_bytes(buffer,bytes,length);
+	return buffer;
+}
+
+int main()
+{
+	bert_encoder_t *encoder = test_encoder(expected,OUTPUT_SIZE);
+	bert_data_t *data;
+	bert_data_t *element;
+	unsigned int i;
+
+	if (!(data = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<LENGTH;i++)
+	{
+		if (!(element = bert_data_create_int(1000 + i)))
+		{
+			test_fail("malloc failed");
+		}
+
+		bert_list_append(data->list,element);
+	}
+
+	test_encoder_push(encoder,data);
+
+	size_t length = bert_encoder_total(encoder);
+
+	bert_encoder_destroy(encoder);
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_counting_allocator(&allocator,&counter);
+	bert_encoder_allocator(encoder,&allocator);
+	bert_encoder_dynamic(encoder);
+
+	// spans several segments, which are flattened
+	test_encoder_push(encoder,data);
+	free(test_take(encoder,expected,length));
+
+	// the segments are kept for the next message
+	memset(&counter,0,sizeof(struct test_counter));
+	test_encoder_push(encoder,data);
+
+	if (counter.allocs || counter.reallocs)
+	{
+		test_fail("bert_encoder_push made %u allocations after bert_encoder_take_buffer",counter.allocs + counter.reallocs);
+	}
+
+	bert_encoder_reset(encoder);
+
+	if (bert_encoder_total(encoder))
+	{
+		test_fail("bert_encoder_reset did not reset the total");
+	}
+
+	memset(&counter,0,sizeof(struct test_counter));
+	test_encoder_push(encoder,data);
+
+	if (counter.allocs || counter.reallocs)
+	{
+		test_fail("bert_encoder_push made %u allocations after bert_encoder_reset",counter.allocs + counter.reallocs);
+	}
+
+	bert_encoder_reset(encoder);
+	bert_data_destroy(data);
+
+	// a single segment is handed off without copying
+	if (!(data = bert_data_create_int(42)))
+	{
+		test_fail("malloc failed");
+	}
+
+	const unsigned char small[] = {131, 97, 42};
+
+	test_encoder_push(encoder,data);
+
+	memset(&counter,0,sizeof(struct test_counter));
+	free(test_take(encoder,small,sizeof(small)));
+
+	if (counter.allocs || counter.reallocs)
+	{
+		test_fail("bert_encoder_take_buffer copied a single segment");
+	}
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+	return 0;
+}
@@ -0,0 +1,178 @@
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define FILE_LENGTH	(1024 * 200)
+#define OFFSET		100
+#define BIN_LENGTH	(FILE_LENGTH - OFFSET)
+#define OUTPUT_SIZE	(FILE_LENGTH * 2)
+
+unsigned char contents[FILE_LENGTH];
+unsigned char expected[OUTPUT_SIZE];
+unsigned char output[OUTPUT_SIZE];
+
+bert_data_t * test_term(bert_data_t *contents_data)
+{
+	bert_data_t *data;
+
+	if (!(data = bert_data_create_tuple(3)))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (!(data->tuple->elements[0] = bert_data_create_atom("file")))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (!(data->tuple->elements[1] = bert_data_create_bin((const unsigned char *)"name",4)))
+	{
+		test_fail("malloc failed");
+	}
+
+	data->tuple->elements[2] = contents_data;
+	return data;
+}
+
+void test_stream(const bert_data_t *data,size_t length)
+{
+	bert_encoder_t *encoder;
+	FILE *file;
+
+	if (!(file = tmpfile()))
+	{
+		test_fail("tmpfile failed");
+	}
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_stream(encoder,fileno(file));
+	test_encoder_push(encoder,data);
+	bert_encoder_destroy(encoder);
+
+	rewind(file);
+
+	if (fread(output,1,OUTPUT_SIZE,file) != length)
+	{
+		test_fail("bert_encoder_push did not write %u bytes to the stream",(unsigned int)length);
+	}
+
+	test_bytes(output,expected,length);
+	fclose(file);
+}
+
+void test_dynamic(const bert_data_t *data,size_t length)
+{
+	bert_encoder_t *encoder;
+	unsigned char *buffer;
+	size_t buffer_length;
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_dynamic(encoder);
+	test_encoder_push(encoder,data);
+
+	if (bert_encoder_take_buffer(encoder,&buffer,&buffer_length) != BERT_SUCCESS || buffer_length != length)
+	{
+		test_fail("bert_encoder_take_buffer did not return %u bytes",(unsigned int)length);
+	}
+
+	test_bytes(buffer,expected,length);
+
+	free(buffer);
+	bert_encoder_destroy(encoder);
+}
+
+void test_buffer(const bert_data_t *data,size_t length)
+{
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	memset(output,0,OUTPUT_SIZE);
+	test_encoder_push(encoder,data);
+	test_bytes(output,expected,length);
+
+	bert_encoder_destroy(encoder);
+}
+
+int main()
+{
+	FILE *file;
+	int fd;
+	unsigned int i;
+
+	for (i=0;i<FILE_LENGTH;i++)
+	{
+		contents[i] = (i & 0xff);
+	}
+
+	if (!(file = tmpfile()) || fwrite(contents,1,FILE_LENGTH,file) != FILE_LENGTH || fflush(file))
+	{
+		test_fail("could not write the temporary file");
+	}
+
+	fd = fileno(file);
+
+	bert_data_t *data;
+	bert_data_t *contents_data;
+
+	if (!(contents_data = bert_data_create_bin(contents + OFFSET,BIN_LENGTH)))
+	{
+		test_fail("malloc failed");
+	}
+
+	data = test_term(contents_data);
+
+	bert_encoder_t *encoder = test_encoder(expected,OUTPUT_SIZE);
+
+	test_encoder_push(encoder,data);
+
+	size_t length = bert_encoder_total(encoder);
+	size_t size = bert_data_sizeof(data);
+
+	bert_encoder_destroy(encoder);
+	bert_data_destroy(data);
+
+	if (!(contents_data = bert_data_create_file(fd,OFFSET,BIN_LENGTH)))
+	{
+		test_fail("malloc failed");
+	}
+
+	data = test_term(contents_data);
+
+	if (bert_data_sizeof(data) != size)
+	{
+		test_fail("bert_data_sizeof returned %u, expected %u",(unsigned int)bert_data_sizeof(data),(unsigned int)size);
+	}
+
+	test_stream(data,length);
+	test_dynamic(data,length);
+	test_buffer(data,length);
+
+	bert_data_destroy(data);
+
+	// reading past the end of the file fails
+	if (!(data = bert_data_create_file(fd,OFFSET,FILE_LENGTH)))
+	{
+		test_fail("malloc failed");
+	}
+
+	encoder = test_encoder(output,OUTPUT_SIZE);
+
+	if (bert_encoder_push(encoder,data) != BERT_ERRNO_READ)
+	{
+		test_fail("bert_encoder_push did not fail on a short file");
+	}
+
+	bert_encoder_destroy(encoder);
+	bert_data_destroy(data);
+	fclose(file);
+	return 0;
+}
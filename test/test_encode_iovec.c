@@ -0,0 +1,156 @@
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define BIN_LENGTH	(1024 * 64)
+#define OUTPUT_SIZE	(BIN_LENGTH * 2)
+
+unsigned char bin[BIN_LENGTH];
+unsigned char expected[OUTPUT_SIZE];
+unsigned char output[OUTPUT_SIZE];
+
+bert_data_t * test_data()
+{
+	bert_data_t *data;
+	bert_data_t *element;
+	unsigned int i;
+
+	memset(bin,'A',BIN_LENGTH);
+
+	if (!(data = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<3;i++)
+	{
+		if (!(element = bert_data_create_atom("blob")))
+		{
+			test_fail("malloc failed");
+		}
+
+		bert_list_append(data->list,element);
+
+		if (!(element = bert_data_create_bin(bin,BIN_LENGTH / (i + 1))))
+		{
+			test_fail("malloc failed");
+		}
+
+		bert_list_append(data->list,element);
+	}
+
+	return data;
+}
+
+void test_iovec(const bert_data_t *data,size_t length)
+{
+	bert_encoder_t *encoder;
+	const struct iovec *iov;
+	unsigned int count;
+	unsigned int i;
+	size_t total = 0;
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_iovec(encoder);
+	test_encoder_push(encoder,data);
+
+	iov = bert_encoder_iovec_get(encoder,&count);
+
+	for (i=0;i<count;i++)
+	{
+		if (total + iov[i].iov_len > OUTPUT_SIZE)
+		{
+			test_fail("bert_encoder_iovec_get returned more than %u bytes",OUTPUT_SIZE);
+		}
+
+		memcpy(output + total,iov[i].iov_base,iov[i].iov_len);
+		total += iov[i].iov_len;
+	}
+
+	if (total != length)
+	{
+		test_fail("bert_encoder_iovec_get returned %u bytes, expected %u",(unsigned int)total,(unsigned int)length);
+	}
+
+	test_bytes(output,expected,length);
+
+	// the binaries must be referenced rather than copied
+	const bert_data_t *element = bert_list_get(data->list,1);
+
+	for (i=0;i<count;i++)
+	{
+		if (iov[i].iov_base == element->bin.data)
+		{
+			break;
+		}
+	}
+
+	if (i == count)
+	{
+		test_fail("bert_encoder_push copied the binary into the iovecs");
+	}
+
+	bert_encoder_iovec_clear(encoder);
+	bert_encoder_iovec_get(encoder,&count);
+
+	if (count)
+	{
+		test_fail("bert_encoder_iovec_clear left %u iovecs",count);
+	}
+
+	bert_encoder_destroy(encoder);
+}
+
+void test_stream(const bert_data_t *data,size_t length)
+{
+	bert_encoder_t *encoder;
+	FILE *file;
+
+	if (!(file = tmpfile()))
+	{
+		test_fail("tmpfile failed");
+	}
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_stream(encoder,fileno(file));
+	test_encoder_push(encoder,data);
+	bert_encoder_destroy(encoder);
+
+	rewind(file);
+
+	if (fread(output,1,OUTPUT_SIZE,file) != length)
+	{
+		test_fail("bert_encoder_push did not write %u bytes to the stream",(unsigned int)length);
+	}
+
+	test_bytes(output,expected,length);
+	fclose(file);
+}
+
+int main()
+{
+	bert_encoder_t *encoder = test_encoder(expected,OUTPUT_SIZE);
+	bert_data_t *data = test_data();
+
+	test_encoder_push(encoder,data);
+
+	size_t length = bert_encoder_total(encoder);
+
+	bert_encoder_destroy(encoder);
+
+	test_iovec(data,length);
+	test_stream(data,length);
+
+	bert_data_destroy(data);
+	return 0;
+}
@@ -6,7 +6,7 @@
 #include <string.h>
 
 #define EXPECTED_LENGTH 256
-#define OUTPUT_SIZE	(1 + 1 + 4 + ((1 + 1) * EXPECTED_LENGTH))
+#define OUTPUT_SIZE	(1 + 1 + 4 + ((1 + 1) * EXPECTED_LENGTH) + 1)
 
 unsigned char output[OUTPUT_SIZE];
 
@@ -44,6 +44,11 @@ void test_output()
 			test_fail("bert_encoder_push encoded %u for the small int at index %u, expected %u",output_ptr[1],i,i);
 		}
 	}
+
+	if (output[OUTPUT_SIZE - 1] != BERT_NIL)
+	{
+		test_fail("bert_encoder_push did not terminate the list with NIL");
+	}
 }
 
 int main()
@@ -0,0 +1,186 @@
+#include <bert/encoder.h>
+#include <bert/cache.h>
+#include <bert/magic.h>
+#include <bert/util.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define EXPECTED_LENGTH 2
+#define OUTPUT_SIZE	(1 + 1 + 4 + (((1 + 1) + (1 + 1)) * EXPECTED_LENGTH))
+#define LARGE_LENGTH	1000
+#define LARGE_SIZE	(1024 * 16)
+#define THRESHOLD	256
+
+unsigned char output[OUTPUT_SIZE];
+unsigned char large_output[LARGE_SIZE];
+
+void test_output()
+{
+	if (output[0] != BERT_MAGIC)
+	{
+		test_fail("bert_encoder_push did not add the magic byte");
+	}
+
+	if (output[1] != BERT_MAP)
+	{
+		test_fail("bert_encoder_push did not encode the MAP magic byte");
+	}
+
+	if (bert_read_uint32(output+2) != EXPECTED_LENGTH)
+	{
+		test_fail("bert_encoder_push encoded %u as the map arity, expected %u",bert_read_uint32(output+2),EXPECTED_LENGTH);
+	}
+
+	unsigned int i;
+	const unsigned char *pair_ptr;
+
+	for (i=0;i<EXPECTED_LENGTH;i++)
+	{
+		pair_ptr = (output + 6 + (((1 + 1) + (1 + 1)) * i));
+
+		if (pair_ptr[0] != BERT_SMALL_INT || pair_ptr[1] != (i + 1))
+		{
+			test_fail("bert_encoder_push did not encode the key of pair %u",i);
+		}
+
+		if (pair_ptr[2] != BERT_SMALL_INT || pair_ptr[3] != (i + 2))
+		{
+			test_fail("bert_encoder_push did not encode the value of pair %u",i);
+		}
+	}
+}
+
+bert_data_t * test_dict(unsigned int length)
+{
+	bert_data_t *data;
+	bert_data_t *key;
+	bert_data_t *value;
+	unsigned int i;
+
+	if (!(data = bert_data_create_dict()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<length;i++)
+	{
+		if (!(key = bert_data_create_int(i+1)))
+		{
+			test_fail("malloc failed");
+		}
+
+		if (!(value = bert_data_create_int(i+2)))
+		{
+			test_fail("malloc failed");
+		}
+
+		bert_dict_append(data->dict,key,value);
+	}
+
+	return data;
+}
+
+void test_push(const bert_data_t *data)
+{
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	bert_encoder_maps(encoder,1);
+	test_encoder_push(encoder,data);
+
+	if (bert_encoder_total(encoder) != OUTPUT_SIZE)
+	{
+		test_fail("bert_encoder_push encoded %u bytes, expected %u",(unsigned int)bert_encoder_total(encoder),OUTPUT_SIZE);
+	}
+
+	bert_encoder_destroy(encoder);
+	test_output();
+}
+
+void test_cached(bert_data_t *data)
+{
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	bert_encoder_maps(encoder,1);
+
+	// bytes cached in the complex form are not written as a map
+	test_check(bert_data_cache(data));
+	test_push(data);
+
+	test_check(bert_encoder_cache(encoder,data));
+	test_push(data);
+
+	// changes made behind the back of the cache show that it was used
+	data->dict->head->value->integer = 42;
+	test_push(data);
+
+	data->dict->head->value->integer = 2;
+	bert_data_uncache(data);
+	bert_encoder_destroy(encoder);
+}
+
+void test_compressed()
+{
+	bert_encoder_t *encoder = test_encoder(large_output,LARGE_SIZE);
+	bert_data_t *data = test_dict(LARGE_LENGTH);
+	size_t size = bert_encoder_sizeof(encoder,data);
+
+	bert_encoder_maps(encoder,1);
+	test_check(bert_encoder_compress(encoder,THRESHOLD,6));
+	test_encoder_push(encoder,data);
+
+	if (large_output[1] != BERT_COMPRESSED)
+	{
+		test_fail("bert_encoder_push did not compress the map");
+	}
+
+	if (bert_read_uint32(large_output+2) == size || bert_read_uint32(large_output+2) != bert_encoder_sizeof(encoder,data))
+	{
+		test_fail("bert_encoder_push did not compress the term as a map");
+	}
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+void test_sizeof()
+{
+	bert_encoder_t *encoder = test_encoder(large_output,LARGE_SIZE);
+	bert_data_t *data = test_dict(EXPECTED_LENGTH);
+	bert_data_t *tuple;
+
+	if (!(tuple = bert_data_create_tuple(3)))
+	{
+		test_fail("malloc failed");
+	}
+
+	tuple->tuple->elements[0] = bert_data_create_atom("reply");
+	tuple->tuple->elements[1] = bert_data_create_true();
+	tuple->tuple->elements[2] = data;
+
+	bert_encoder_maps(encoder,1);
+	bert_encoder_small_atoms(encoder,1);
+	test_encoder_push(encoder,tuple);
+
+	if (bert_encoder_total(encoder) != (bert_encoder_sizeof(encoder,tuple) + 1))
+	{
+		test_fail("bert_encoder_sizeof returned %u, expected %u",(unsigned int)bert_encoder_sizeof(encoder,tuple),(unsigned int)(bert_encoder_total(encoder) - 1));
+	}
+
+	bert_data_destroy(tuple);
+	bert_encoder_destroy(encoder);
+}
+
+int main()
+{
+	bert_data_t *data = test_dict(EXPECTED_LENGTH);
+
+	test_push(data);
+	test_cached(data);
+	bert_data_destroy(data);
+
+	test_compressed();
+	test_sizeof();
+	return 0;
+}
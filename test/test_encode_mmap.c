@@ -0,0 +1,137 @@
+#include <bert/encoder.h>
+#include <bert/decoder.h>
+#include <bert/builder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
+
+#define BIN_LENGTH	(BERT_ENCODER_EXTENT + 1000)
+#define ROWS		10
+
+bert_data_t * test_pull(bert_decoder_t *decoder,bert_data_type type)
+{
+	bert_data_t *data;
+	int result;
+
+	if ((result = bert_decoder_pull(decoder,&data)) != 1)
+	{
+		test_fail("bert_decoder_pull failed: %s",bert_strerror(result));
+	}
+
+	if (data->type != type)
+	{
+		test_fail("bert_decoder_pull decoded the wrong type of data");
+	}
+
+	return data;
+}
+
+int main()
+{
+	char path[] = "/tmp/test_encode_mmap.XXXXXX";
+	bert_encoder_t *encoder;
+	bert_decoder_t *decoder;
+	unsigned char *bin;
+	bert_data_t *data;
+	struct stat info;
+	unsigned int i;
+	int fd;
+
+	if ((fd = mkstemp(path)) < 0)
+	{
+		test_fail("could not create a temporary file");
+	}
+
+	close(fd);
+
+	if (!(bin = malloc(BIN_LENGTH)))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<BIN_LENGTH;i++)
+	{
+		bin[i] = (i % 251);
+	}
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_check(bert_encoder_mmap(encoder,path));
+
+	// a small term, then one which runs past the first extent
+	test_encoder_push(encoder,data = bert_data_create_int(1000));
+	bert_data_destroy(data);
+
+	test_encoder_push(encoder,data = bert_data_create_bin(bin,BIN_LENGTH));
+	bert_data_destroy(data);
+
+	// a list whose header has been unmapped by the time it is patched
+	test_check(bert_encoder_begin_list(encoder));
+	test_check(bert_encoder_put_bin(encoder,bin,BIN_LENGTH));
+
+	for (i=0;i<ROWS;i++)
+	{
+		test_check(bert_encoder_put_int(encoder,i));
+	}
+
+	test_check(bert_encoder_end_list(encoder));
+
+	size_t total = bert_encoder_total(encoder);
+
+	test_check(bert_encoder_mmap_close(encoder));
+
+	if (bert_encoder_mmap_close(encoder) != BERT_ERRNO_INVALID)
+	{
+		test_fail("bert_encoder_mmap_close closed the file twice");
+	}
+
+	if (stat(path,&info) < 0 || info.st_size != total)
+	{
+		test_fail("bert_encoder_mmap_close did not truncate the file to %u bytes",(unsigned int)total);
+	}
+
+	fd = test_open_file(path);
+	decoder = test_decoder();
+	bert_decoder_stream(decoder,fd);
+
+	data = test_pull(decoder,bert_data_int);
+
+	if (data->integer != 1000)
+	{
+		test_fail("bert_decoder_pull decoded %d, expected %d",(int)data->integer,1000);
+	}
+
+	bert_data_destroy(data);
+
+	data = test_pull(decoder,bert_data_bin);
+
+	if (data->bin.length != BIN_LENGTH)
+	{
+		test_fail("bert_decoder_pull decoded a %u byte binary, expected %u",data->bin.length,BIN_LENGTH);
+	}
+
+	test_bytes(data->bin.data,bin,BIN_LENGTH);
+	bert_data_destroy(data);
+
+	data = test_pull(decoder,bert_data_list);
+
+	if (bert_list_length(data->list) != (1 + ROWS))
+	{
+		test_fail("bert_decoder_pull decoded a list of %u elements, expected %u",(unsigned int)bert_list_length(data->list),1 + ROWS);
+	}
+
+	bert_data_destroy(data);
+
+	bert_decoder_destroy(decoder);
+	bert_encoder_destroy(encoder);
+	close(fd);
+	unlink(path);
+	free(bin);
+	return 0;
+}
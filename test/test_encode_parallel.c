@@ -0,0 +1,151 @@
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define ELEMENTS	50000
+#define THREADS		4
+#define OUTPUT_SIZE	(1024 * 1024)
+
+unsigned char output[OUTPUT_SIZE];
+unsigned char streamed[OUTPUT_SIZE];
+
+bert_data_t * test_element(unsigned int i)
+{
+	bert_data_t *tuple;
+
+	if (!(tuple = bert_data_create_tuple(2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	tuple->tuple->elements[0] = bert_data_create_int(i * 1000);
+	tuple->tuple->elements[1] = bert_data_create_bin((const unsigned char *)"row",3);
+	return tuple;
+}
+
+// [{0, <<"row">>}, {1000, <<"row">>}, ...]
+bert_data_t * test_list()
+{
+	bert_data_t *list;
+	unsigned int i;
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<ELEMENTS;i++)
+	{
+		if (bert_list_append(list->list,test_element(i)) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+	}
+
+	return list;
+}
+
+// {{0, <<"row">>}, {1000, <<"row">>}, ...}
+bert_data_t * test_tuple()
+{
+	bert_data_t *tuple;
+	unsigned int i;
+
+	if (!(tuple = bert_data_create_tuple(ELEMENTS)))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<ELEMENTS;i++)
+	{
+		tuple->tuple->elements[i] = test_element(i);
+	}
+
+	return tuple;
+}
+
+void test_buffer(const bert_data_t *data,const unsigned char *expected,size_t expected_length)
+{
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	test_check(bert_encoder_push_parallel(encoder,data,THREADS));
+
+	if (bert_encoder_total(encoder) != expected_length)
+	{
+		test_fail("bert_encoder_push_parallel encoded %u bytes, expected %u",(unsigned int)bert_encoder_total(encoder),(unsigned int)expected_length);
+	}
+
+	test_bytes(output,expected,expected_length);
+	bert_encoder_destroy(encoder);
+}
+
+void test_stream(const bert_data_t *data,const unsigned char *expected,size_t expected_length)
+{
+	bert_encoder_t *encoder;
+	FILE *file;
+	int fd;
+
+	if (!(file = tmpfile()))
+	{
+		test_fail("could not create a temporary file");
+	}
+
+	fd = fileno(file);
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_stream(encoder,fd);
+	test_check(bert_encoder_push_parallel(encoder,data,THREADS));
+
+	if (pread(fd,streamed,OUTPUT_SIZE,0) != expected_length)
+	{
+		test_fail("bert_encoder_push_parallel did not write %u bytes to the stream",(unsigned int)expected_length);
+	}
+
+	test_bytes(streamed,expected,expected_length);
+
+	bert_encoder_destroy(encoder);
+	fclose(file);
+}
+
+void test_parallel(bert_data_t *data)
+{
+	unsigned char *expected;
+	size_t expected_length;
+
+	test_check(bert_encode_alloc(data,&expected,&expected_length));
+
+	test_buffer(data,expected,expected_length);
+	test_stream(data,expected,expected_length);
+
+	free(expected);
+	bert_data_destroy(data);
+}
+
+void test_short_write()
+{
+	bert_data_t *data = test_list();
+	bert_encoder_t *encoder = test_encoder(output,1024);
+
+	if (bert_encoder_push_parallel(encoder,data,THREADS) != BERT_ERRNO_SHORT_WRITE)
+	{
+		test_fail("bert_encoder_push_parallel did not run out of space");
+	}
+
+	bert_encoder_destroy(encoder);
+	bert_data_destroy(data);
+}
+
+int main()
+{
+	test_parallel(test_list());
+	test_parallel(test_tuple());
+	test_short_write();
+
+	return 0;
+}
@@ -7,7 +7,7 @@
 
 #define EXPECTED_LENGTH 13
 #define EXPECTED	"hello\\s*world"
-#define OUTPUT_SIZE	(1 + TEST_COMPLEX_HEADER_SIZE + 5 + 1 + 4 + EXPECTED_LENGTH + 1 + 4)
+#define OUTPUT_SIZE	(1 + TEST_COMPLEX_HEADER_SIZE + 5 + 1 + 4 + EXPECTED_LENGTH + 1 + 4 + 1)
 
 unsigned char output[OUTPUT_SIZE];
 
@@ -41,6 +41,11 @@ void test_output()
 	{
 		test_fail("bert_encoder_push encoded %u as the regex option list length, expected %u",data[5+EXPECTED_LENGTH+3],0);
 	}
+
+	if (data[5+EXPECTED_LENGTH+5] != BERT_NIL)
+	{
+		test_fail("bert_encoder_push did not terminate the regex option list with NIL");
+	}
 }
 
 int main()
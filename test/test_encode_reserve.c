@@ -0,0 +1,210 @@
+#include <bert/encoder.h>
+#include <bert/util.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define RING_SIZE	100
+#define OUTPUT_SIZE	4096
+#define ELEMENTS	100
+
+/*
+ * Ring buffer which is drained into the output as soon as bytes are
+ * committed to it.
+ */
+unsigned char ring[RING_SIZE];
+size_t ring_head = 0;
+size_t ring_reserved = 0;
+unsigned int reserves = 0;
+unsigned int commits = 0;
+
+unsigned char output[OUTPUT_SIZE];
+size_t output_length = 0;
+
+unsigned char * test_reserve(size_t length,size_t *available,void *user_data)
+{
+	if (!user_data)
+	{
+		// the ring is full
+		return NULL;
+	}
+
+	++reserves;
+
+	// reserve exactly what was asked for, unless the ring wraps around
+	ring_reserved = MIN(length,RING_SIZE - ring_head);
+	*available = ring_reserved;
+	return ring + ring_head;
+}
+
+void test_commit(size_t length,void *user_data)
+{
+	if (length > ring_reserved)
+	{
+		test_fail("committed %u bytes of a %u byte reservation",(unsigned int)length,(unsigned int)ring_reserved);
+	}
+
+	if ((output_length + length) > OUTPUT_SIZE)
+	{
+		test_fail("more than %u bytes were committed",OUTPUT_SIZE);
+	}
+
+	++commits;
+
+	memcpy(output + output_length,ring + ring_head,length);
+	output_length += length;
+
+	ring_head = (ring_head + length) % RING_SIZE;
+	ring_reserved = 0;
+}
+
+// [{0, "row"}, {1, "row"}, ...]
+bert_data_t * test_data()
+{
+	bert_data_t *list;
+	bert_data_t *tuple;
+	unsigned int i;
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<ELEMENTS;i++)
+	{
+		if (!(tuple = bert_data_create_tuple(2)))
+		{
+			test_fail("malloc failed");
+		}
+
+		tuple->tuple->elements[0] = bert_data_create_int(i);
+		tuple->tuple->elements[1] = bert_data_create_string("row");
+
+		if (bert_list_append(list->list,tuple) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+	}
+
+	return list;
+}
+
+void test_ring()
+{
+	bert_data_t *data = test_data();
+	bert_encoder_t *encoder;
+	unsigned char *expected;
+	size_t expected_length;
+
+	test_check(bert_encode_alloc(data,&expected,&expected_length));
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_reserve(encoder,test_reserve,test_commit,ring);
+	test_check(bert_encoder_push(encoder,data));
+
+	if (ring_reserved)
+	{
+		test_fail("bert_encoder_push did not commit the last reservation");
+	}
+
+	if (output_length != expected_length)
+	{
+		test_fail("%u bytes were committed, expected %u",(unsigned int)output_length,(unsigned int)expected_length);
+	}
+
+	test_bytes(output,expected,expected_length);
+
+	// one reservation per pass around the ring
+	if (reserves > ((expected_length / RING_SIZE) + 2))
+	{
+		test_fail("bert_encoder_push made %u reservations for %u bytes",reserves,(unsigned int)expected_length);
+	}
+
+	free(expected);
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+void test_exact()
+{
+	bert_data_t *data;
+	bert_encoder_t *encoder;
+	unsigned char *expected;
+	size_t expected_length;
+
+	// {reply, 42, "hello"}
+	if (!(data = bert_data_create_tuple(3)))
+	{
+		test_fail("malloc failed");
+	}
+
+	data->tuple->elements[0] = bert_data_create_atom("reply");
+	data->tuple->elements[1] = bert_data_create_int(42);
+	data->tuple->elements[2] = bert_data_create_string("hello");
+
+	test_check(bert_encode_alloc(data,&expected,&expected_length));
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	ring_head = 0;
+	output_length = 0;
+	reserves = 0;
+	commits = 0;
+
+	bert_encoder_reserve(encoder,test_reserve,test_commit,ring);
+	test_check(bert_encoder_push(encoder,data));
+
+	if (reserves != 1 || commits != 1)
+	{
+		test_fail("bert_encoder_push made %u reservations and %u commits for a term which fit",reserves,commits);
+	}
+
+	if (output_length != expected_length)
+	{
+		test_fail("%u bytes were committed, expected %u",(unsigned int)output_length,(unsigned int)expected_length);
+	}
+
+	test_bytes(output,expected,expected_length);
+
+	free(expected);
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+void test_full()
+{
+	bert_data_t *data = test_data();
+	bert_encoder_t *encoder;
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_reserve(encoder,test_reserve,test_commit,NULL);
+
+	if (bert_encoder_push(encoder,data) != BERT_ERRNO_SHORT_WRITE)
+	{
+		test_fail("bert_encoder_push did not fail when the ring was full");
+	}
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+int main()
+{
+	test_ring();
+	test_exact();
+	test_full();
+
+	return 0;
+}
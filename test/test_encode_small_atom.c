@@ -0,0 +1,143 @@
+#include <bert/encoder.h>
+#include <bert/decoder.h>
+#include <bert/magic.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define EXPECTED_LENGTH 2
+#define EXPECTED	"id"
+#define LONG_LENGTH	300
+#define OUTPUT_SIZE	(1 + 1 + 2 + LONG_LENGTH)
+
+unsigned char output[OUTPUT_SIZE];
+
+bert_encoder_t * test_small_encoder()
+{
+	bert_encoder_t *encoder = test_encoder(output,OUTPUT_SIZE);
+
+	bert_encoder_small_atoms(encoder,1);
+	return encoder;
+}
+
+void test_small()
+{
+	bert_encoder_t *encoder = test_small_encoder();
+	bert_data_t *data;
+
+	if (!(data = bert_data_create_atom(EXPECTED)))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_encoder_push(encoder,data);
+
+	if (bert_encoder_total(encoder) != (1 + 1 + 1 + EXPECTED_LENGTH))
+	{
+		test_fail("bert_encoder_push encoded %u bytes, expected %u",(unsigned int)bert_encoder_total(encoder),1 + 1 + 1 + EXPECTED_LENGTH);
+	}
+
+	if (output[1] != BERT_SMALL_ATOM)
+	{
+		test_fail("bert_encoder_push did not add the SMALL_ATOM magic byte");
+	}
+
+	if (output[2] != EXPECTED_LENGTH)
+	{
+		test_fail("bert_encoder_push encoded %u as the atom length, expected %u",output[2],EXPECTED_LENGTH);
+	}
+
+	test_strings((const char *)(output+3),EXPECTED,EXPECTED_LENGTH);
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+void test_long()
+{
+	bert_encoder_t *encoder = test_small_encoder();
+	bert_data_t *data;
+	char name[LONG_LENGTH + 1];
+
+	memset(name,'a',LONG_LENGTH);
+	name[LONG_LENGTH] = '\0';
+
+	if (!(data = bert_data_create_atom(name)))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_encoder_push(encoder,data);
+
+	if (output[1] != BERT_ATOM)
+	{
+		test_fail("bert_encoder_push did not fall back to the ATOM magic byte for a long atom");
+	}
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+void test_latin1()
+{
+	// 'é' as ATOM_EXT, where the name is a single Latin-1 byte
+	const unsigned char latin1[] = {BERT_MAGIC, BERT_ATOM, 0, 1, 0xe9};
+	bert_decoder_t *decoder = test_decoder();
+	bert_encoder_t *encoder = test_small_encoder();
+	bert_data_t *data;
+	int result;
+
+	bert_decoder_buffer(decoder,latin1,sizeof(latin1));
+
+	if ((result = bert_decoder_pull(decoder,&data)) != 1)
+	{
+		test_fail("bert_decoder_pull failed: %s",bert_strerror(result));
+	}
+
+	test_encoder_push(encoder,data);
+
+	// SMALL_ATOM_UTF8_EXT would turn the name into invalid UTF-8
+	if (output[1] != BERT_SMALL_ATOM || output[2] != 1 || output[3] != 0xe9)
+	{
+		test_fail("bert_encoder_push did not keep the Latin-1 atom as SMALL_ATOM");
+	}
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+	bert_decoder_destroy(decoder);
+}
+
+void test_complex()
+{
+	bert_encoder_t *encoder = test_small_encoder();
+	bert_data_t *data;
+
+	if (!(data = bert_data_create_true()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_encoder_push(encoder,data);
+
+	// one byte saved for both the bert and true atoms
+	size_t expected = 1 + bert_data_sizeof(data) - 2;
+
+	if (bert_encoder_total(encoder) != expected)
+	{
+		test_fail("bert_encoder_push encoded %u bytes, expected %u",(unsigned int)bert_encoder_total(encoder),(unsigned int)expected);
+	}
+
+	bert_data_destroy(data);
+	bert_encoder_destroy(encoder);
+}
+
+int main()
+{
+	test_small();
+	test_long();
+	test_latin1();
+	test_complex();
+
+	return 0;
+}
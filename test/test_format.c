@@ -0,0 +1,205 @@
+#include <bert/format.h>
+#include <bert/encoder.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+unsigned char output[1024];
+
+void test_append(bert_data_t *list,bert_data_t *data)
+{
+	if (!data || bert_list_append(list->list,data) != BERT_SUCCESS)
+	{
+		test_fail("malloc failed");
+	}
+}
+
+bert_data_t * test_tuple(bert_data_t *first,bert_data_t *second,bert_data_t *third)
+{
+	bert_data_t *tuple;
+
+	if (!(tuple = bert_data_create_tuple(third ? 3 : 2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	tuple->tuple->elements[0] = first;
+	tuple->tuple->elements[1] = second;
+
+	if (third)
+	{
+		tuple->tuple->elements[2] = third;
+	}
+
+	return tuple;
+}
+
+bert_format_t * test_compile(const char *source,unsigned int holes)
+{
+	bert_format_t *format;
+
+	if (!(format = bert_format_compile(source)))
+	{
+		test_fail("bert_format_compile failed to compile %s",source);
+	}
+
+	if (bert_format_holes(format) != holes)
+	{
+		test_fail("bert_format_holes returned %u, expected %u",bert_format_holes(format),holes);
+	}
+
+	return format;
+}
+
+/*
+ * Compares the output of the encoder against the encoding of the
+ * equivalent data.
+ */
+void test_output(bert_encoder_t *encoder,bert_data_t *data)
+{
+	unsigned char *expected;
+	size_t expected_length;
+	int result;
+
+	if ((result = bert_encode_alloc(data,&expected,&expected_length)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (bert_encoder_total(encoder) != expected_length)
+	{
+		test_fail("bert_format_push encoded %u bytes, expected %u",(unsigned int)bert_encoder_total(encoder),(unsigned int)expected_length);
+	}
+
+	test_bytes(output,expected,expected_length);
+
+	free(expected);
+	bert_data_destroy(data);
+}
+
+void test_reply()
+{
+	bert_format_t *format = test_compile("{reply, {ok, ~i, ~b}}",2);
+	bert_encoder_t *encoder;
+	int64_t i;
+	int result;
+
+	for (i=-300;i<=300;i+=150)
+	{
+		encoder = test_encoder(output,sizeof(output));
+
+		if ((result = bert_format_push(encoder,format,i,(const unsigned char *)"payload",(size_t)7)) != BERT_SUCCESS)
+		{
+			test_fail(bert_strerror(result));
+		}
+
+		test_output(encoder,test_tuple(
+			bert_data_create_atom("reply"),
+			test_tuple(
+				bert_data_create_atom("ok"),
+				bert_data_create_int(i),
+				bert_data_create_bin((const unsigned char *)"payload",7)
+			),
+			NULL
+		));
+
+		bert_encoder_destroy(encoder);
+	}
+
+	bert_format_destroy(format);
+}
+
+void test_args()
+{
+	bert_format_t *format = test_compile("[~a, 'Quoted', \"text\", ~s, -42, ~f]",3);
+	bert_encoder_t *encoder = test_encoder(output,sizeof(output));
+	bert_format_arg_t args[3];
+	bert_data_t *list;
+	int result;
+
+	args[0].atom = "hole";
+	args[1].string = "filled";
+	args[2].floating_point = 2.5;
+
+	if ((result = bert_format_push_args(encoder,format,args)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_append(list,bert_data_create_atom("hole"));
+	test_append(list,bert_data_create_atom("Quoted"));
+	test_append(list,bert_data_create_string("text"));
+	test_append(list,bert_data_create_string("filled"));
+	test_append(list,bert_data_create_int(-42));
+	test_append(list,bert_data_create_float(2.5));
+
+	test_output(encoder,list);
+
+	bert_encoder_destroy(encoder);
+	bert_format_destroy(format);
+}
+
+void test_term()
+{
+	bert_format_t *format = test_compile("{event, ~t, []}",1);
+	bert_encoder_t *encoder = test_encoder(output,sizeof(output));
+	bert_data_t *term;
+	bert_data_t *empty;
+	int result;
+
+	term = test_tuple(bert_data_create_atom("nested"),bert_data_create_int(1000),NULL);
+
+	if ((result = bert_format_push(encoder,format,term)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (!(empty = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	test_output(encoder,test_tuple(bert_data_create_atom("event"),term,empty));
+
+	bert_encoder_destroy(encoder);
+	bert_format_destroy(format);
+}
+
+void test_invalid()
+{
+	const char *invalid[] = {
+		"{ok",
+		"{ok,}",
+		"[1 2]",
+		"{ok} trailing",
+		"~x",
+		"'unterminated",
+		"Variable",
+		""
+	};
+	unsigned int i;
+
+	for (i=0;i<(sizeof(invalid) / sizeof(const char *));i++)
+	{
+		if (bert_format_compile(invalid[i]))
+		{
+			test_fail("bert_format_compile accepted the invalid format %s",invalid[i]);
+		}
+	}
+}
+
+int main()
+{
+	test_reply();
+	test_args();
+	test_term();
+	test_invalid();
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+#include <bert/packed.h>
+#include <bert/slab.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define BLOCK_SIZE	4096
+
+uint64_t block[BLOCK_SIZE / sizeof(uint64_t)];
+uint64_t clone[BLOCK_SIZE / sizeof(uint64_t)];
+
+void test_data(const bert_data_t *data)
+{
+	if (data->type != bert_data_tuple || data->tuple->length != 4)
+	{
+		test_fail("packed data is not a tuple of 4 elements");
+	}
+
+	if (!bert_data_strequal(bert_tuple_get(data->tuple,0),"reply"))
+	{
+		test_fail("packed atom does not match");
+	}
+
+	if (!bert_data_strequal(bert_tuple_get(data->tuple,1),"hello"))
+	{
+		test_fail("packed binary does not match");
+	}
+
+	const bert_data_t *list = bert_tuple_get(data->tuple,2);
+
+	if (list->type != bert_data_list || bert_list_length(list->list) != 2)
+	{
+		test_fail("packed list does not have 2 elements");
+	}
+
+	if (bert_list_get(list->list,1)->integer != 2)
+	{
+		test_fail("packed list element is %d, expected %d",bert_list_get(list->list,1)->integer,2);
+	}
+
+	const bert_data_t *dict = bert_tuple_get(data->tuple,3);
+
+	if (dict->type != bert_data_dict || dict->dict->head->value->integer != 42)
+	{
+		test_fail("packed dict does not match");
+	}
+}
+
+bert_data_t * test_create()
+{
+	bert_data_t *data;
+	bert_data_t *list;
+	bert_data_t *dict;
+
+	if (!(data = bert_data_create_tuple(4)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_tuple_set(data->tuple,0,bert_data_create_atom("reply"));
+	bert_tuple_set(data->tuple,1,bert_data_create_bin((const unsigned char *)"hello",5));
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_list_append(list->list,bert_data_create_int(1));
+	bert_list_append(list->list,bert_data_create_int(2));
+	bert_tuple_set(data->tuple,2,list);
+
+	if (!(dict = bert_data_create_dict()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_dict_append(dict->dict,bert_data_create_atom("answer"),bert_data_create_int(42));
+	bert_tuple_set(data->tuple,3,dict);
+	return data;
+}
+
+/*
+ * Data inflated with the slab pools enabled is freed into them, whichever
+ * allocator was current when the block was packed.
+ */
+void test_slab()
+{
+	bert_data_t *data;
+	size_t length;
+
+	bert_slab_enable(0);
+
+	data = test_create();
+	length = bert_packed_sizeof(data);
+	test_check(bert_packed_create(data,clone,length));
+	bert_data_destroy(data);
+
+	bert_slab_enable(1);
+
+	if (!(data = bert_packed_inflate(clone,length)))
+	{
+		test_fail("bert_packed_inflate failed");
+	}
+
+	test_data(data);
+	bert_data_destroy(data);
+
+	bert_slab_enable(0);
+}
+
+int main()
+{
+	bert_data_t *data = test_create();
+	size_t length = bert_packed_sizeof(data);
+	int result;
+
+	if (length > BLOCK_SIZE)
+	{
+		test_fail("bert_packed_sizeof returned %u bytes, expected at most %u",length,BLOCK_SIZE);
+	}
+
+	if ((result = bert_packed_create(data,block,length - 1)) != BERT_ERRNO_SHORT_WRITE)
+	{
+		test_fail("bert_packed_create returned %d, expected BERT_ERRNO_SHORT_WRITE",result);
+	}
+
+	if ((result = bert_packed_create(data,block,length)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	bert_data_destroy(data);
+
+	bert_data_t *packed;
+
+	if (!(packed = bert_packed_attach(block,length)))
+	{
+		test_fail("bert_packed_attach rejected the packed block");
+	}
+
+	test_data(packed);
+
+	if (bert_tuple_set(packed->tuple,0,NULL))
+	{
+		test_fail("bert_tuple_set modified packed data");
+	}
+
+	// packed data is released along with its block
+	bert_data_destroy(packed);
+
+	// cloning an attached block is a single copy
+	memcpy(clone,block,length);
+
+	if (!(packed = bert_packed_attach(clone,length)))
+	{
+		test_fail("bert_packed_attach rejected the cloned block");
+	}
+
+	test_data(packed);
+
+	if ((result = bert_packed_detach(block,length)) != BERT_SUCCESS)
+	{
+		test_fail(bert_strerror(result));
+	}
+
+	if (!(data = bert_packed_inflate(block,length)))
+	{
+		test_fail("bert_packed_inflate failed");
+	}
+
+	test_data(data);
+
+	if (data->flags & BERT_DATA_FROZEN)
+	{
+		test_fail("bert_packed_inflate returned frozen data");
+	}
+
+	bert_data_destroy(data);
+
+	memset(block,0,sizeof(uint64_t));
+
+	if (bert_packed_attach(block,length))
+	{
+		test_fail("bert_packed_attach accepted an invalid block");
+	}
+
+	test_slab();
+	return 0;
+}
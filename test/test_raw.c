@@ -0,0 +1,374 @@
+#include <bert/encoder.h>
+#include <bert/decoder.h>
+#include <bert/builder.h>
+#include <bert/magic.h>
+#include <bert/errno.h>
+
+#include "test.h"
+#include <string.h>
+
+#define BIN_LENGTH	100
+
+// {Reply, [1, 2, 3], <<0, 1, 2, ...>>, true}
+bert_data_t * test_message(const char *reply)
+{
+	unsigned char bin[BIN_LENGTH];
+	bert_data_t *tuple;
+	bert_data_t *list;
+	unsigned int i;
+
+	for (i=0;i<BIN_LENGTH;i++)
+	{
+		bin[i] = i;
+	}
+
+	if (!(tuple = bert_data_create_tuple(4)) || !(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=1;i<=3;i++)
+	{
+		test_check(bert_list_append(list->list,bert_data_create_int(i)));
+	}
+
+	tuple->tuple->elements[0] = bert_data_create_atom(reply);
+	tuple->tuple->elements[1] = list;
+	tuple->tuple->elements[2] = bert_data_create_bin(bin,BIN_LENGTH);
+	tuple->tuple->elements[3] = bert_data_create_true();
+	return tuple;
+}
+
+/*
+ * Encodes the given data and compares it against the expected bytes.
+ */
+void test_encoded(const bert_data_t *data,const unsigned char *expected,size_t expected_length)
+{
+	unsigned char *bytes;
+	size_t length;
+
+	test_check(bert_encode_alloc(data,&bytes,&length));
+
+	if (length != expected_length)
+	{
+		test_fail("the data encoded to %u bytes, expected %u",(unsigned int)length,(unsigned int)expected_length);
+	}
+
+	test_bytes(bytes,expected,expected_length);
+	free(bytes);
+}
+
+bert_data_t * test_pull(bert_decoder_t *decoder)
+{
+	bert_data_t *data;
+	int result;
+
+	if ((result = bert_decoder_pull(decoder,&data)) != 1)
+	{
+		test_fail("bert_decoder_pull failed: %s",bert_strerror(result));
+	}
+
+	if (data->type != bert_data_tuple || data->tuple->length != 4)
+	{
+		test_fail("bert_decoder_pull did not decode the outer tuple");
+	}
+
+	return data;
+}
+
+void test_raw_elements(const bert_data_t *data)
+{
+	unsigned int i;
+
+	for (i=0;i<data->tuple->length;i++)
+	{
+		if (data->tuple->elements[i]->type != bert_data_raw)
+		{
+			test_fail("element %u was decoded, expected it to be kept raw",i);
+		}
+	}
+}
+
+void test_forward(const unsigned char *message,size_t message_length)
+{
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+
+	bert_decoder_buffer(decoder,message,message_length);
+	bert_decoder_raw_depth(decoder,1);
+
+	data = test_pull(decoder);
+	test_raw_elements(data);
+	test_encoded(data,message,message_length);
+
+	// modify one field and forward the rest untouched
+	test_check(bert_data_tuple_set(&data,0,bert_data_create_atom("noreply")));
+
+	bert_data_t *expected = test_message("noreply");
+	unsigned char *expected_bytes;
+	size_t expected_length;
+
+	test_check(bert_encode_alloc(expected,&expected_bytes,&expected_length));
+	test_encoded(data,expected_bytes,expected_length);
+
+	free(expected_bytes);
+	bert_data_destroy(expected);
+	bert_data_destroy(data);
+	bert_decoder_destroy(decoder);
+}
+
+void test_nested(const unsigned char *message,size_t message_length)
+{
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+	bert_data_t *list;
+
+	bert_decoder_buffer(decoder,message,message_length);
+	bert_decoder_raw_depth(decoder,2);
+
+	data = test_pull(decoder);
+	list = data->tuple->elements[1];
+
+	if (data->tuple->elements[0]->type != bert_data_atom || list->type != bert_data_list || data->tuple->elements[2]->type != bert_data_bin)
+	{
+		test_fail("the elements of the outer tuple were not decoded");
+	}
+
+	if (list->list->head->data->type != bert_data_raw)
+	{
+		test_fail("the elements of the list were not kept raw");
+	}
+
+	test_encoded(data,message,message_length);
+
+	bert_data_destroy(data);
+	bert_decoder_destroy(decoder);
+}
+
+void test_shared(const unsigned char *message,size_t message_length)
+{
+	unsigned char *copy;
+	bert_bin_buffer_t *buffer;
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+
+	if (!(copy = malloc(message_length)))
+	{
+		test_fail("malloc failed");
+	}
+
+	memcpy(copy,message,message_length);
+
+	if (!(buffer = bert_bin_buffer_create(copy,message_length,NULL,NULL)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_decoder_shared_buffer(decoder,buffer);
+	bert_decoder_raw_depth(decoder,1);
+	bert_bin_buffer_unref(buffer);
+
+	data = test_pull(decoder);
+	test_raw_elements(data);
+
+	if (!data->tuple->elements[2]->raw.buffer)
+	{
+		test_fail("the raw binary copied the shared buffer");
+	}
+
+	if (data->tuple->elements[0]->raw.buffer)
+	{
+		test_fail("the raw atom referenced the shared buffer");
+	}
+
+	bert_decoder_destroy(decoder);
+
+	test_encoded(data,message,message_length);
+	bert_data_destroy(data);
+	free(copy);
+}
+
+struct test_source
+{
+	const unsigned char *ptr;
+	size_t length;
+};
+
+ssize_t test_read(unsigned char *dest,size_t length,void *data)
+{
+	struct test_source *source = data;
+
+	if (length > source->length)
+	{
+		length = source->length;
+	}
+
+	memcpy(dest,source->ptr,length);
+	source->ptr += length;
+	source->length -= length;
+	return length;
+}
+
+void test_callback(const unsigned char *message,size_t message_length)
+{
+	struct test_source source = {message, message_length};
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+
+	bert_decoder_callback(decoder,test_read,&source);
+	bert_decoder_raw_depth(decoder,1);
+
+	data = test_pull(decoder);
+	test_raw_elements(data);
+	test_encoded(data,message,message_length);
+
+	bert_data_destroy(data);
+	bert_decoder_destroy(decoder);
+}
+
+void test_atom_cache(const bert_data_t *message,const unsigned char *plain,size_t plain_length)
+{
+	bert_encoder_t *encoder;
+	bert_decoder_t *decoder = test_decoder();
+	bert_data_t *data;
+	unsigned char *output;
+	size_t output_length;
+	unsigned int i;
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_dynamic(encoder);
+	test_check(bert_encoder_atom_cache(encoder,1));
+	test_check(bert_encoder_push(encoder,message));
+	test_check(bert_encoder_push(encoder,message));
+	test_check(bert_encoder_take_buffer(encoder,&output,&output_length));
+
+	bert_decoder_buffer(decoder,output,output_length);
+	bert_decoder_raw_depth(decoder,1);
+	test_check(bert_decoder_atom_cache(decoder,1));
+
+	// the references of the second message are resolved into the raw terms
+	for (i=0;i<2;i++)
+	{
+		data = test_pull(decoder);
+		test_raw_elements(data);
+		test_encoded(data,plain,plain_length);
+		bert_data_destroy(data);
+	}
+
+	free(output);
+	bert_decoder_destroy(decoder);
+	bert_encoder_destroy(encoder);
+}
+
+void test_create(const unsigned char *message,size_t message_length)
+{
+	bert_data_t *data;
+
+	if (bert_data_create_raw(message,message_length))
+	{
+		test_fail("bert_data_create_raw accepted a leading magic byte");
+	}
+
+	if (bert_data_create_raw(message + 1,message_length - 2))
+	{
+		test_fail("bert_data_create_raw accepted an incomplete term");
+	}
+
+	if (!(data = bert_data_create_raw(message + 1,message_length - 1)))
+	{
+		test_fail("bert_data_create_raw rejected a complete term");
+	}
+
+	if (bert_data_sizeof(data) != (message_length - 1))
+	{
+		test_fail("bert_data_sizeof returned %u, expected %u",(unsigned int)bert_data_sizeof(data),(unsigned int)(message_length - 1));
+	}
+
+	test_encoded(data,message,message_length);
+	bert_data_destroy(data);
+}
+
+void test_splice(const bert_data_t *message,const unsigned char *plain,size_t plain_length)
+{
+	bert_encoder_t *encoder;
+	bert_data_t *expected;
+	unsigned char *expected_bytes;
+	size_t expected_length;
+	unsigned char *output;
+	size_t output_length;
+	size_t consumed = 0;
+
+	if (!(expected = bert_data_create_tuple(2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	expected->tuple->elements[0] = bert_data_create_atom("forward");
+	expected->tuple->elements[1] = bert_data_ref((bert_data_t *)message);
+	test_check(bert_encode_alloc(expected,&expected_bytes,&expected_length));
+
+	if (!(encoder = bert_encoder_create()))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_encoder_dynamic(encoder);
+	test_check(bert_encoder_begin_tuple(encoder,2));
+	test_check(bert_encoder_put_atom(encoder,"forward"));
+
+	if (bert_encoder_splice(encoder,plain,plain_length - 1,&consumed) != BERT_ERRNO_SHORT_READ)
+	{
+		test_fail("bert_encoder_splice accepted an incomplete term");
+	}
+
+	test_check(bert_encoder_splice(encoder,plain,plain_length,&consumed));
+
+	if (consumed != plain_length)
+	{
+		test_fail("bert_encoder_splice consumed %u bytes, expected %u",(unsigned int)consumed,(unsigned int)plain_length);
+	}
+
+	if (bert_encoder_depth(encoder))
+	{
+		test_fail("the spliced term did not complete the tuple");
+	}
+
+	test_check(bert_encoder_take_buffer(encoder,&output,&output_length));
+
+	if (output_length != expected_length)
+	{
+		test_fail("the spliced term took %u bytes, expected %u",(unsigned int)output_length,(unsigned int)expected_length);
+	}
+
+	test_bytes(output,expected_bytes,expected_length);
+
+	free(output);
+	free(expected_bytes);
+	bert_data_destroy(expected);
+	bert_encoder_destroy(encoder);
+}
+
+int main()
+{
+	bert_data_t *message = test_message("reply");
+	unsigned char *plain;
+	size_t plain_length;
+
+	test_check(bert_encode_alloc(message,&plain,&plain_length));
+
+	test_forward(plain,plain_length);
+	test_nested(plain,plain_length);
+	test_shared(plain,plain_length);
+	test_callback(plain,plain_length);
+	test_atom_cache(message,plain,plain_length);
+	test_create(plain,plain_length);
+	test_splice(message,plain,plain_length);
+
+	free(plain);
+	bert_data_destroy(message);
+	return 0;
+}
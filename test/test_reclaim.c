@@ -0,0 +1,190 @@
+#include <bert/data.h>
+#include <bert/reclaim.h>
+#include <bert/alloc.h>
+#include <bert/errno.h>
+
+#include "test.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#define LENGTH 100000
+#define DEPTH 100000
+#define BUDGET 1000
+#define STARTERS 8
+#define ROUNDS 20
+
+struct test_counter counter;
+bert_allocator_t allocator;
+
+bert_data_t * test_long_list()
+{
+	bert_data_t *list;
+	bert_data_t *data;
+	unsigned int i;
+
+	if (!(list = bert_data_create_list()))
+	{
+		test_fail("malloc failed");
+	}
+
+	for (i=0;i<LENGTH;i++)
+	{
+		if (!(data = bert_data_create_tuple(1)))
+		{
+			test_fail("malloc failed");
+		}
+
+		if (!(data->tuple->elements[0] = bert_data_create_string("element")))
+		{
+			test_fail("malloc failed");
+		}
+
+		if (bert_list_append(list->list,data) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+	}
+
+	return list;
+}
+
+void test_deep_destroy()
+{
+	bert_data_t *root = NULL;
+	bert_data_t *list;
+	unsigned int i;
+
+	// nest lists deeply enough to overflow a recursive teardown
+	for (i=0;i<DEPTH;i++)
+	{
+		if (!(list = bert_data_create_list()))
+		{
+			test_fail("malloc failed");
+		}
+
+		if (root && bert_list_append(list->list,root) != BERT_SUCCESS)
+		{
+			test_fail("malloc failed");
+		}
+
+		root = list;
+	}
+
+	bert_data_destroy(root);
+
+	if (test_outstanding(&counter))
+	{
+		test_fail("bert_data_destroy left %u allocations behind",test_outstanding(&counter));
+	}
+}
+
+void test_reclaim()
+{
+	bert_data_t *list = test_long_list();
+	bert_data_t *shared = bert_data_ref(list->list->head->data);
+	unsigned int slices = 0;
+
+	bert_data_destroy_async(list);
+
+	if (!test_outstanding(&counter))
+	{
+		test_fail("bert_data_destroy_async did not defer the teardown");
+	}
+
+	while (bert_reclaim(BUDGET))
+	{
+		++slices;
+	}
+
+	if (slices <= 1)
+	{
+		test_fail("bert_reclaim did not free the list in slices");
+	}
+
+	if (shared->type != bert_data_tuple || shared->refs != 1)
+	{
+		test_fail("bert_reclaim freed data still referenced elsewhere");
+	}
+
+	bert_data_destroy(shared);
+
+	if (test_outstanding(&counter))
+	{
+		test_fail("bert_reclaim left %u allocations behind",test_outstanding(&counter));
+	}
+}
+
+void test_reclaimer()
+{
+	if (bert_reclaimer_start() != BERT_SUCCESS)
+	{
+		test_fail("bert_reclaimer_start failed");
+	}
+
+	bert_data_destroy_async(test_long_list());
+	bert_data_destroy_async(test_long_list());
+
+	bert_reclaimer_stop();
+
+	if (test_outstanding(&counter))
+	{
+		test_fail("the reclaimer thread left %u allocations behind",test_outstanding(&counter));
+	}
+}
+
+void * test_starter(void *arg)
+{
+	if (bert_reclaimer_start() != BERT_SUCCESS)
+	{
+		test_fail("bert_reclaimer_start failed");
+	}
+
+	return NULL;
+}
+
+void test_concurrent_start()
+{
+	pthread_t threads[STARTERS];
+	unsigned int round;
+	unsigned int i;
+
+	// only one reclaimer thread is started, and stopping joins it
+	for (round=0;round<ROUNDS;round++)
+	{
+		for (i=0;i<STARTERS;i++)
+		{
+			if (pthread_create(threads + i,NULL,test_starter,NULL))
+			{
+				test_fail("pthread_create failed");
+			}
+		}
+
+		for (i=0;i<STARTERS;i++)
+		{
+			pthread_join(threads[i],NULL);
+		}
+
+		bert_data_destroy_async(test_long_list());
+		bert_reclaimer_stop();
+
+		if (test_outstanding(&counter))
+		{
+			test_fail("the reclaimer threads left %u allocations behind",test_outstanding(&counter));
+		}
+	}
+}
+
+int main()
+{
+	test_counting_allocator(&allocator,&counter);
+	bert_set_allocator(&allocator);
+
+	test_deep_destroy();
+	test_reclaim();
+	test_reclaimer();
+	test_concurrent_start();
+
+	bert_set_allocator(NULL);
+	return 0;
+}
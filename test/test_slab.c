@@ -0,0 +1,130 @@
+#include <bert/slab.h>
+#include <bert/data.h>
+#include <bert/errno.h>
+
+#include "test.h"
+
+#include <pthread.h>
+
+#define THREADS 4
+#define ITERATIONS 1000
+#define LENGTH 200
+
+void test_reuse()
+{
+	bert_data_t *data;
+	bert_data_t *reused;
+
+	if (!(data = bert_data_create_int(1)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_data_destroy(data);
+
+	if (!(reused = bert_data_create_int(2)))
+	{
+		test_fail("malloc failed");
+	}
+
+	if (reused != data)
+	{
+		test_fail("the slab pool did not reuse the freed bert_data_t");
+	}
+
+	if (reused->integer != 2 || reused->refs != 1)
+	{
+		test_fail("the reused bert_data_t was not initialized");
+	}
+
+	bert_data_destroy(reused);
+}
+
+void * test_worker(void *arg)
+{
+	bert_data_t *list;
+	bert_data_t *data;
+	unsigned int i, j;
+
+	for (i=0;i<ITERATIONS;i++)
+	{
+		if (!(list = bert_data_create_list()))
+		{
+			test_fail("malloc failed");
+		}
+
+		for (j=0;j<LENGTH;j++)
+		{
+			if (!(data = bert_data_create_int(j)))
+			{
+				test_fail("malloc failed");
+			}
+
+			if (bert_list_append(list->list,data) != BERT_SUCCESS)
+			{
+				test_fail("malloc failed");
+			}
+		}
+
+		if (bert_list_length(list->list) != LENGTH)
+		{
+			test_fail("bert_list_length returned %u, expected %u",bert_list_length(list->list),LENGTH);
+		}
+
+		bert_data_destroy(list);
+	}
+
+	return NULL;
+}
+
+void test_threads()
+{
+	pthread_t threads[THREADS];
+	unsigned int i;
+
+	for (i=0;i<THREADS;i++)
+	{
+		if (pthread_create(threads + i,NULL,test_worker,NULL))
+		{
+			test_fail("pthread_create failed");
+		}
+	}
+
+	for (i=0;i<THREADS;i++)
+	{
+		pthread_join(threads[i],NULL);
+	}
+}
+
+void test_disable()
+{
+	bert_data_t *data;
+
+	if (!(data = bert_data_create_int(1)))
+	{
+		test_fail("malloc failed");
+	}
+
+	// data allocated from the pool is still returned to it
+	bert_slab_enable(0);
+	bert_data_destroy(data);
+
+	if (!(data = bert_data_create_int(1)))
+	{
+		test_fail("malloc failed");
+	}
+
+	bert_slab_enable(1);
+	bert_data_destroy(data);
+}
+
+int main()
+{
+	bert_slab_enable(1);
+
+	test_reuse();
+	test_threads();
+	test_disable();
+
+	return 0;
+}